@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Minimal benchmark harness: every BENCHMARK(name) registers itself and
+// cppython_bench runs them all, or only those whose name contains argv[1].
+
+struct Benchmark {
+	const char* name;
+	void (*run)();
+};
+
+std::vector<Benchmark>& benchmarkRegistry();
+
+struct BenchmarkRegistrar {
+	BenchmarkRegistrar(const char* name, void (*run)()) {
+		benchmarkRegistry().push_back({ name, run });
+	}
+};
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static BenchmarkRegistrar name##_registrar(#name, name); \
+	static void name()
+
+// Best wall clock time in seconds over `runs` executions of fn
+double bestOf(int runs, const std::function<void()>& fn);
+
+void report(const std::string& label, double seconds);
+void reportSpeedup(const std::string& label, double baseline, double improved);
+
+// Common script helpers
+std::string primesScript(int limit);
+std::string generatedScript(size_t bytes); // many independent top-level defs
+
+// Peak resident set size of this process in KB (0 where unsupported)
+long peakRssKb();
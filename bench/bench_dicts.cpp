@@ -0,0 +1,128 @@
+#include "bench.h"
+#include "dict.h"
+#include "lexer.h"
+#include "parser.h"
+#include "swissMap.h"
+#include "vm.h"
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+static volatile int64_t sink;
+
+// Keys spread like ids: distinct, not sequential
+static std::vector<int64_t> keys(size_t count, uint64_t seed) {
+	std::vector<int64_t> out(count);
+	uint64_t x = seed;
+	for (size_t i = 0; i < count; i++) {
+		x = x * 6364136223846793005ull + 1442695040888963407ull;
+		out[i] = static_cast<int64_t>(x >> 1);
+	}
+	return out;
+}
+
+struct IdentityHash {
+	uint64_t operator()(int64_t key) const { return static_cast<uint64_t>(key); }
+};
+struct IntEqual {
+	bool operator()(int64_t a, int64_t b) const { return a == b; }
+};
+
+// Insert, then look up every key (hits) and as many absent keys (misses),
+// SwissMap against std::unordered_map, 10^3 to 10^7 int64 keys
+BENCHMARK(dict_swiss_vs_unordered) {
+	for (size_t count = 1000; count <= 10000000; count *= 10) {
+		std::vector<int64_t> present = keys(count, 1);
+		std::vector<int64_t> absent = keys(count, 2);
+		int runs = count >= 1000000 ? 2 : 5;
+		int repeat = static_cast<int>(1000000 / count) + 1; // short tables run several times per timing
+
+		SwissMap<int64_t, int64_t, IdentityHash, IntEqual> swiss;
+		double swissInsert = bestOf(runs, [&] {
+			for (int r = 0; r < repeat; r++) {
+				swiss = {};
+				for (int64_t k : present)
+					swiss.insert(k, k);
+			}
+		});
+		double swissHit = bestOf(runs, [&] {
+			int64_t s = 0;
+			for (int r = 0; r < repeat; r++)
+				for (int64_t k : present)
+					s += *swiss.find(k);
+			sink = s;
+		});
+		double swissMiss = bestOf(runs, [&] {
+			int64_t s = 0;
+			for (int r = 0; r < repeat; r++)
+				for (int64_t k : absent)
+					s += swiss.find(k) != nullptr;
+			sink = s;
+		});
+
+		std::unordered_map<int64_t, int64_t> map;
+		double mapInsert = bestOf(runs, [&] {
+			for (int r = 0; r < repeat; r++) {
+				map = {};
+				for (int64_t k : present)
+					map.emplace(k, k);
+			}
+		});
+		double mapHit = bestOf(runs, [&] {
+			int64_t s = 0;
+			for (int r = 0; r < repeat; r++)
+				for (int64_t k : present)
+					s += map.find(k)->second;
+			sink = s;
+		});
+		double mapMiss = bestOf(runs, [&] {
+			int64_t s = 0;
+			for (int r = 0; r < repeat; r++)
+				for (int64_t k : absent)
+					s += map.find(k) != map.end();
+			sink = s;
+		});
+
+		double ops = static_cast<double>(count) * repeat;
+		std::printf("  %8zu keys, ns per op:   insert  hit   miss\n", count);
+		std::printf("    %-18s %6.1f %5.1f %6.1f  (%zu KB)\n", "SwissMap",
+			swissInsert / ops * 1e9, swissHit / ops * 1e9, swissMiss / ops * 1e9, swiss.memoryUsed() / 1024);
+		std::printf("    %-18s %6.1f %5.1f %6.1f\n", "std::unordered_map",
+			mapInsert / ops * 1e9, mapHit / ops * 1e9, mapMiss / ops * 1e9);
+	}
+}
+
+static Value runVM(const std::string& script) {
+	Lexer lexer(script);
+	Program tree = Parser(lexer).parse();
+	VM vm;
+	return vm.run(tree);
+}
+
+// End to end in the VM: literal string keys are interned, so a lookup
+// compares pointers; keys built at run time compare their text
+BENCHMARK(dict_string_keys_script) {
+	const std::string literal =
+		"d = {\"alpha\": 0, \"beta\": 0, \"gamma\": 0, \"delta\": 0}\n"
+		"for i in range(200000):\n"
+		"    d[\"alpha\"] = d[\"beta\"] + d[\"gamma\"] + d[\"delta\"] + i\n"
+		"d[\"alpha\"]\n";
+	const std::string built =
+		"d = {\"alpha\": 0, \"beta\": 0, \"gamma\": 0, \"delta\": 0}\n"
+		"s = \"\"\n"
+		"a = s + \"alpha\"\n"
+		"b = s + \"beta\"\n"
+		"g = s + \"gamma\"\n"
+		"e = s + \"delta\"\n"
+		"for i in range(200000):\n"
+		"    d[a] = d[b] + d[g] + d[e] + i\n"
+		"d[a]\n";
+	std::printf("  200000 iterations: literal=%s built=%s\n",
+		runVM(literal).toString().c_str(), runVM(built).toString().c_str());
+
+	double literalTime = bestOf(3, [&] { runVM(literal); });
+	double builtTime = bestOf(3, [&] { runVM(built); });
+	report("interned literal keys", literalTime);
+	report("run time built keys", builtTime);
+	reportSpeedup("interned over built", builtTime, literalTime);
+}
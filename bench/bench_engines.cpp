@@ -0,0 +1,131 @@
+#include "bench.h"
+#include "lexer.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "vm.h"
+#include <cstdio>
+
+static Program parseScript(const std::string& script) {
+	Lexer lexer(script);
+	Parser parser(lexer);
+	return parser.parse();
+}
+
+static Value runTreeWalker(const std::string& script) {
+	Interpreter interpreter(parseScript(script));
+	return interpreter.interpret();
+}
+
+static Value runVM(const std::string& script) {
+	Program tree = parseScript(script);
+	VM vm;
+	return vm.run(tree);
+}
+
+// Tree-walking Interpreter vs bytecode VM on the test.py prime loop
+BENCHMARK(engine_primes) {
+	const std::string script = primesScript(3000);
+	std::printf("  primes below 3000: tree=%s vm=%s\n",
+		runTreeWalker(script).toString().c_str(), runVM(script).toString().c_str());
+
+	double tree = bestOf(3, [&] { runTreeWalker(script); });
+	double vm = bestOf(3, [&] { runVM(script); });
+	report("tree-walking interpreter", tree);
+	report("bytecode vm", vm);
+	reportSpeedup("vm speedup", tree, vm);
+}
+
+static std::string fibScript(int n, int extraGlobals) {
+	std::string script;
+	for (int i = 0; i < extraGlobals; i++)
+		script += "g" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+	script +=
+		"def fib(n):\n"
+		"    if n < 2:\n"
+		"        return n\n"
+		"    return fib(n - 1) + fib(n - 2)\n"
+		"fib(" + std::to_string(n) + ")\n";
+	return script;
+}
+
+// Naive recursive fib: cost per call, with few and with many live variables
+BENCHMARK(engine_fib_calls) {
+	const int n = 20;
+	const double calls = 21891; // calls made by fib(20)
+	for (int globalsCount : { 0, 500 }) {
+		const std::string script = fibScript(n, globalsCount);
+		double tree = bestOf(3, [&] { runTreeWalker(script); });
+		double vm = bestOf(3, [&] { runVM(script); });
+		std::printf("  fib(%d) with %d extra globals: %.1f ns/call tree, %.1f ns/call vm\n",
+			n, globalsCount, tree * 1e9 / calls, vm * 1e9 / calls);
+	}
+}
+
+// Arithmetic loop over integer literals, or the same loop with every
+// literal written as a double so it runs on the floating point path
+static std::string arithmeticLoopScript(int iterations, bool doubles) {
+	const char* suffix = doubles ? ".0" : "";
+	auto literal = [&](int n) { return std::to_string(n) + suffix; };
+	return
+		"total = " + literal(0) + "\n"
+		"i = " + literal(0) + "\n"
+		"while i < " + literal(iterations) + ":\n"
+		"    total = total + i * 3 % " + literal(7) + " - i // " + literal(5) + "\n"
+		"    i = i + " + literal(1) + "\n"
+		"total\n";
+}
+
+// Integer fast path vs the double path, same operations on equal values
+BENCHMARK(engine_integer_loops) {
+	const int iterations = 200000;
+	const std::string ints = arithmeticLoopScript(iterations, false);
+	const std::string doubles = arithmeticLoopScript(iterations, true);
+	std::printf("  totals: int=%s double=%s\n", runVM(ints).toString().c_str(), runVM(doubles).toString().c_str());
+
+	double treeInt = bestOf(3, [&] { runTreeWalker(ints); });
+	double treeDouble = bestOf(3, [&] { runTreeWalker(doubles); });
+	double vmInt = bestOf(3, [&] { runVM(ints); });
+	double vmDouble = bestOf(3, [&] { runVM(doubles); });
+	report("tree-walking interpreter, int", treeInt);
+	report("tree-walking interpreter, double", treeDouble);
+	report("bytecode vm, int", vmInt);
+	report("bytecode vm, double", vmDouble);
+	reportSpeedup("vm int vs double", vmDouble, vmInt);
+}
+
+// The same counted loop written with for-range and with a while loop that
+// steps its own counter, the body kept small so the loop overhead shows
+static std::string countedLoopScript(int iterations, bool forRange) {
+	std::string n = std::to_string(iterations);
+	std::string loop = forRange ?
+		"for i in range(" + n + "):\n" :
+		"i = 0\n"
+		"while i < " + n + ":\n";
+	std::string step = forRange ? "" : "    i = i + 1\n";
+	return
+		"total = 0\n" + loop +
+		"    if i % 3 == 0:\n" +
+		(forRange ? "" : "    ") + step +
+		"        continue\n"
+		"    total = total + i\n" +
+		step +
+		"total\n";
+}
+
+// for-range runs on a native counter: no condition or increment evaluated
+BENCHMARK(engine_for_range) {
+	const int iterations = 300000;
+	const std::string forLoop = countedLoopScript(iterations, true);
+	const std::string whileLoop = countedLoopScript(iterations, false);
+	std::printf("  totals: for=%s while=%s\n", runVM(forLoop).toString().c_str(), runVM(whileLoop).toString().c_str());
+
+	double treeFor = bestOf(3, [&] { runTreeWalker(forLoop); });
+	double treeWhile = bestOf(3, [&] { runTreeWalker(whileLoop); });
+	double vmFor = bestOf(3, [&] { runVM(forLoop); });
+	double vmWhile = bestOf(3, [&] { runVM(whileLoop); });
+	report("tree-walking interpreter, for", treeFor);
+	report("tree-walking interpreter, while", treeWhile);
+	report("bytecode vm, for", vmFor);
+	report("bytecode vm, while", vmWhile);
+	reportSpeedup("vm for vs while", vmWhile, vmFor);
+}
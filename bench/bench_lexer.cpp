@@ -0,0 +1,133 @@
+#include "bench.h"
+#include "lexer.h"
+#include "sourceBuffer.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+static volatile unsigned sink;
+
+// Tokenize a multi-megabyte generated script, no parsing
+BENCHMARK(lexer_throughput) {
+	const std::string script = generatedScript(8 << 20);
+	size_t tokens = 0;
+	double seconds = bestOf(5, [&] {
+		Lexer lexer(script);
+		tokens = 0;
+		while (lexer.getNextToken().type != TokenType::EOF_TOKEN)
+			tokens++;
+	});
+	std::printf("  %.1f MB, %zu tokens: %.1f ms, %.1f MB/s, %.1f ns/token\n",
+		script.size() / 1e6, tokens, seconds * 1e3, script.size() / 1e6 / seconds, seconds * 1e9 / tokens);
+}
+
+// Same, but peeking past every NAME the way Parser::simple_stmt() does
+BENCHMARK(lexer_lookahead) {
+	const std::string script = generatedScript(8 << 20);
+	size_t peeks = 0;
+	double plain = bestOf(5, [&] {
+		Lexer lexer(script);
+		while (lexer.getNextToken().type != TokenType::EOF_TOKEN) {}
+	});
+	double peeking = bestOf(5, [&] {
+		Lexer lexer(script);
+		peeks = 0;
+		for (Token t = lexer.getNextToken(); t.type != TokenType::EOF_TOKEN; t = lexer.getNextToken()) {
+			if (t.type == TokenType::NAME) {
+				lexer.peekNextToken();
+				peeks++;
+			}
+		}
+	});
+	std::printf("  %zu peeks: %.1f ms without, %.1f ms with (%.1f ns/peek)\n",
+		peeks, plain * 1e3, peeking * 1e3, (peeking - plain) * 1e9 / peeks);
+}
+
+// Machine-generated style code: long identifiers, wide indentation and
+// long string literals, where scanning a run dominates
+static std::string wideScript(size_t bytes) {
+	std::string script;
+	script.reserve(bytes + 512);
+	for (int i = 0; script.size() < bytes; i++) {
+		std::string n = std::to_string(i);
+		script +=
+			"def generated_accessor_for_table_column_" + n + "(record_identifier_value, column_offset_value):\n"
+			"                if record_identifier_value > 1234567890123:\n"
+			"                                description_text = \"generated accessor for column number " + n + " of the table\"\n"
+			"                                return record_identifier_value + column_offset_value * 1000000007\n"
+			"                return generated_default_value_for_column_" + n + "\n";
+	}
+	return script;
+}
+
+// The scalar and vectorized scanning paths on the same corpora
+BENCHMARK(lexer_simd) {
+	const std::pair<const char*, std::string> corpora[] = {
+		{ "generated", generatedScript(8 << 20) },
+		{ "wide", wideScript(8 << 20) },
+	};
+	for (const auto& [name, script] : corpora) {
+		std::printf("  %s corpus, %.1f MB:\n", name, script.size() / 1e6);
+		double scalar = 0.0;
+		size_t scalarTokens = 0;
+		for (ScanIsa isa : { ScanIsa::Scalar, ScanIsa::SSE2, ScanIsa::AVX2 }) {
+			if (!scanIsaSupported(isa)) {
+				std::printf("    %-6s not supported here\n", scanIsaName(isa));
+				continue;
+			}
+			size_t tokens = 0;
+			double seconds = bestOf(5, [&] {
+				Lexer lexer(script, scannerFor(isa));
+				tokens = 0;
+				while (lexer.getNextToken().type != TokenType::EOF_TOKEN)
+					tokens++;
+			});
+			if (isa == ScanIsa::Scalar) {
+				scalar = seconds;
+				scalarTokens = tokens;
+			}
+			std::printf("    %-6s %7.1f MB/s  %.2fx%s\n", scanIsaName(isa), script.size() / 1e6 / seconds,
+				scalar / seconds, tokens == scalarTokens ? "" : "  TOKEN COUNT MISMATCH");
+		}
+	}
+}
+
+// Loading a 50 MB script from disk (page cache warm): the old getline loop
+// against a mapped SourceBuffer, then the lexer on top of the mapping
+BENCHMARK(source_loading) {
+	const std::string path = (std::filesystem::temp_directory_path() / "cppython_bench_source.py").string();
+	{
+		std::ofstream out(path, std::ios::binary);
+		out << generatedScript(50 << 20);
+	}
+	size_t bytes = std::filesystem::file_size(path);
+	auto lexAll = [](std::string_view text) {
+		Lexer lexer(text);
+		while (lexer.getNextToken().type != TokenType::EOF_TOKEN) {}
+	};
+	auto touch = [](std::string_view text) {
+		unsigned sum = 0;
+		for (size_t i = 0; i < text.size(); i += 4096)
+			sum += static_cast<unsigned char>(text[i]);
+		return sum;
+	};
+	double getlineLoad = bestOf(3, [&] {
+		std::ifstream f(path);
+		std::string line, s = "";
+		while (std::getline(f, line))
+			s += line + "\n";
+		sink = touch(s);
+	});
+	double mapLoad = bestOf(3, [&] {
+		SourceBuffer source = SourceBuffer::fromFile(path);
+		sink = touch(source.text());
+	});
+	double mapLex = bestOf(3, [&] {
+		SourceBuffer source = SourceBuffer::fromFile(path);
+		lexAll(source.text());
+	});
+	std::printf("  %.1f MB: getline loop %.1f ms, SourceBuffer (mmap) %.1f ms\n",
+		bytes / 1e6, getlineLoad * 1e3, mapLoad * 1e3);
+	std::printf("  mmap + lex %.1f ms (%.0f MB/s)\n", mapLex * 1e3, bytes / 1e6 / mapLex);
+	std::filesystem::remove(path);
+}
@@ -0,0 +1,122 @@
+#include "bench.h"
+#include "builtInFunctions.h"
+#include "lexer.h"
+#include "list.h"
+#include "listKernels.h"
+#include "operators.h"
+#include "parser.h"
+#include "vm.h"
+#include <cstdio>
+#include <vector>
+
+static volatile double sink;
+
+// A list of `count` ints, or floats, appended one by one like a script would
+static Value numberList(size_t count, bool floats) {
+	std::vector<Value> items;
+	items.reserve(count);
+	for (size_t i = 0; i < count; i++) {
+		int64_t n = static_cast<int64_t>((i * 7919) % 1000003);
+		items.push_back(floats ? Value(n * 0.5) : Value::integer(n));
+	}
+	return makeList(items.data(), items.size());
+}
+
+// The same elements in boxed storage: a leading string forces it, and the
+// reductions below skip it
+static Value boxedCopy(const ListObject& list) {
+	std::vector<Value> items{ Value(std::string("x")) };
+	for (size_t i = 0; i < list.size(); i++)
+		items.push_back(list.get(i));
+	return makeList(items.data(), items.size());
+}
+
+// The generic loop a list of Values needs: one dispatch per element
+static Value boxedSum(const ListObject& list) {
+	Value sum = Value::integer(0);
+	for (size_t i = 1; i < list.size(); i++)
+		sum = addValues(sum, list.boxed()[i]);
+	return sum;
+}
+
+static Value boxedMax(const ListObject& list) {
+	Value best = list.boxed()[1];
+	for (size_t i = 2; i < list.size(); i++)
+		if (greaterValues(list.boxed()[i], best).asBool())
+			best = list.boxed()[i];
+	return best;
+}
+
+// sum() and max() over a million element list: boxed Values against the
+// unboxed arrays with every kernel implementation
+BENCHMARK(list_kernels) {
+	const size_t count = 1 << 20;
+	for (bool floats : { false, true }) {
+		Value unboxed = numberList(count, floats);
+		Value boxed = boxedCopy(unboxed.asList());
+		const ListObject& list = unboxed.asList();
+		std::printf("  %zu %s:\n", count, floats ? "floats" : "ints");
+
+		double boxedSumTime = bestOf(5, [&] { sink = boxedSum(boxed.asList()).asNumber(); });
+		double boxedMaxTime = bestOf(5, [&] { sink = boxedMax(boxed.asList()).asNumber(); });
+		std::printf("    %-6s sum %7.1f ms  max %7.1f ms\n", "boxed", boxedSumTime * 1e3, boxedMaxTime * 1e3);
+
+		for (ScanIsa isa : { ScanIsa::Scalar, ScanIsa::SSE2, ScanIsa::AVX2 }) {
+			if (!scanIsaSupported(isa)) {
+				std::printf("    %-6s not supported here\n", scanIsaName(isa));
+				continue;
+			}
+			const ListKernels& kernels = listKernelsFor(isa);
+			double sumTime, maxTime;
+			if (floats) {
+				sumTime = bestOf(5, [&] { sink = kernels.sumDoubles(0.0, list.doubles(), count); });
+				maxTime = bestOf(5, [&] {
+					double m = 0;
+					kernels.maxDoubles(list.doubles(), count, &m);
+					sink = m;
+				});
+			}
+			else {
+				sumTime = bestOf(5, [&] {
+					int64_t s = 0;
+					kernels.sumInts(list.ints(), count, &s);
+					sink = static_cast<double>(s);
+				});
+				maxTime = bestOf(5, [&] { sink = static_cast<double>(kernels.maxInts(list.ints(), count)); });
+			}
+			std::printf("    %-6s sum %7.3f ms  max %7.3f ms  (%.0fx, %.0fx boxed)\n", scanIsaName(isa),
+				sumTime * 1e3, maxTime * 1e3, boxedSumTime / sumTime, boxedMaxTime / maxTime);
+		}
+	}
+}
+
+static Value runVM(const std::string& script) {
+	Lexer lexer(script);
+	Program tree = Parser(lexer).parse();
+	VM vm;
+	return vm.run(tree);
+}
+
+// End to end in the VM: summing a list with a loop against the sum() builtin
+BENCHMARK(list_sum_script) {
+	const std::string build =
+		"xs = []\n"
+		"for i in range(200000):\n"
+		"    xs.append(i * 3)\n";
+	const std::string looped = build +
+		"total = 0\n"
+		"for x in xs:\n"
+		"    total = total + x\n"
+		"total\n";
+	const std::string builtin = build + "sum(xs)\n";
+	std::printf("  200000 ints: loop=%s sum()=%s\n",
+		runVM(looped).toString().c_str(), runVM(builtin).toString().c_str());
+
+	double buildOnly = bestOf(3, [&] { runVM(build); });
+	double loop = bestOf(3, [&] { runVM(looped); });
+	double sum = bestOf(3, [&] { runVM(builtin); });
+	report("build the list", buildOnly);
+	report("for x in xs loop (with build)", loop);
+	report("sum(xs) (with build)", sum);
+	reportSpeedup("sum() over the loop", loop, sum);
+}
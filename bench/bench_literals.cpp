@@ -0,0 +1,44 @@
+#include "bench.h"
+#include "lexer.h"
+#include "parser.h"
+#include "interpreter.h"
+#include <charconv>
+#include <cstdio>
+#include <string>
+
+static volatile double sink;
+
+// The `while i <= n / 2:` loop from test.py, literal heavy on purpose
+BENCHMARK(literal_loop) {
+	const int iterations = 100000;
+	const std::string script =
+		"i = 0\n"
+		"n = 2\n"
+		"while i <= " + std::to_string(iterations) + " * n / 2:\n"
+		"    i = i + 1 + 0 * 3\n";
+	double tree = bestOf(3, [&] {
+		Lexer lexer(script);
+		Parser parser(lexer);
+		Interpreter interpreter(parser.parse());
+		interpreter.interpret();
+	});
+	std::printf("  tree-walking interpreter: %.1f ns/iteration\n", tree * 1e9 / iterations);
+}
+
+// What evaluating a literal used to cost (std::stod) vs parsing it once
+BENCHMARK(literal_parse) {
+	const int iterations = 1000000;
+	const std::string literal = "2";
+	double stod = bestOf(3, [&] {
+		for (int i = 0; i < iterations; i++)
+			sink = std::stod(literal);
+	});
+	double parsed = 0.0;
+	std::from_chars(literal.data(), literal.data() + literal.size(), parsed);
+	double load = bestOf(3, [&] {
+		for (int i = 0; i < iterations; i++)
+			sink = parsed;
+	});
+	std::printf("  std::stod per evaluation: %6.2f ns\n", stod * 1e9 / iterations);
+	std::printf("  preparsed constant load:  %6.2f ns\n", load * 1e9 / iterations);
+}
@@ -0,0 +1,100 @@
+#include "bench.h"
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+
+std::vector<Benchmark>& benchmarkRegistry() {
+	static std::vector<Benchmark> registry;
+	return registry;
+}
+
+double bestOf(int runs, const std::function<void()>& fn) {
+	double best = std::numeric_limits<double>::max();
+	for (int i = 0; i < runs; i++) {
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		if (elapsed.count() < best)
+			best = elapsed.count();
+	}
+	return best;
+}
+
+void report(const std::string& label, double seconds) {
+	std::printf("  %-40s %10.3f ms\n", label.c_str(), seconds * 1e3);
+}
+
+void reportSpeedup(const std::string& label, double baseline, double improved) {
+	std::printf("  %-40s %10.2fx\n", label.c_str(), baseline / improved);
+}
+
+// test.py style prime search without output, so only the engine is timed
+std::string primesScript(int limit) {
+	return
+		"def is_prime(n):\n"
+		"    if n < 2:\n"
+		"        return False\n"
+		"    i = 2\n"
+		"    while i <= n / 2:\n"
+		"        if n % i == 0:\n"
+		"            return False\n"
+		"        i = i + 1\n"
+		"    return True\n"
+		"\n"
+		"count = 0\n"
+		"num = 1\n"
+		"while num < " + std::to_string(limit) + ":\n"
+		"    if is_prime(num):\n"
+		"        count = count + 1\n"
+		"    num = num + 1\n"
+		"count\n";
+}
+
+// Machine generated job script: lots of helpers, each with a bit of everything
+std::string generatedScript(size_t bytes) {
+	std::string script;
+	script.reserve(bytes + 512);
+	for (int i = 0; script.size() < bytes; i++) {
+		std::string n = std::to_string(i);
+		script +=
+			"def helper_" + n + "(alpha, beta):\n"
+			"    total = alpha * 2 + beta - " + n + "\n"
+			"    label = \"helper\" + \"_" + n + "\"\n"
+			"    if total > 10 and not beta == 3:\n"
+			"        total = total % 7 + (alpha - 1) / 2\n"
+			"    elif total < 0:\n"
+			"        return -total\n"
+			"    while total < 100:\n"
+			"        total = total + alpha * (beta - 1) + 1\n"
+			"    return max(total, 42) if total != 7 else min(alpha, beta)\n"
+			"\n";
+	}
+	script += "result = helper_0(1, 2)\n";
+	return script;
+}
+
+long peakRssKb() {
+#ifndef _WIN32
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+#else
+	return 0;
+#endif
+}
+
+int main(int argc, char* argv[]) {
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+	for (const auto& bench : benchmarkRegistry()) {
+		if (filter && !std::strstr(bench.name, filter))
+			continue;
+		std::printf("%s\n", bench.name);
+		bench.run();
+	}
+	return 0;
+}
@@ -0,0 +1,208 @@
+#include "bench.h"
+#include "lexer.h"
+#include "parser.h"
+#include "parallelParser.h"
+#include "incrementalParser.h"
+#include "interpreter.h"
+#include "flatInterpreter.h"
+#include "resolver.h"
+#include "optimizer.h"
+#include "vm.h"
+#include "sourceBuffer.h"
+#include "statementReader.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+// Parse (and tear down) a multi-megabyte generated script.
+// Run it alone (cppython_bench parse_large) so the peak RSS is its own.
+BENCHMARK(parse_large) {
+	const std::string script = generatedScript(8 << 20);
+	long rssBefore = peakRssKb();
+	double seconds = bestOf(3, [&] {
+		Lexer lexer(script);
+		Parser parser(lexer);
+		auto tree = parser.parse();
+	});
+	std::printf("  %.1f MB script: parse + teardown %.1f ms (%.1f MB/s)\n",
+		script.size() / 1e6, seconds * 1e3, script.size() / 1e6 / seconds);
+	std::printf("  peak RSS: %ld KB (%ld KB before parsing)\n", peakRssKb(), rssBefore);
+}
+
+// Serial parser vs parseParallel at 1, 2, 4 and 8 threads on the big
+// script; every speedup is against the serial parser. Threads beyond the
+// hardware's only add overhead.
+BENCHMARK(parse_parallel) {
+	const std::string script = generatedScript(8 << 20);
+	double serial = bestOf(3, [&] {
+		Lexer lexer(script);
+		Program program = Parser(lexer).parse();
+	});
+	// The part that stays serial: bodies are only delimited
+	double firstPass = bestOf(3, [&] {
+		Lexer lexer(script);
+		Program program = Parser(lexer, true).parse();
+	});
+	std::printf("  %.1f MB script, %u hardware threads\n", script.size() / 1e6, std::thread::hardware_concurrency());
+	report("serial parser", serial);
+	report("first pass alone", firstPass);
+	for (unsigned threads : { 1u, 2u, 4u, 8u }) {
+		double parallel = bestOf(3, [&] { Program program = parseParallel(script, threads); });
+		report(std::to_string(threads) + " thread(s)", parallel);
+		reportSpeedup(std::to_string(threads) + " thread(s) speedup", serial, parallel);
+	}
+}
+
+// Typing into the middle of a buffer: one keystroke re-parses the statement
+// it lands in (and the one before), whatever the size of the buffer.
+// "whole program" adds handing out the tree of every statement.
+BENCHMARK(incremental_parse) {
+	for (size_t bytes : { size_t(64) << 10, size_t(1) << 20, size_t(8) << 20 }) {
+		const std::string script = generatedScript(bytes);
+		double full = bestOf(3, [&] {
+			Lexer lexer(script);
+			Program program = Parser(lexer).parse();
+		});
+		IncrementalParser buffer(script);
+		size_t at = script.find("    total = ", script.size() / 2) + 12; // inside a body
+		const int keystrokes = 200;
+		double edit = bestOf(5, [&] {
+			for (int i = 0; i < keystrokes; i++) {
+				buffer.edit(at, 0, "1");
+				buffer.edit(at, 1, "");
+			}
+		}) / (2 * keystrokes);
+		double withTree = bestOf(5, [&] {
+			buffer.edit(at, 0, "1");
+			Program program = buffer.program();
+			buffer.edit(at, 1, "");
+		});
+		std::printf("  %5zu KB, %zu statements: full parse %.2f ms, keystroke %.1f us (%zu re-parsed), with whole program %.1f us\n",
+			script.size() >> 10, buffer.statementCount(), full * 1e3, edit * 1e6, buffer.lastReparsed(), withTree * 1e6);
+	}
+}
+
+// Pointer tree vs FlatAst: memory and parse time on the big script, then
+// the cost of walking each form on the prime loop
+BENCHMARK(ast_layout) {
+	const std::string script = generatedScript(8 << 20);
+	size_t treeBytes = 0, flatBytes = 0, nodes = 0;
+	double tree = bestOf(3, [&] {
+		Lexer lexer(script);
+		Parser parser(lexer);
+		Program program = parser.parse();
+		treeBytes = program.arena->bytesAllocated();
+	});
+	double flat = bestOf(3, [&] {
+		Lexer lexer(script);
+		FlatParser parser(lexer);
+		FlatAst ast = parser.parse();
+		flatBytes = ast.memoryUsed();
+		nodes = ast.size();
+	});
+	std::printf("  %zu nodes: tree %.1f MB in %.1f ms, flat %.1f MB in %.1f ms\n",
+		nodes, treeBytes / 1e6, tree * 1e3, flatBytes / 1e6, flat * 1e3);
+
+	// A whole-program pass over the big tree, where locality matters
+	Lexer treeLexer(script);
+	Program program = Parser(treeLexer).parse();
+	Lexer flatLexer(script);
+	FlatAst ast = FlatParser(flatLexer).parse();
+	double treeResolve = bestOf(3, [&] {
+		GlobalScope globals;
+		Resolver(globals, *program.arena).resolve(*program.root);
+	});
+	double flatResolve = bestOf(3, [&] {
+		GlobalScope globals;
+		resolveFlat(ast, globals);
+	});
+	report("resolve, pointer tree", treeResolve);
+	report("resolve, flat ast", flatResolve);
+	reportSpeedup("flat speedup", treeResolve, flatResolve);
+
+	const std::string primes = primesScript(3000);
+	double treeWalk = bestOf(3, [&] {
+		Lexer lexer(primes);
+		Parser parser(lexer);
+		Interpreter interpreter(parser.parse());
+		interpreter.interpret();
+	});
+	double flatWalk = bestOf(3, [&] {
+		Lexer lexer(primes);
+		FlatParser parser(lexer);
+		FlatInterpreter interpreter;
+		interpreter.interpret(parser.parse());
+	});
+	report("primes, pointer tree", treeWalk);
+	report("primes, flat ast", flatWalk);
+	reportSpeedup("flat speedup", treeWalk, flatWalk);
+}
+
+// Top-level statements only, like a long generated job script. Written in
+// pieces so that generating it does not raise the peak RSS.
+static void writeJobScript(const std::string& path, size_t bytes) {
+	std::ofstream out(path, std::ios::binary);
+	out << "total = 0\n";
+	for (int i = 0; static_cast<size_t>(out.tellp()) < bytes; i++) {
+		std::string n = std::to_string(i);
+		out <<
+			"i = 0\n"
+			"while i < 3:\n"
+			"    total = total + i * 2 + " + n + "\n"
+			"    i = i + 1\n"
+			"if total > 5:\n"
+			"    total = total % 1000 - 1\n"
+			"else:\n"
+			"    total = total + 1\n";
+	}
+}
+
+// Whole-file parse then run vs --stream style statement at a time, on a
+// 50 MB script read from disk. Run it alone for meaningful RSS numbers.
+BENCHMARK(streaming) {
+	const std::string path = (std::filesystem::temp_directory_path() / "cppython_bench_stream.py").string();
+	writeJobScript(path, 50 << 20);
+	using Clock = std::chrono::steady_clock;
+	auto since = [](Clock::time_point start) { return std::chrono::duration<double>(Clock::now() - start).count() * 1e3; };
+
+	long rssStart = peakRssKb();
+	auto start = Clock::now();
+	std::ifstream file(path, std::ios::binary);
+	StatementReader reader(file);
+	VM streamVm;
+	std::string_view statement;
+	double firstRun = 0.0;
+	size_t statements = 0, largestBuffer = 0;
+	while (reader.next(statement)) {
+		Lexer lexer(statement);
+		Program program = Parser(lexer).parse();
+		Optimizer().optimize(program);
+		streamVm.run(program);
+		if (statements++ == 0)
+			firstRun = since(start);
+		largestBuffer = std::max(largestBuffer, reader.bufferSize());
+	}
+	double streamTotal = since(start);
+	long rssStream = peakRssKb();
+
+	start = Clock::now();
+	SourceBuffer source = SourceBuffer::fromFile(path);
+	Lexer lexer(source.text());
+	Program program = Parser(lexer).parse();
+	Optimizer().optimize(program);
+	double wholeFirstRun = since(start); // nothing runs before the parse is done
+	VM wholeVm;
+	wholeVm.run(program);
+	double wholeTotal = since(start);
+	long rssWhole = peakRssKb();
+
+	std::printf("  %.1f MB, %zu statements\n", source.text().size() / 1e6, statements);
+	std::printf("  streaming:  first statement done after %.2f ms, total %.0f ms, peak RSS +%ld KB (reader buffer %zu KB)\n",
+		firstRun, streamTotal, rssStream - rssStart, largestBuffer / 1024);
+	std::printf("  whole file: first statement runs after %.0f ms, total %.0f ms, peak RSS +%ld KB\n",
+		wholeFirstRun, wholeTotal, rssWhole - rssStream);
+	std::filesystem::remove(path);
+}
@@ -0,0 +1,55 @@
+#include "bench.h"
+#include <cstdio>
+
+// Isolates what a return costs when it unwinds as a C++ exception (how the
+// Interpreter used to leave functions) versus a completion flag checked by
+// the caller (how it does now).
+
+static volatile int sink;
+
+struct ReturnSignal {
+	double value;
+};
+
+static double fibThrow(int n);
+
+static void bodyThrow(int n) {
+	if (n < 2)
+		throw ReturnSignal{ static_cast<double>(n) };
+	throw ReturnSignal{ fibThrow(n - 1) + fibThrow(n - 2) };
+}
+
+static double fibThrow(int n) {
+	try {
+		bodyThrow(n);
+	}
+	catch (const ReturnSignal& r) {
+		return r.value;
+	}
+	return 0.0;
+}
+
+static bool returning = false;
+static double returned = 0.0;
+
+static double fibFlag(int n);
+
+static void bodyFlag(int n) {
+	returned = n < 2 ? static_cast<double>(n) : fibFlag(n - 1) + fibFlag(n - 2);
+	returning = true;
+}
+
+static double fibFlag(int n) {
+	bodyFlag(n);
+	returning = false;
+	return returned;
+}
+
+BENCHMARK(return_exception_vs_flag) {
+	const int n = 20;
+	const double calls = 21891; // calls made by fib(20)
+	double thrown = bestOf(3, [&] { sink = static_cast<int>(fibThrow(n)); });
+	double flagged = bestOf(3, [&] { sink = static_cast<int>(fibFlag(n)); });
+	std::printf("  return via exception: %8.1f ns/call\n", thrown * 1e9 / calls);
+	std::printf("  return via flag:      %8.1f ns/call\n", flagged * 1e9 / calls);
+}
@@ -0,0 +1,97 @@
+#include "bench.h"
+#include "codeCache.h"
+#include "compiler.h"
+#include "interpreter.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "sourceBuffer.h"
+#include "vm.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+// Time from reading a script to being ready to execute it: compiled from
+// source (cold, writing the cache as cppython does) vs loaded from the cache
+static void startup(const char* label, const std::string& script, int runs) {
+	const std::string path = (std::filesystem::temp_directory_path() / "cppython_bench_startup.py").string();
+	{
+		std::ofstream out(path, std::ios::binary);
+		out << script;
+	}
+	const auto cacheDir = std::filesystem::temp_directory_path() / "cppython_bench_cache";
+	const std::string cachePath = codeCachePath(path, cacheDir.string());
+	const FunctionProto* code = nullptr;
+
+	double cold = bestOf(runs, [&] {
+		SourceBuffer source = SourceBuffer::fromFile(path);
+		uint64_t key = codeCacheKey(source.text(), true, false);
+		VM vm;
+		Lexer lexer(source.text());
+		Program program = Parser(lexer).parse();
+		Optimizer().optimize(program);
+		code = Compiler(vm.module).compile(program);
+		saveCodeCache(cachePath, key, vm.module, *code);
+	});
+	double warm = bestOf(runs, [&] {
+		SourceBuffer source = SourceBuffer::fromFile(path);
+		VM vm;
+		code = loadCodeCache(cachePath, codeCacheKey(source.text(), true, false), vm.module);
+	});
+	double vmOnly = bestOf(runs, [&] { VM vm; }); // part of both
+
+	std::printf("  %s (%zu bytes, cache %ju bytes): cold %.1f us, warm %.1f us (%.1fx), of which VM setup %.1f us%s\n",
+		label, script.size(), static_cast<uintmax_t>(std::filesystem::file_size(cachePath)), cold * 1e6, warm * 1e6,
+		cold / warm, vmOnly * 1e6, code ? "" : "  CACHE MISS");
+	std::filesystem::remove_all(cacheDir);
+	std::filesystem::remove(path);
+}
+
+BENCHMARK(startup_cache) {
+	startup("primes", primesScript(1000), 200);
+	startup("generated 64 KB", generatedScript(64 << 10), 50);
+	startup("generated 1 MB", generatedScript(1 << 20), 10);
+}
+
+// Time until the first statement runs (front end only) and for the whole
+// run, with every body parsed up front vs parsed on its first call. The
+// generated scripts define many helpers and call just one of them.
+static void lazyStartup(const char* label, const std::string& script, int runs) {
+	auto frontEnd = [&](bool lazy) {
+		return bestOf(runs, [&] {
+			VM vm;
+			Lexer lexer(script);
+			Program program = Parser(lexer, lazy).parse();
+			Optimizer().optimize(program);
+			Compiler(vm.module).compile(program);
+		});
+	};
+	auto vmRun = [&](bool lazy) {
+		return bestOf(runs, [&] {
+			VM vm;
+			Lexer lexer(script);
+			Program program = Parser(lexer, lazy).parse();
+			Optimizer().optimize(program);
+			vm.run(program);
+		});
+	};
+	auto treeRun = [&](bool lazy) {
+		return bestOf(runs, [&] {
+			Lexer lexer(script);
+			Program program = Parser(lexer, lazy).parse();
+			Optimizer().optimize(program);
+			Interpreter(std::move(program)).interpret();
+		});
+	};
+	double eagerFirst = frontEnd(false), lazyFirst = frontEnd(true);
+	double eagerVm = vmRun(false), lazyVm = vmRun(true);
+	double eagerTree = treeRun(false), lazyTree = treeRun(true);
+	std::printf("  %s: first statement eager %.1f us, lazy %.1f us (%.1fx)\n", label, eagerFirst * 1e6, lazyFirst * 1e6, eagerFirst / lazyFirst);
+	std::printf("  %s: whole run vm %.1f -> %.1f us, tree %.1f -> %.1f us\n", label, eagerVm * 1e6, lazyVm * 1e6, eagerTree * 1e6, lazyTree * 1e6);
+}
+
+BENCHMARK(startup_lazy) {
+	lazyStartup("primes", primesScript(1000), 50);
+	lazyStartup("generated 64 KB", generatedScript(64 << 10), 50);
+	lazyStartup("generated 1 MB", generatedScript(1 << 20), 10);
+}
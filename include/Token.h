@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
+#include <string_view>
+
 enum class TokenType {
     NUMBER,
     PLUS,
@@ -31,14 +35,34 @@ enum class TokenType {
     AND,
     NOT,
     PERCENT,
+    DOUBLESLASH,
     DEF,
     RETURN,
+    FOR,
+    IN,
+    BREAK,
+    CONTINUE,
+    LSQB,
+    RSQB,
+    DOT,
+    LBRACE,
+    RBRACE,
     EOF_TOKEN
 };
 
+// What a NUMBER token holds: a double (it has a '.'), a 64 bit integer, or
+// an integer too large for that, left as its digits
+enum class NumberKind : uint8_t { Float, Int, BigInt };
+
+// `value` is a span of the source buffer the Lexer reads from, so tokens are
+// only valid while that buffer is. Copy (or intern) what has to outlive it.
 struct Token {
     TokenType type;
-    std::string value;
+    std::string_view value;
+    // Parsed value of a NUMBER token
+    NumberKind numberKind = NumberKind::Float;
+    double number = 0.0;
+    int64_t integer = 0;
 
     std::string toString() const;
 };
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Fixed size array living in an Arena. Copying it copies the view, not the items.
+template <typename T>
+struct ArenaArray {
+	T* items = nullptr;
+	uint32_t count = 0;
+
+	T* begin() const { return items; }
+	T* end() const { return items + count; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	T& operator[](size_t i) const { return items[i]; }
+	T& back() const { return items[count - 1]; }
+};
+
+// Bump allocator for everything that lives exactly as long as one parse:
+// AST nodes, their child lists and interned names. Nothing allocated here
+// is destroyed individually; the blocks are released when the arena dies,
+// so whatever goes in must not own memory of its own.
+class Arena {
+public:
+	Arena() = default;
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+	~Arena() {
+		while (blocks) {
+			Block* next = blocks->next;
+			std::free(blocks);
+			blocks = next;
+		}
+	}
+
+	void* allocate(size_t size, size_t align) {
+		uintptr_t start = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t(align) - 1);
+		if (!cursor || start + size > reinterpret_cast<uintptr_t>(limit)) {
+			addBlock(size + align);
+			start = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t(align) - 1);
+		}
+		cursor = reinterpret_cast<char*>(start + size);
+		return reinterpret_cast<void*>(start);
+	}
+
+	template <typename T, typename... Args>
+	T* make(Args&&... args) {
+		return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	template <typename T>
+	ArenaArray<T> copy(const T* items, size_t count) {
+		ArenaArray<T> array;
+		if (count == 0)
+			return array;
+		array.items = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+		array.count = static_cast<uint32_t>(count);
+		for (size_t i = 0; i < count; i++)
+			new (&array.items[i]) T(items[i]);
+		return array;
+	}
+
+	template <typename T>
+	ArenaArray<T> copy(const std::vector<T>& items) { return copy(items.data(), items.size()); }
+
+	// One copy of every distinct string, so equal names share storage
+	std::string_view intern(std::string_view s) {
+		auto it = interned.find(s);
+		if (it != interned.end())
+			return *it;
+		char* chars = static_cast<char*>(allocate(s.size() + 1, 1));
+		s.copy(chars, s.size());
+		chars[s.size()] = '\0';
+		std::string_view stored(chars, s.size());
+		interned.insert(stored);
+		return stored;
+	}
+
+	// A private copy of `s`, for text that is kept but never looked up
+	std::string_view copyText(std::string_view s) {
+		char* chars = static_cast<char*>(allocate(s.size(), 1));
+		s.copy(chars, s.size());
+		return std::string_view(chars, s.size());
+	}
+
+	// Keep `other` alive as long as this arena, for trees that link nodes of both
+	void adopt(std::shared_ptr<Arena> other) { adopted.push_back(std::move(other)); }
+
+	size_t bytesAllocated() const { return reserved; }
+
+private:
+	struct Block {
+		Block* next;
+	};
+
+	static constexpr size_t kFirstBlockSize = 64 * 1024;
+	static constexpr size_t kMaxBlockSize = 4 * 1024 * 1024;
+
+	Block* blocks = nullptr;
+	char* cursor = nullptr;
+	char* limit = nullptr;
+	size_t nextBlockSize = kFirstBlockSize;
+	size_t reserved = 0;
+	std::unordered_set<std::string_view> interned;
+	std::vector<std::shared_ptr<Arena>> adopted;
+
+	// Blocks double in size so a large script needs only a handful
+	void addBlock(size_t minimum) {
+		size_t size = nextBlockSize;
+		while (size < minimum + sizeof(Block))
+			size *= 2;
+		if (nextBlockSize < kMaxBlockSize)
+			nextBlockSize *= 2;
+
+		auto block = static_cast<Block*>(std::malloc(size));
+		if (!block)
+			throw std::bad_alloc();
+		block->next = blocks;
+		blocks = block;
+		cursor = reinterpret_cast<char*>(block + 1);
+		limit = reinterpret_cast<char*>(block) + size;
+		reserved += size;
+	}
+};
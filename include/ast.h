@@ -1,24 +1,41 @@
 #pragma once
 
+#include "Token.h"
+#include "arena.h"
+#include <cstdint>
 #include <iostream>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
 
 class Visitor;
 class NumberNode;
 class BinaryOpNode;
+class ComparisonChainNode;
 class UnaryOpNode;
 class VarNode;
 class AssignmentNode;
 class BooleanNode;
 class StringNode;
+class ListNode;
+class DictNode;
+class IndexNode;
+class IndexAssignmentNode;
 class BlockNode;
 class IfNode;
 class WhileNode;
+class ForRangeNode;
+class ForEachNode;
+class BreakNode;
+class ContinueNode;
 class FunctionCallNode;
 class FunctionDefNode;
 class ReturnNode;
+class Value;
 
+// Nodes are allocated in the Arena of the Program they belong to and are
+// never destroyed one by one, so they only hold arena memory and plain data.
 class ASTNode {
 public:
     virtual ~ASTNode() = default;
@@ -29,31 +46,79 @@ public:
 };
 
 // Visitor interface for AST nodes
+// Nodes are passed mutably so passes like the Resolver can annotate them
 class Visitor {
 public:
-    virtual void visit(const NumberNode& node) = 0;
-    virtual void visit(const BinaryOpNode& node) = 0;
-	virtual void visit(const UnaryOpNode& node) = 0;
-	virtual void visit(const VarNode& node) = 0;
-	virtual void visit(const AssignmentNode& node) = 0;
-	virtual void visit(const BooleanNode& node) = 0;
-	virtual void visit(const StringNode& node) = 0;
-	virtual void visit(const BlockNode& node) = 0;
-	virtual void visit(const IfNode& node) = 0;
-	virtual void visit(const WhileNode& node) = 0;
-	virtual void visit(const FunctionCallNode& node) = 0;
+    virtual void visit(NumberNode& node) = 0;
+    virtual void visit(BinaryOpNode& node) = 0;
+	virtual void visit(ComparisonChainNode& node) = 0;
+	virtual void visit(UnaryOpNode& node) = 0;
+	virtual void visit(VarNode& node) = 0;
+	virtual void visit(AssignmentNode& node) = 0;
+	virtual void visit(BooleanNode& node) = 0;
+	virtual void visit(StringNode& node) = 0;
+	virtual void visit(ListNode& node) = 0;
+	virtual void visit(DictNode& node) = 0;
+	virtual void visit(IndexNode& node) = 0;
+	virtual void visit(IndexAssignmentNode& node) = 0;
+	virtual void visit(BlockNode& node) = 0;
+	virtual void visit(IfNode& node) = 0;
+	virtual void visit(WhileNode& node) = 0;
+	virtual void visit(ForRangeNode& node) = 0;
+	virtual void visit(ForEachNode& node) = 0;
+	virtual void visit(BreakNode& node) = 0;
+	virtual void visit(ContinueNode& node) = 0;
+	virtual void visit(FunctionCallNode& node) = 0;
 	virtual void visit(FunctionDefNode& node) = 0;
 	virtual void visit(ReturnNode& node) = 0;
 };
 
-using ASTNodePtr = std::unique_ptr<ASTNode>;
+using ASTNodePtr = ASTNode*;			// owned by the Program's Arena
+using NodeList = ArenaArray<ASTNodePtr>;
+using NameList = ArenaArray<std::string_view>; // interned in the same Arena
+
+// Operators, decoded from their tokens once by the Parser
+enum class BinaryOp {
+    Add,
+    Sub,
+    Mul,
+    Div,
+    FloorDiv,
+    Mod,
+    Equal,
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+    And,
+    Or,
+    In,
+    NotIn,
+};
+
+enum class UnaryOp {
+    Plus,
+    Minus,
+    Not,
+};
+
+const char* binaryOpSymbol(BinaryOp op);
+const char* unaryOpSymbol(UnaryOp op);
 
-// Number node (terminals)
+// Number node (terminals), parsed by the Lexer. Integer literals stay exact;
+// those too long for 64 bits keep their digits.
 class NumberNode : public ASTNode {
 public:
-    std::string value;
-
-    NumberNode(const std::string val);
+    NumberKind kind;
+    double value = 0.0;         // Float
+    int64_t integer = 0;        // Int
+    std::string_view digits;    // BigInt, in the Program's Arena
+
+    explicit NumberNode(double val);
+    explicit NumberNode(int64_t val);
+    explicit NumberNode(std::string_view bigDigits);
+    Value literal() const;
     std::string toString() const override;
     std::string getNodeType() const override;
 
@@ -62,14 +127,14 @@ public:
     }
 };
 
-// Binary operation node (for now only +, -, *, /)
+// Binary operation node (arithmetic, comparison and logical operators)
 class BinaryOpNode : public ASTNode {
 public:
     ASTNodePtr left;
-    std::string op;
+    BinaryOp op;
     ASTNodePtr right;
 
-    BinaryOpNode(ASTNodePtr l, const std::string& operation, ASTNodePtr r);
+    BinaryOpNode(ASTNodePtr l, BinaryOp operation, ASTNodePtr r);
     std::string toString() const override;
     std::string getNodeType() const override;
 
@@ -78,13 +143,30 @@ public:
     }
 };
 
-// Unary operation node (for now only +, -)
+// a < b <= c ...: two or more comparisons sharing their middle operands, as
+// in Python. Each operand is evaluated once, and evaluation stops at the
+// first comparison that is false. A single comparison is a BinaryOpNode.
+class ComparisonChainNode : public ASTNode {
+public:
+    NodeList operands;          // one more than ops
+    ArenaArray<BinaryOp> ops;
+
+    ComparisonChainNode(NodeList operands, ArenaArray<BinaryOp> ops) : operands(operands), ops(ops) {}
+    std::string toString() const override;
+    std::string getNodeType() const override { return "Comparison"; }
+
+    void accept(Visitor& v) override {
+        v.visit(*this);
+    }
+};
+
+// Unary operation node (+, -, not)
 class UnaryOpNode : public ASTNode {
 public:
-	std::string op;
+	UnaryOp op;
 	ASTNodePtr factor;
 
-    UnaryOpNode(const std::string& operation, ASTNodePtr e);
+    UnaryOpNode(UnaryOp operation, ASTNodePtr e);
     std::string toString() const override;
     std::string getNodeType() const override;
 
@@ -94,11 +176,20 @@ public:
 };
 
 
+// Where the Resolver placed a variable
+enum class VarScope {
+    Unresolved,
+    Local,      // slot in the current function's frame
+    Global      // slot in the module's globals
+};
+
 class VarNode : public ASTNode {
 public:
-    std::string name;
+    std::string_view name;
+    VarScope scope = VarScope::Unresolved;
+    uint32_t slot = 0;
 
-    VarNode(const std::string n);
+    VarNode(std::string_view n);
     std::string toString() const override;
     std::string getNodeType() const override;
 
@@ -112,7 +203,7 @@ public:
     ASTNodePtr varNode;
     ASTNodePtr value;
 
-    AssignmentNode(ASTNodePtr var, ASTNodePtr val) : varNode(std::move(var)), value(std::move(val)) {}
+    AssignmentNode(ASTNodePtr var, ASTNodePtr val) : varNode(var), value(val) {}
 
     std::string toString() const override {
         return varNode->toString() + " = " + value->toString();
@@ -128,12 +219,12 @@ public:
 
 class BooleanNode : public ASTNode {
 public:
-    std::string value;
+    bool value;
 
-    BooleanNode(std::string val) : value(val) {}
+    BooleanNode(bool val) : value(val) {}
 
     std::string toString() const override {
-        return value;
+        return value ? "True" : "False";
     }
 
     std::string getNodeType() const override { return "Boolean"; }
@@ -145,12 +236,12 @@ public:
 
 class StringNode : public ASTNode {
     public:
-    std::string value;
+    std::string_view value;
 
-    StringNode(std::string val) : value(val) {}
+    StringNode(std::string_view val) : value(val) {}
 
     std::string toString() const override {
-        return "\"" + value + "\"";
+        return "\"" + std::string(value) + "\"";
     }
     std::string getNodeType() const override { return "String"; }
 
@@ -159,11 +250,91 @@ class StringNode : public ASTNode {
 	}
 };
 
+// [a, b, ...]
+class ListNode : public ASTNode {
+public:
+    NodeList elements;
+
+    ListNode(NodeList elements) : elements(elements) {}
+
+    std::string toString() const override {
+        std::string result;
+        for (const auto& element : elements) {
+            if (!result.empty()) result += ", ";
+            result += element->toString();
+        }
+        return "[" + result + "]";
+    }
+    std::string getNodeType() const override { return "List"; }
+
+    void accept(Visitor& v) override {
+        v.visit(*this);
+    }
+};
+
+// {k: v, ...}
+class DictNode : public ASTNode {
+public:
+    NodeList items; // key, value, key, value...
+
+    DictNode(NodeList items) : items(items) {}
+
+    std::string toString() const override {
+        std::string result;
+        for (size_t i = 0; i + 1 < items.size(); i += 2) {
+            if (!result.empty()) result += ", ";
+            result += items[i]->toString() + ": " + items[i + 1]->toString();
+        }
+        return "{" + result + "}";
+    }
+    std::string getNodeType() const override { return "Dict"; }
+
+    void accept(Visitor& v) override {
+        v.visit(*this);
+    }
+};
+
+// container[index]
+class IndexNode : public ASTNode {
+public:
+    ASTNodePtr container;
+    ASTNodePtr index;
+
+    IndexNode(ASTNodePtr container, ASTNodePtr index) : container(container), index(index) {}
+
+    std::string toString() const override {
+        return container->toString() + "[" + index->toString() + "]";
+    }
+    std::string getNodeType() const override { return "Index"; }
+
+    void accept(Visitor& v) override {
+        v.visit(*this);
+    }
+};
+
+// container[index] = value. The value is evaluated first, as in Python.
+class IndexAssignmentNode : public ASTNode {
+public:
+    ASTNodePtr target; // IndexNode
+    ASTNodePtr value;
+
+    IndexAssignmentNode(ASTNodePtr target, ASTNodePtr value) : target(target), value(value) {}
+
+    std::string toString() const override {
+        return target->toString() + " = " + value->toString();
+    }
+    std::string getNodeType() const override { return "IndexAssignment"; }
+
+    void accept(Visitor& v) override {
+        v.visit(*this);
+    }
+};
+
 class BlockNode : public ASTNode {
     public:
-    std::vector<ASTNodePtr> statements;
+    NodeList statements;
 
-    BlockNode(std::vector<ASTNodePtr> stmts) : statements(std::move(stmts)) {}
+    BlockNode(NodeList stmts) : statements(stmts) {}
 
     std::string toString() const override {
         std::string result = "Block:\n";
@@ -185,7 +356,7 @@ public:
     ASTNodePtr body;
 	ASTNodePtr elseBody; // Optional else body
 
-    IfNode(ASTNodePtr cond, ASTNodePtr b, ASTNodePtr eb = nullptr) : condition(std::move(cond)), body(std::move(b)), elseBody(std::move(eb)) {}
+    IfNode(ASTNodePtr cond, ASTNodePtr b, ASTNodePtr eb = nullptr) : condition(cond), body(b), elseBody(eb) {}
 
     std::string toString() const override {
         return "If " + condition->toString() + ":\n" + body->toString();
@@ -201,7 +372,7 @@ class WhileNode : public ASTNode {
     ASTNodePtr condition;
     ASTNodePtr body;
 
-    WhileNode(ASTNodePtr cond, ASTNodePtr b) : condition(std::move(cond)), body(std::move(b)) {}
+    WhileNode(ASTNodePtr cond, ASTNodePtr b) : condition(cond), body(b) {}
 
     std::string toString() const override {
         return "While " + condition->toString() + ":\n" + body->toString();
@@ -214,18 +385,86 @@ class WhileNode : public ASTNode {
 	}
 };
 
+// for var in range(start, stop, step), run by the engines on a native
+// integer counter. start and step are optional (null means 0 and 1).
+class ForRangeNode : public ASTNode {
+public:
+    ASTNodePtr varNode; // VarNode
+    ASTNodePtr start;
+    ASTNodePtr stop;
+    ASTNodePtr step;
+    ASTNodePtr body;
+
+    ForRangeNode(ASTNodePtr var, ASTNodePtr start, ASTNodePtr stop, ASTNodePtr step, ASTNodePtr b)
+        : varNode(var), start(start), stop(stop), step(step), body(b) {}
+
+    std::string toString() const override {
+        std::string args = stop->toString();
+        if (start)
+            args = start->toString() + ", " + args;
+        if (step)
+            args += ", " + step->toString();
+        return "For " + varNode->toString() + " in range(" + args + "):\n" + body->toString();
+    }
+
+    std::string getNodeType() const override { return "For"; }
+
+    void accept(Visitor& v) override {
+        v.visit(*this);
+    }
+};
+
+// for var in iterable: over the elements of a list (or the characters of a
+// string); every other for loop is a ForRangeNode
+class ForEachNode : public ASTNode {
+public:
+    ASTNodePtr varNode; // VarNode
+    ASTNodePtr iterable;
+    ASTNodePtr body;
+
+    ForEachNode(ASTNodePtr var, ASTNodePtr iterable, ASTNodePtr b) : varNode(var), iterable(iterable), body(b) {}
+
+    std::string toString() const override {
+        return "For " + varNode->toString() + " in " + iterable->toString() + ":\n" + body->toString();
+    }
+
+    std::string getNodeType() const override { return "ForEach"; }
+
+    void accept(Visitor& v) override {
+        v.visit(*this);
+    }
+};
+
+class BreakNode : public ASTNode {
+public:
+    std::string toString() const override { return "break"; }
+    std::string getNodeType() const override { return "Break"; }
+    void accept(Visitor& v) override {
+        v.visit(*this);
+    }
+};
+
+class ContinueNode : public ASTNode {
+public:
+    std::string toString() const override { return "continue"; }
+    std::string getNodeType() const override { return "Continue"; }
+    void accept(Visitor& v) override {
+        v.visit(*this);
+    }
+};
+
 class FunctionCallNode : public ASTNode {
     public:
-    std::string funcName;
-    std::vector<ASTNodePtr> arguments;
-    FunctionCallNode(const std::string& name, std::vector<ASTNodePtr> args) : funcName(name), arguments(std::move(args)) {}
+    std::string_view funcName;
+    NodeList arguments;
+    FunctionCallNode(std::string_view name, NodeList args) : funcName(name), arguments(args) {}
     std::string toString() const override {
         std::string argsStr;
         for (const auto& arg : arguments) {
             if (!argsStr.empty()) argsStr += ", ";
             argsStr += arg->toString();
         }
-        return funcName + "(" + argsStr + ")";
+        return std::string(funcName) + "(" + argsStr + ")";
     }
     std::string getNodeType() const override { return "FunctionCall"; }
 
@@ -236,12 +475,19 @@ class FunctionCallNode : public ASTNode {
 
 class FunctionDefNode : public ASTNode {
 public:
-    std::string funcName;
-    std::vector<std::string> parameters;
+    std::string_view funcName;
+    NameList parameters;
     ASTNodePtr body;
+    NameList localNames; // frame layout from the Resolver, parameters first
+    NameList prunedLocals; // assigned only in branches the Optimizer removed, locals all the same
+    // Parsed lazily: body is null and source holds the whole definition
+    // until an engine parses it on the first call
+    std::string_view source;
 
-    FunctionDefNode(const std::string& name, std::vector<std::string> params, ASTNodePtr b)
-        : funcName(name), parameters(std::move(params)), body(std::move(b)) {}
+    FunctionDefNode(std::string_view name, NameList params, ASTNodePtr b)
+        : funcName(name), parameters(params), body(b) {}
+    FunctionDefNode(std::string_view name, NameList params, std::string_view source)
+        : funcName(name), parameters(params), body(nullptr), source(source) {}
 
  
     std::string toString() const override {
@@ -250,7 +496,9 @@ public:
             if (!paramsStr.empty()) paramsStr += ", ";
             paramsStr += param;
         }
-        return "def " + funcName + "(" + paramsStr + "):\n" + body->toString();
+        if (!body)
+            return std::string(source);
+        return "def " + std::string(funcName) + "(" + paramsStr + "):\n" + body->toString();
     }
 
     std::string getNodeType() const override { return "FunctionDef"; }
@@ -265,12 +513,21 @@ public:
 class ReturnNode : public ASTNode {
     public:
     ASTNodePtr value;
-    ReturnNode(ASTNodePtr val) : value(std::move(val)) {}
+    ReturnNode(ASTNodePtr val) : value(val) {}
     std::string toString() const override {
-        return "return " + value->toString();
+        return value ? "return " + value->toString() : "return";
     }
     std::string getNodeType() const override { return "Return"; }
     void accept(Visitor& v) override {
 		v.visit(*this);
 	}
-};
\ No newline at end of file
+};
+
+
+// What Parser::parse() produces: the root block and the Arena holding every
+// node and name of the tree. Copies share the arena, which is freed in one
+// go when the last of them is gone.
+struct Program {
+    std::shared_ptr<Arena> arena;
+    ASTNodePtr root = nullptr;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Arbitrary precision integer, what integer arithmetic promotes to when a
+// result leaves the 64 bit range. Sign and magnitude, the magnitude in 32
+// bit limbs, least significant first, without leading zero limbs (zero has
+// none and is never negative).
+class BigInt {
+public:
+	BigInt() = default;
+	explicit BigInt(int64_t v);
+
+	// Decimal digits with an optional leading '-'
+	static BigInt fromDecimal(std::string_view digits);
+	// `d` must be finite and integral
+	static BigInt fromDouble(double d);
+
+	bool isZero() const { return limbs.empty(); }
+	bool isNegative() const { return negative; }
+	bool fitsInt64(int64_t& out) const;
+	double toDouble() const; // correctly rounded, +-inf past the double range
+	std::string toString() const;
+
+	BigInt operator-() const;
+	friend BigInt operator+(const BigInt& a, const BigInt& b);
+	friend BigInt operator-(const BigInt& a, const BigInt& b);
+	friend BigInt operator*(const BigInt& a, const BigInt& b);
+
+	// Floor division and the matching remainder (which takes the sign of
+	// `b`), like Python's // and %. `b` must not be zero.
+	static void floorDivMod(const BigInt& a, const BigInt& b, BigInt* quotient, BigInt* remainder);
+
+	// -1, 0 or 1
+	static int compare(const BigInt& a, const BigInt& b);
+
+private:
+	using Limbs = std::vector<uint32_t>;
+
+	Limbs limbs;
+	bool negative = false;
+
+	void trim();
+	static BigInt signedSum(const BigInt& a, const BigInt& b, bool negateB);
+};
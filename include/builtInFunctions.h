@@ -15,3 +15,6 @@ Value printlnFunc(const std::vector<Value>& args);
 Value maxFunc(const std::vector<Value>& args);
 Value minFunc(const std::vector<Value>& args);
 Value nowFunc(const std::vector<Value>& args);
+Value lenFunc(const std::vector<Value>& args);
+Value appendFunc(const std::vector<Value>& args);	// also xs.append(v)
+Value sumFunc(const std::vector<Value>& args);
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "value.h"
+#include "builtInFunctions.h"
+#include "resolver.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Bytecode instruction set for the VM.
+// Every instruction is one 32 bit word: the low 8 bits hold the opcode and
+// the high 24 bits hold its operand (slot, constant index, jump target...).
+enum class OpCode : uint8_t {
+	CONSTANT,		// push constants[arg]
+	NONE,			// push Value()
+	TRUE_,			// push True
+	FALSE_,			// push False
+	POP,			// discard top of stack
+
+	LOAD_LOCAL,		// push frame slot arg
+	STORE_LOCAL,	// pop into frame slot arg
+	LOAD_GLOBAL,	// push global slot arg
+	STORE_GLOBAL,	// pop into global slot arg
+
+	ADD,
+	SUB,
+	MUL,
+	DIV,
+	FLOORDIV,
+	MOD,
+	EQ,
+	NE,
+	LT,
+	LE,
+	GT,
+	GE,
+	COMPARE_CHAIN,	// arg: BinaryOp; [a b] -> [b, a op b], keeps b for the next comparison
+	NEG,
+	NOT,
+
+	BUILD_LIST,		// pop arg values, push a list of them
+	INDEX,			// [container index] -> [container[index]]
+	STORE_INDEX,	// [value container index] -> [], container[index] = value
+	BUILD_DICT,		// pop 2 * arg values, keys and values alternating, push a dict of them
+	IN,				// [item container] -> [item in container]
+	NOT_IN,
+
+	JUMP,			// ip = arg
+	JUMP_IF_FALSE,	// pop, ip = arg if falsy
+	JUMP_IF_FALSE_OR_POP,	// ip = arg if top is falsy, leaving it; else pop (and)
+	JUMP_IF_TRUE_OR_POP,	// ip = arg if top is truthy, leaving it; else pop (or)
+	RANGE_SETUP,	// check the start, stop, step on top of the stack: integers, step not zero
+	FOR_RANGE,		// range state (next, stop, step) on top: push next and advance, ip = arg when done
+	FOR_EACH,		// [iterable position] on top: push the item at position and advance, ip = arg when done
+
+	CALL,			// arg = function slot << 8 | argc
+	CALL_BUILTIN,	// arg = builtin index << 8 | argc
+	RETURN,			// pop return value and leave the frame
+	DEF_FUNCTION,	// bind functions[arg] to its name
+};
+
+using Instruction = uint32_t;
+
+constexpr uint32_t kMaxOperand = 0xFFFFFF;
+
+inline Instruction encode(OpCode op, uint32_t arg = 0) {
+	return static_cast<uint32_t>(op) | (arg << 8);
+}
+inline OpCode opcodeOf(Instruction ins) { return static_cast<OpCode>(ins & 0xFF); }
+inline uint32_t operandOf(Instruction ins) { return ins >> 8; }
+
+// A compiled function (or the top level of a script)
+struct FunctionProto {
+	std::string name;
+	uint32_t arity = 0;
+	uint32_t nameSlot = 0;			// slot in Module::functionNames
+	std::vector<std::string> localNames; // parameters first, then other locals
+	uint32_t maxStack = 0;			// deepest temporary stack use in this body
+	std::vector<Instruction> code;
+	std::vector<Value> constants;
+	std::string lazySource;			// definition to compile on the first call while code is empty
+
+	uint32_t frameSize() const { return static_cast<uint32_t>(localNames.size()) + maxStack; }
+};
+
+// Everything the Compiler and the VM share. It outlives a single compilation
+// so the REPL can keep adding globals and functions line by line.
+struct Module {
+	std::vector<std::unique_ptr<FunctionProto>> functions;
+
+	GlobalScope globals;
+
+	std::vector<std::string> functionNames;
+	std::unordered_map<std::string, uint32_t> functionSlots;
+
+	std::vector<std::string> builtinNames;
+	std::vector<BuiltinFunc> builtins;
+	std::unordered_map<std::string, uint32_t> builtinSlots;
+
+	bool optimizeLazyBodies = true;	// run lazily compiled bodies through the Optimizer
+
+	uint32_t functionSlot(const std::string& name);
+	void addBuiltin(const std::string& name, BuiltinFunc func);
+};
+
+const char* opcodeName(OpCode op);
+std::string disassemble(const FunctionProto& proto);
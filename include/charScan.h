@@ -0,0 +1,30 @@
+#pragma once
+
+// Character classes and run scanning for the Lexer. The classes are plain
+// ASCII (what <cctype> gives in the "C" locale) without the locale lookup.
+inline bool isDigitChar(char c) { return static_cast<unsigned char>(c - '0') < 10; }
+inline bool isLetterChar(char c) { return static_cast<unsigned char>((c | 0x20) - 'a') < 26; }
+inline bool isIdentifierStart(char c) { return isLetterChar(c) || c == '_'; }
+inline bool isIdentifierChar(char c) { return isIdentifierStart(c) || isDigitChar(c); }
+
+enum class ScanIsa { Scalar, SSE2, AVX2 };
+
+// Each function returns the end of the run starting at p: the first
+// position in [p, end) that does not belong to it, or end. The SIMD
+// versions test 16 or 32 bytes per step and agree with Scalar exactly.
+struct CharScanner {
+	ScanIsa isa;
+	const char* (*identifierEnd)(const char* p, const char* end);	// [A-Za-z0-9_]*
+	const char* (*digitsEnd)(const char* p, const char* end);		// [0-9]*
+	const char* (*spacesEnd)(const char* p, const char* end);		// ' '*
+	const char* (*stringEnd)(const char* p, const char* end);		// up to the next '"' or NUL
+};
+
+// Widest implementation this CPU supports, detected on first use
+const CharScanner& defaultScanner();
+
+// A specific implementation, e.g. to compare them. Falls back to Scalar
+// when the CPU (or the build target) does not support `isa`.
+const CharScanner& scannerFor(ScanIsa isa);
+bool scanIsaSupported(ScanIsa isa);
+const char* scanIsaName(ScanIsa isa);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "bytecode.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// On-disk cache of compiled scripts, so a later run can start executing
+// without lexing, parsing, optimizing or compiling. A cache file holds the
+// Module a script compiled to: every FunctionProto with its code and
+// constants, plus the global, function and builtin names their operands
+// refer to. Bump kCodeCacheVersion whenever that layout or the meaning of
+// the bytecode changes; files of other versions are ignored.
+constexpr uint32_t kCodeCacheVersion = 8;
+
+// Identifies what a cache file was compiled from: the source text and the
+// switches that change the generated code. A lazy cache may hold functions
+// that are still stubs, compiled from their source on the first call.
+uint64_t codeCacheKey(std::string_view source, bool optimized, bool lazy);
+
+// Cache file for `scriptPath`: in `cacheDir` if one is given, otherwise in
+// a __cppycache__ directory next to the script
+std::string codeCachePath(const std::string& scriptPath, const std::string& cacheDir);
+
+// Write `module`, compiled with `script` as its top level. Functions that
+// are still lazy stubs are written as their source. The file is replaced
+// atomically, so concurrent runs never see half of it. Returns false (and
+// leaves no file behind) if it cannot be written.
+bool saveCodeCache(const std::string& path, uint64_t key, const Module& module, const FunctionProto& script);
+
+// Load a cache file into `module`, which must not have compiled anything
+// yet. Returns the top level to execute, or nullptr if the file is missing,
+// stale (other key or version) or damaged.
+const FunctionProto* loadCodeCache(const std::string& path, uint64_t key, Module& module);
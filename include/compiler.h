@@ -0,0 +1,67 @@
+#pragma once
+
+#include "ast.h"
+#include "bytecode.h"
+#include <string>
+#include <vector>
+
+// Lowers the AST produced by Parser::parse() into bytecode for the VM.
+// Variables are addressed by the slots the Resolver assigns.
+class Compiler : public Visitor {
+public:
+	explicit Compiler(Module& module) : module(module) {}
+
+	// Compile a whole program; the returned code leaves the value of a
+	// trailing expression statement as its result (used by the REPL).
+	FunctionProto* compile(Program& program);
+	// Compile the body of a function that was parsed lazily, in place of
+	// its stub. Parse errors are thrown as by Parser::parse().
+	void compileLazy(FunctionProto& proto);
+
+	void visit(NumberNode& node) override;
+	void visit(BinaryOpNode& node) override;
+	void visit(ComparisonChainNode& node) override;
+	void visit(UnaryOpNode& node) override;
+	void visit(VarNode& node) override;
+	void visit(AssignmentNode& node) override;
+	void visit(BooleanNode& node) override;
+	void visit(StringNode& node) override;
+	void visit(ListNode& node) override;
+	void visit(DictNode& node) override;
+	void visit(IndexNode& node) override;
+	void visit(IndexAssignmentNode& node) override;
+	void visit(BlockNode& node) override;
+	void visit(IfNode& node) override;
+	void visit(WhileNode& node) override;
+	void visit(ForRangeNode& node) override;
+	void visit(ForEachNode& node) override;
+	void visit(BreakNode& node) override;
+	void visit(ContinueNode& node) override;
+	void visit(FunctionCallNode& node) override;
+	void visit(FunctionDefNode& node) override;
+	void visit(ReturnNode& node) override;
+
+private:
+	// A loop being compiled: where continue jumps to, and the break jumps
+	// to patch once its end is known
+	struct Loop {
+		uint32_t continueTarget;
+		std::vector<size_t> breaks;
+	};
+
+	Module& module;
+	FunctionProto* current = nullptr;
+	uint32_t stackDepth = 0;
+	bool inExpression = false;
+	std::vector<Loop> loops;	// of the function being compiled, innermost last
+
+	void functionBody(FunctionProto& proto, FunctionDefNode& node);
+	void statement(ASTNode& node);
+	void expression(ASTNode& node);
+
+	void emit(OpCode op, uint32_t arg = 0);
+	size_t emitJump(OpCode op);
+	void patchJump(size_t at);
+	uint32_t addConstant(const Value& value);
+	FunctionProto* newFunction(const std::string& name);
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "swissMap.h"
+#include "value.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Hashing and equality of dict keys, consistent with ==: 1, 1.0 and True
+// are the same key, a string equals only a string. Lists and dicts cannot
+// be keys.
+struct DictKeyHash {
+	uint64_t operator()(const Value& key) const;
+};
+struct DictKeyEqual {
+	bool operator()(const Value& a, const Value& b) const;
+};
+
+// A dict, iterated (and printed) in insertion order. String keys hash once,
+// the hash is kept in the string; two interned strings (literals) are the
+// same key only if they are the same object.
+//
+// Dicts are reference counted like every Object, so a dict that ends up
+// containing itself is never freed.
+struct DictObject : Object {
+	DictObject() : Object(Kind::Dict) {}
+
+	size_t size() const { return items.size(); }
+	void reserve(size_t count) { items.reserve(count); }
+
+	// Null when `key` is absent; throws when it cannot be a key
+	const Value* find(const Value& key) const { return items.find(key); }
+	void set(const Value& key, const Value& value) { items.insertOrAssign(key, value); }
+
+	// Entries in insertion order; there is no removal, so `index` < size()
+	// always names an entry
+	const Value& keyAt(size_t index) const { return items.entry(index).key; }
+	const Value& valueAt(size_t index) const { return items.entry(index).value; }
+
+	std::string repr() const; // {'a': 1, 2: [3]}
+
+private:
+	SwissMap<Value, Value, DictKeyHash, DictKeyEqual> items;
+};
+
+// A new dict from `count` key, value pairs (2 * count values); a repeated
+// key keeps its first position and its last value
+Value makeDict(const Value* pairs, size_t count);
+
+// Same keys with equal values, in any order
+bool dictsEqual(const DictObject& a, const DictObject& b);
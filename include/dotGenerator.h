@@ -1,24 +1,35 @@
 #pragma once
 
 #include "ast.h"
+#include "flatAst.h"
 #include <string>
 #include <vector>
 
 class DotGenerator : Visitor {
 public:
-    std::string generate(const ASTNodePtr root);
-
-    void visit(const NumberNode& node) override;
-    void visit(const BinaryOpNode& node) override;
-    void visit(const UnaryOpNode& node) override;
-	void visit(const VarNode& node) override;
-	void visit(const AssignmentNode& node) override;
-	void visit(const BooleanNode& node) override;
-	void visit(const StringNode& node) override;
-	void visit(const BlockNode& node) override;
-	void visit(const IfNode& node) override;
-	void visit(const WhileNode& node) override;
-    void visit(const FunctionCallNode& node) override;
+    std::string generate(ASTNode& root);
+    std::string generate(const FlatAst& ast); // same output as for the equivalent tree
+
+    void visit(NumberNode& node) override;
+    void visit(BinaryOpNode& node) override;
+    void visit(ComparisonChainNode& node) override;
+    void visit(UnaryOpNode& node) override;
+	void visit(VarNode& node) override;
+	void visit(AssignmentNode& node) override;
+	void visit(BooleanNode& node) override;
+	void visit(StringNode& node) override;
+	void visit(ListNode& node) override;
+	void visit(DictNode& node) override;
+	void visit(IndexNode& node) override;
+	void visit(IndexAssignmentNode& node) override;
+	void visit(BlockNode& node) override;
+	void visit(IfNode& node) override;
+	void visit(WhileNode& node) override;
+	void visit(ForRangeNode& node) override;
+	void visit(ForEachNode& node) override;
+	void visit(BreakNode& node) override;
+	void visit(ContinueNode& node) override;
+    void visit(FunctionCallNode& node) override;
     void visit(FunctionDefNode& node) override;
 	void visit(ReturnNode& node) override;
 
@@ -32,6 +43,8 @@ private:
 
     std::vector<NodeId> stack;
 
+    std::string flatNode(const FlatAst& ast, FlatIndex node); // returns the node's id
+
     std::string newId() {
         return "n" + std::to_string(counter++);
     }
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "arena.h"
+#include "ast.h"
+#include "value.h"
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Compact, pointer free form of the AST. Nodes are numbered and their fields
+// kept in parallel arrays, children are referenced by 32 bit index. Walking it
+// is a switch over `kinds` instead of a virtual call per node, and a node costs
+// 10 bytes plus 4 per list entry instead of a heap object.
+enum class FlatKind : uint8_t {
+	Number,			// a: index into numbers
+	BinaryOp,		// op: BinaryOp, a: left, b: right
+	ComparisonChain,	// a: first entry in lists, the first operand then an (op, operand) pair per comparison; b: comparison count
+	UnaryOp,		// op: UnaryOp, a: operand
+	Var,			// a: index into names; after resolving op: VarScope, b: slot
+	Assignment,		// a: Var node, b: value
+	Boolean,		// op: value
+	String,			// a: index into names
+	List,			// a: first entry in lists, b: element count
+	Dict,			// a: first entry in lists, keys and values alternating, b: pair count
+	Index,			// a: container, b: index
+	IndexAssignment,	// a: Index node, b: value
+	Block,			// a: first entry in lists, b: statement count
+	If,				// a: condition, b: first of two entries in lists, body then else body (or kNoNode)
+	While,			// a: condition, b: body
+	ForRange,		// a: Var node, b: first of four entries in lists, start (or kNoNode), stop, step (or kNoNode), body
+	ForEach,		// a: Var node, b: first of two entries in lists, iterable then body
+	Break,
+	Continue,
+	FunctionCall,	// a: index into names, b: entry in lists holding the argument count, arguments follow
+	FunctionDef,	// a: index into names, b: index into functions
+	Return,			// a: value or kNoNode
+};
+
+using FlatIndex = uint32_t;
+constexpr FlatIndex kNoNode = UINT32_MAX;
+
+struct FlatFunction {
+	FlatIndex body = kNoNode;
+	uint32_t params = 0;		// run of name indices in lists
+	uint32_t paramCount = 0;
+	uint32_t locals = 0;		// frame layout from resolveFlat(): run in localNames, parameters first
+	uint32_t localCount = 0;
+};
+
+struct FlatAst {
+	// One entry per node
+	std::vector<FlatKind> kinds;
+	std::vector<uint8_t> ops;
+	std::vector<uint32_t> a, b;
+
+	// Payloads
+	std::vector<Value> numbers;
+	std::vector<std::string_view> names;	// identifiers and string literals, each stored once
+	std::vector<uint32_t> lists;			// child (or name) indices of blocks, calls and parameter lists
+	std::vector<FlatFunction> functions;
+	std::vector<uint32_t> localNames;		// name indices, written by resolveFlat()
+	std::shared_ptr<Arena> strings;			// characters behind names
+
+	FlatIndex root = kNoNode;
+
+	size_t size() const { return kinds.size(); }
+	FlatKind kind(FlatIndex node) const { return kinds[node]; }
+	BinaryOp binaryOp(FlatIndex node) const { return static_cast<BinaryOp>(ops[node]); }
+	UnaryOp unaryOp(FlatIndex node) const { return static_cast<UnaryOp>(ops[node]); }
+	std::string_view name(FlatIndex node) const { return names[a[node]]; }
+	const uint32_t* list(uint32_t first) const { return lists.data() + first; }
+	const FlatFunction& function(FlatIndex node) const { return functions[b[node]]; }
+
+	// Bytes held by the arrays, for comparing with the pointer tree
+	size_t memoryUsed() const;
+};
+
+// Node factory the Parser uses to emit a FlatAst directly (see TreeBuilder)
+class FlatBuilder {
+public:
+	using Node = FlatIndex;
+	using Result = FlatAst;
+	static constexpr Node none = kNoNode;
+	static constexpr bool kLazyBodies = false;
+
+	FlatBuilder();
+
+	void reserveFor(size_t sourceBytes); // size the arrays up front, finish() trims them
+
+	std::string_view intern(std::string_view s);
+
+	Node number(const Token& token);
+	Node binary(Node left, BinaryOp op, Node right);
+	Node comparisonChain(const Node* operands, const BinaryOp* ops, size_t opCount);
+	Node unary(UnaryOp op, Node operand);
+	Node var(std::string_view name);
+	Node assignment(Node var, Node value);
+	Node boolean(bool value);
+	Node string(std::string_view value);
+	Node list(const Node* elements, size_t count);
+	Node dict(const Node* items, size_t pairCount);
+	Node index(Node container, Node index);
+	bool isIndex(Node node) const { return ast.kinds[node] == FlatKind::Index; }
+	Node indexAssignment(Node target, Node value);
+	Node block(const Node* statements, size_t count);
+	Node ifNode(Node condition, Node body, Node elseBody);
+	Node whileNode(Node condition, Node body);
+	Node forRange(Node var, Node start, Node stop, Node step, Node body);
+	Node forEach(Node var, Node iterable, Node body);
+	Node breakNode();
+	Node continueNode();
+	Node call(std::string_view name, const Node* args, size_t count);
+	Node functionDef(std::string_view name, const std::string_view* params, size_t count, Node body);
+	Node returnNode(Node value);
+
+	Result finish(Node root);
+
+private:
+	FlatAst ast;
+	std::unordered_map<std::string_view, uint32_t> nameIndex;
+	uint32_t lastInterned = 0; // the name a node is usually built from right after intern()
+
+	Node add(FlatKind kind, uint32_t a = 0, uint32_t b = 0, uint8_t op = 0);
+	uint32_t nameFor(std::string_view name);
+	uint32_t addList(const uint32_t* items, size_t count);
+};
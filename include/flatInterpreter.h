@@ -0,0 +1,63 @@
+#pragma once
+
+#include "flatAst.h"
+#include "interpreter.h"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Tree-walking interpreter over the FlatAst. Same semantics as Interpreter,
+// but every node is a switch on its kind and a few array reads.
+class FlatInterpreter {
+public:
+	FlatInterpreter();
+
+	// Resolve and run a program. It is kept if it defines functions, so
+	// later programs (REPL lines, streamed statements) can call them.
+	Value interpret(FlatAst program);
+
+	// Names of the functions that were active when an error was thrown
+	std::vector<std::string> backtrace() const;
+
+private:
+	struct Function {
+		const FlatAst* ast;
+		FlatIndex node;		// the FunctionDef
+	};
+
+	// Array bases of the running program, so a node is one load per field
+	struct View {
+		const FlatKind* kinds;
+		const uint8_t* ops;
+		const uint32_t *a, *b, *lists;
+		const Value* numbers;
+	};
+
+	static constexpr size_t kArenaSlots = 1 << 16;
+
+	std::vector<std::unique_ptr<FlatAst>> programs;
+	const FlatAst* code = nullptr;	// program of the running code
+	View view{};					// its arrays
+	GlobalScope globalScope;
+	std::vector<Value> globals;		// indexed by GlobalScope slot
+	Value* locals = nullptr;		// frame of the running function
+	FrameArena arena;
+	std::vector<Function> frames;
+	const std::string_view* activeBuiltin = nullptr;
+	Value result;
+	Completion completion = Completion::Normal;
+	std::unordered_map<std::string_view, BuiltinFunc> builtins;
+	std::unordered_map<std::string_view, Function> definedFunctions;
+
+	void setCode(const FlatAst* ast);
+	void releaseUnlessDefining(size_t functionCount);
+	void eval(FlatIndex node);
+	void forRange(FlatIndex node);
+	void forEach(FlatIndex node);
+	bool loopExits();
+	void call(FlatIndex node);
+	void define(FlatIndex node);
+	[[noreturn]] void undefinedVariable(FlatIndex node) const;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "value.h"
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Deepest call nesting allowed by both execution engines
+constexpr size_t kMaxCallDepth = 1000;
+
+// Preallocated storage for the locals of active calls. Frames are carved off
+// the top and released in LIFO order, so making a call never touches the heap
+// and costs the same however many variables exist elsewhere.
+class FrameArena {
+public:
+	explicit FrameArena(size_t capacity) : slots(capacity), top(0) {}
+
+	// Reserve `count` slots, all undefined
+	Value* push(size_t count) {
+		Value* frame = slots.data() + top;
+		grow(frame, count);
+		return frame;
+	}
+
+	// Resize the topmost frame (it must be `frame`) to `count` slots
+	void grow(Value* frame, size_t count) {
+		size_t start = frame - slots.data();
+		if (start + count > slots.size())
+			throw std::runtime_error("Stack overflow");
+		for (size_t i = top; i < start + count; i++)
+			slots[i] = Value::undefined();
+		top = start + count;
+	}
+
+	// Release `frame` and everything above it
+	void pop(Value* frame) { top = frame - slots.data(); }
+
+	void reset() { top = 0; }
+
+private:
+	std::vector<Value> slots;
+	size_t top;
+};
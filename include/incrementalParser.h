@@ -0,0 +1,63 @@
+#pragma once
+
+#include "ast.h"
+#include "optimizer.h"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Keeps a script parsed while it is being edited. The buffer is held as its
+// top-level statements (split by StatementSplitter), each with its own text
+// and tree. An edit re-splits and re-parses only from the statement before
+// the edited one up to the first statement boundary after the edit that is
+// unchanged; every other statement keeps its tree. The cost of an edit
+// depends on the statements it touches, not on the size of the buffer.
+//
+// Each statement is parsed on its own, so an error only affects the
+// statement it is in. The trees are shared with every Program handed out.
+// The Resolver may annotate them in place. Rewrites must go through
+// optimize(), which puts new nodes in the statement's own arena: the
+// Optimizer run on a Program would link the shared trees to that Program's
+// arena, which dies with it.
+class IncrementalParser {
+public:
+	explicit IncrementalParser(std::string_view text = {});
+
+	// Replace `removed` bytes at `offset` with `inserted`. Throws
+	// std::out_of_range if the range is not inside the buffer.
+	void edit(size_t offset, size_t removed, std::string_view inserted);
+
+	std::string text() const;
+	size_t size() const { return statements.empty() ? 0 : begins.back() + statements.back().text.size(); }
+	size_t statementCount() const { return statements.size(); }
+	// Offset of the top-level statement `index` in the buffer
+	size_t statementBegin(size_t index) const { return begins[index]; }
+	// Statements re-parsed by the last edit
+	size_t lastReparsed() const { return reparsed; }
+
+	// The statements from `first` on as one program; those that failed to
+	// parse are left out. The program stays valid after later edits.
+	Program program(size_t first = 0) const;
+	// Optimizes the statements from `first` on that are not yet, each once
+	// per parse, and returns the totals
+	OptimizerStats optimize(size_t first = 0);
+	// First parse error from statement `first` on, in source order; empty if none
+	std::string error(size_t first = 0) const;
+
+private:
+	struct Statement {
+		std::string text;	// with its trailing newline and any blank lines after it
+		Program tree;		// root is a BlockNode; null if it failed to parse
+		std::string error;
+		bool optimized = false;
+	};
+
+	std::vector<Statement> statements;
+	std::vector<size_t> begins;	// offset of each statement, kept apart so shifting them is cheap
+	size_t failed = 0;	// statements with an error
+	size_t reparsed = 0;
+
+	size_t statementAt(size_t offset) const;
+	static Statement parse(std::string text);
+};
@@ -3,7 +3,10 @@
 #include "ast.h"
 #include "value.h"
 #include "builtInFunctions.h"
+#include "resolver.h"
+#include "frameArena.h"
 #include <string>
+#include <string_view>
 #include <memory>
 #include <unordered_map>
 #include <variant>
@@ -11,37 +14,75 @@
 
 
 
+// How the last statement finished. Anything but Normal unwinds the
+// enclosing blocks until the construct that handles it.
+enum class Completion {
+	Normal,
+	Return,		// result holds the returned value
+	Break,
+	Continue,
+};
+
 class Interpreter : public Visitor {
 public:
-	ASTNodePtr tree;
-	std::vector<std::string> callStack;
+	Program program;
 
-	Interpreter(ASTNodePtr t) : result(0.0), tree(std::move(t)) { registetrBuiltins();  }
+	Interpreter(Program p) : result(0.0), program(std::move(p)), arena(kArenaSlots) { frames.reserve(kMaxCallDepth); registetrBuiltins(); }
 
 	Value interpret();
 
+	bool optimizeLazyBodies = true;	// run lazily parsed bodies through the Optimizer
+
+	// Names of the functions that were active when an error was thrown
+	std::vector<std::string> backtrace() const;
+
 	void printVariables() const;
 
-	void visit(const NumberNode& node) override;
-	void visit(const BinaryOpNode& node) override;
-	void visit(const UnaryOpNode& node) override;
-	void visit(const VarNode& node) override;
-	void visit(const AssignmentNode& node) override;
-	void visit(const BooleanNode& node) override;
-	void visit(const StringNode& node) override;
-    void visit(const BlockNode& node) override;
-	void visit(const IfNode& node) override;
-	void visit(const WhileNode& node) override;
-    void visit(const FunctionCallNode& node) override;
+	void visit(NumberNode& node) override;
+	void visit(BinaryOpNode& node) override;
+	void visit(ComparisonChainNode& node) override;
+	void visit(UnaryOpNode& node) override;
+	void visit(VarNode& node) override;
+	void visit(AssignmentNode& node) override;
+	void visit(BooleanNode& node) override;
+	void visit(StringNode& node) override;
+	void visit(ListNode& node) override;
+	void visit(DictNode& node) override;
+	void visit(IndexNode& node) override;
+	void visit(IndexAssignmentNode& node) override;
+    void visit(BlockNode& node) override;
+	void visit(IfNode& node) override;
+	void visit(WhileNode& node) override;
+	void visit(ForRangeNode& node) override;
+	void visit(ForEachNode& node) override;
+	void visit(BreakNode& node) override;
+	void visit(ContinueNode& node) override;
+    void visit(FunctionCallNode& node) override;
 	void visit(FunctionDefNode& node) override;
 	void visit(ReturnNode& node) override;
 
 private:
-	std::unordered_map<std::string, Value> variables;
+	struct CallFrame {
+		const FunctionDefNode* function;
+		Value* locals;
+	};
+
+	static constexpr size_t kArenaSlots = 1 << 16;
+
+	GlobalScope globalScope;
+	std::vector<Value> globals;	// indexed by GlobalScope slot
+	Value* locals = nullptr;	// frame of the running function, slots from the Resolver
+	FrameArena arena;			// storage behind every CallFrame::locals
+	std::vector<CallFrame> frames;
+	const std::string_view* activeBuiltin = nullptr;
     Value result;
-	std::unordered_map<std::string, BuiltinFunc> builtins;
-	std::unordered_map<std::string, std::unique_ptr<FunctionDefNode>> definedFunctions;
+	Completion completion = Completion::Normal;
+	std::unordered_map<std::string_view, BuiltinFunc> builtins;
+	std::unordered_map<std::string_view, const FunctionDefNode*> definedFunctions; // lazy stubs until first called
+	std::vector<std::shared_ptr<Arena>> definitionArenas; // keep defined functions alive after their program
 
 	void registetrBuiltins();
+	bool loopExits();
+	const FunctionDefNode* parseLazy(const FunctionDefNode& stub);
 };
 
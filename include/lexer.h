@@ -1,24 +1,46 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector> 
 #include "Token.h"
+#include "charScan.h"
 
 class Lexer {
 public:
-    explicit Lexer(const std::string& text);
+    // The source is not copied: it must outlive the Lexer and its tokens
+    explicit Lexer(std::string_view text, const CharScanner& scanner = defaultScanner());
     Token getNextToken();
-	Token peekNextToken(); // lookahead without consuming
+	// Lookahead without consuming: peekNextToken(1) is the token the next
+	// getNextToken() returns. Peeked tokens are kept, so nothing is lexed twice.
+	const Token& peekNextToken(size_t k = 1);
+	static constexpr size_t kMaxLookahead = 4;
+	size_t sourceSize() const { return text.size(); }
+	std::string_view source() const { return text; }
+	// Skip the indented block that follows the NEWLINE just returned, without
+	// tokenizing it; `end` becomes the offset just past its last line. The
+	// block is only delimited by indentation (and string literals spanning
+	// lines), so errors inside it go unnoticed. False, with nothing
+	// skipped, if no more deeply indented line follows.
+	bool skipBlock(size_t& end);
     
 private:
-    std::string text;
+    std::string_view text;
+    const CharScanner& scanner;
     size_t pos;
     char currentChar;
     std::vector<int> indentStack = { 0 };
     int pendingDedents;
     bool lastWasNewline;
+    Token lookahead[kMaxLookahead];	// ring buffer of tokens lexed ahead
+    size_t lookaheadHead = 0;
+    size_t lookaheadCount = 0;
+    Token scan();
     void advance();
+    void skipTo(const char* p);		// move to a position found by the scanner
+    const char* cursor() const { return text.data() + pos; }
+    const char* end() const { return text.data() + text.size(); }
     void skipWhitespace();
-    std::string number();
-	std::string identifier();
+    std::string_view number();
+	std::string_view identifier();
 };
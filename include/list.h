@@ -0,0 +1,62 @@
+#pragma once
+
+#include "value.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A list's elements, kept unboxed while they allow it: a list of only ints
+// (that fit 64 bits) is a plain int64_t array, a list of only floats a double
+// array, so the builtins can run over them with the SIMD kernels of
+// listKernels.h. The first element of an empty list picks the storage; the
+// first element that does not fit it (a bool, a string, an int among floats
+// or the other way round...) boxes the whole list for good.
+//
+// Lists are reference counted like every Object, so a list that ends up
+// containing itself is never freed.
+struct ListObject : Object {
+	enum class Storage : uint8_t { Ints, Doubles, Boxed };
+
+	ListObject() : Object(Kind::List) {}
+
+	Storage storage() const { return mode; }
+	size_t size() const;
+	void reserve(size_t count);
+
+	// `index` is in range
+	Value get(size_t index) const;
+	void set(size_t index, const Value& value);
+	void append(const Value& value);
+	// Append the elements of `other`, which may be this list
+	void extend(const ListObject& other);
+
+	// The array behind the current storage
+	const int64_t* ints() const { return intItems.data(); }
+	const double* doubles() const { return doubleItems.data(); }
+	const Value* boxed() const { return boxedItems.data(); }
+
+	// Python's xs[i]: a negative index counts from the end. Throws when the
+	// result is out of range.
+	size_t checkedIndex(int64_t index) const;
+
+	std::string repr() const; // [1, 2.5, 'a']
+
+private:
+	Storage mode = Storage::Ints;
+	std::vector<int64_t> intItems;
+	std::vector<double> doubleItems;
+	std::vector<Value> boxedItems;
+
+	void admit(const Value& value);
+	void box();
+};
+
+// A new list holding `count` values
+Value makeList(const Value* items, size_t count);
+
+// Python semantics of the list operators: + concatenates, * repeats and ==
+// compares elementwise (a list equals no other type)
+Value concatLists(const ListObject& a, const ListObject& b);
+Value repeatList(const ListObject& list, const Value& count);
+bool listsEqual(const ListObject& a, const ListObject& b);
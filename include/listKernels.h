@@ -0,0 +1,35 @@
+#pragma once
+
+#include "charScan.h"
+#include <cstddef>
+#include <cstdint>
+
+// Reductions over the unboxed storage of a list (see ListObject), what the
+// sum, max and min builtins and list equality run on. The SIMD versions
+// work on 2 or 4 lanes at once and give the same results as Scalar.
+struct ListKernels {
+	ScanIsa isa;
+	// False when a partial sum leaves the 64 bit range; the exact sum is then
+	// left to the caller
+	bool (*sumInts)(const int64_t* p, size_t n, int64_t* out);
+	// start + p[0] + p[1] + ..., left to right in every implementation, so
+	// it rounds as a loop adding the elements one by one does
+	double (*sumDoubles)(double start, const double* p, size_t n);
+	// n > 0
+	int64_t (*maxInts)(const int64_t* p, size_t n);
+	int64_t (*minInts)(const int64_t* p, size_t n);
+	// n > 0. False when there is a NaN, which orders differently depending on
+	// where it stands; otherwise the first element equal to the result, so
+	// max([0.0, -0.0]) is 0.0 and max([-0.0, 0.0]) is -0.0 as in Python
+	bool (*maxDoubles)(const double* p, size_t n, double* out);
+	bool (*minDoubles)(const double* p, size_t n, double* out);
+	// Elementwise ==, so 0.0 equals -0.0 and NaN equals nothing
+	bool (*equalDoubles)(const double* a, const double* b, size_t n);
+};
+
+// Widest implementation this CPU supports, detected on first use
+const ListKernels& defaultListKernels();
+
+// A specific implementation, e.g. to compare them. Falls back to Scalar
+// when the CPU (or the build target) does not support `isa`.
+const ListKernels& listKernelsFor(ScanIsa isa);
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "ast.h"
+#include "value.h"
+
+// Semantics of the binary and unary operators, shared by every execution
+// engine so the tree-walking Interpreter and the VM always agree.
+Value addValues(const Value& l, const Value& r);
+Value subValues(const Value& l, const Value& r);
+Value mulValues(const Value& l, const Value& r);
+Value divValues(const Value& l, const Value& r);
+Value floorDivValues(const Value& l, const Value& r);
+Value modValues(const Value& l, const Value& r);
+
+Value equalValues(const Value& l, const Value& r);
+Value notEqualValues(const Value& l, const Value& r);
+Value lessValues(const Value& l, const Value& r);
+Value lessEqualValues(const Value& l, const Value& r);
+Value greaterValues(const Value& l, const Value& r);
+Value greaterEqualValues(const Value& l, const Value& r);
+// l in r, for a dict, a list or a string r
+Value inValues(const Value& l, const Value& r);
+Value notInValues(const Value& l, const Value& r);
+
+// == as lists and dicts compare their elements: values of different types
+// are just not equal, where == throws for most of them
+bool valuesEqual(const Value& a, const Value& b);
+
+Value negateValue(const Value& v);
+
+// Product of two integers, promoted to BigInt when it overflows 64 bits
+Value multiplyIntegers(int64_t a, int64_t b);
+
+// Python's // and % on integers: the quotient rounds toward minus infinity
+// and the remainder takes the sign of the divisor. `b` is not zero, and not
+// -1 when `a` is INT64_MIN.
+inline int64_t floorDivInt(int64_t a, int64_t b) {
+	if (static_cast<uint64_t>(a | b) <= UINT32_MAX) // both non-negative, 32 bit division is much faster
+		return static_cast<uint32_t>(a) / static_cast<uint32_t>(b);
+	int64_t q = a / b;
+	return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+inline int64_t floorModInt(int64_t a, int64_t b) {
+	if (static_cast<uint64_t>(a | b) <= UINT32_MAX)
+		return static_cast<uint32_t>(a) % static_cast<uint32_t>(b);
+	int64_t m = a % b;
+	return (m != 0 && (m < 0) != (b < 0)) ? m + b : m;
+}
+
+// The same on doubles; both throw on a zero divisor
+double floorDivDouble(double a, double b);
+double floorModDouble(double a, double b);
+
+// A counted for-range loop, run on a native counter: range(start, stop,
+// step) with its bounds checked once, before the first iteration
+struct IntRange {
+	int64_t next;
+	int64_t stop;
+	int64_t step;
+
+	bool hasNext() const { return step > 0 ? next < stop : next > stop; }
+	// A value past the 64 bit range is past `stop` too, the loop ends there
+	void advance() {
+		int64_t n = static_cast<int64_t>(static_cast<uint64_t>(next) + static_cast<uint64_t>(step));
+		next = (n < next) == (step < 0) ? n : stop;
+	}
+};
+
+// Times a sequence repeats in `s * count`: an int or a bool, zero when
+// negative, INT64_MAX for a positive int past 64 bits (too large unless the
+// sequence is empty). Throws for anything else, floats included.
+int64_t repeatCount(const Value& count);
+
+// Throws unless all three are integers (or bools) that fit 64 bits and
+// `step` is not zero
+IntRange makeRange(const Value& start, const Value& stop, const Value& step);
+
+// container[index] of a list or a string (a one character string), a
+// negative index counting from the end, or the value of a dict's key
+Value indexValue(const Value& container, const Value& index);
+// container[index] = value, for lists and dicts
+void storeIndex(const Value& container, const Value& index, const Value& value);
+
+// Item `position` of a for loop over a list, a string or a dict's keys,
+// false once the loop is past the end. The length is read every time, so
+// elements appended while the loop runs are visited too. Throws for
+// anything else.
+bool iterationItem(const Value& iterable, size_t position, Value& item);
+
+// Table dispatch on the decoded operator, with fast paths for inline ints and doubles.
+// `and`/`or` need both operands here; the engines evaluate them lazily.
+Value applyBinary(BinaryOp op, const Value& l, const Value& r);
+
+// Whether `left` alone decides `left and ...` / `left or ...`
+inline bool shortCircuits(BinaryOp op, const Value& left) {
+	return left.isTruthy() == (op == BinaryOp::Or);
+}
+Value applyUnary(UnaryOp op, const Value& v);
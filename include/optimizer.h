@@ -0,0 +1,76 @@
+#pragma once
+
+#include "ast.h"
+#include "value.h"
+#include <cstddef>
+
+struct OptimizerStats {
+	size_t nodesBefore = 0;
+	size_t nodesAfter = 0;
+	size_t constantsFolded = 0;
+	size_t branchesRemoved = 0;
+	size_t blocksUnwrapped = 0;
+	size_t identitiesSimplified = 0;
+
+	size_t nodesRemoved() const { return nodesBefore - nodesAfter; }
+
+	OptimizerStats& operator+=(const OptimizerStats& other) {
+		nodesBefore += other.nodesBefore;
+		nodesAfter += other.nodesAfter;
+		constantsFolded += other.constantsFolded;
+		branchesRemoved += other.branchesRemoved;
+		blocksUnwrapped += other.blocksUnwrapped;
+		identitiesSimplified += other.identitiesSimplified;
+		return *this;
+	}
+};
+
+// Rewrites the tree from Parser::parse() before it is executed:
+//   - folds operators whose operands are all literals (1 + 2 * 3 -> 7)
+//   - drops if/while branches whose condition is a literal, and the side of
+//     and/or that a literal left operand makes dead
+//   - unwraps single statement blocks and splices nested blocks
+//   - simplifies x * 1, x + 0 and x - 0 when x is known to be a number
+//     (x / 1 would turn an integer into a double)
+// Anything that would raise an error at runtime is left for the runtime.
+class Optimizer : public Visitor {
+public:
+	void optimize(Program& program);
+	const OptimizerStats& stats() const { return counters; }
+
+	void visit(NumberNode& node) override;
+	void visit(BinaryOpNode& node) override;
+	void visit(ComparisonChainNode& node) override;
+	void visit(UnaryOpNode& node) override;
+	void visit(VarNode& node) override;
+	void visit(AssignmentNode& node) override;
+	void visit(BooleanNode& node) override;
+	void visit(StringNode& node) override;
+	void visit(ListNode& node) override;
+	void visit(DictNode& node) override;
+	void visit(IndexNode& node) override;
+	void visit(IndexAssignmentNode& node) override;
+	void visit(BlockNode& node) override;
+	void visit(IfNode& node) override;
+	void visit(WhileNode& node) override;
+	void visit(ForRangeNode& node) override;
+	void visit(ForEachNode& node) override;
+	void visit(BreakNode& node) override;
+	void visit(ContinueNode& node) override;
+	void visit(FunctionCallNode& node) override;
+	void visit(FunctionDefNode& node) override;
+	void visit(ReturnNode& node) override;
+
+private:
+	OptimizerStats counters;
+	Arena* arena = nullptr;			// the program's, for replacement nodes
+	ASTNodePtr replacement = nullptr; // set by a visit to replace the node just visited
+
+	ASTNodePtr literalNode(const Value& value);
+
+	void rewrite(ASTNodePtr& node);
+	void rewriteBody(ASTNodePtr& body);
+};
+
+// Number of nodes in a tree
+size_t countNodes(ASTNode& root);
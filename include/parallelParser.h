@@ -0,0 +1,20 @@
+#pragma once
+
+#include "ast.h"
+#include <cstddef>
+#include <string_view>
+
+// Parses a whole script into the same tree as Parser(lexer).parse(), with
+// the function definitions outside any function parsed on `threads` threads
+// (0: one per core). A first pass parses everything else and only delimits
+// those bodies by indentation; the bodies are then parsed independently,
+// each into an arena of its own, and spliced back in source order, so the
+// result does not depend on scheduling.
+//
+// If anything fails to parse the script is parsed again serially, so the
+// error thrown is exactly the serial parser's.
+Program parseParallel(std::string_view source, unsigned threads = 0);
+
+// Below this size parseParallel just parses serially, threads cost more
+// than they save
+constexpr size_t kMinParallelParseBytes = 64 << 10;
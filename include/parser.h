@@ -2,41 +2,135 @@
 
 #include "lexer.h"
 #include "ast.h"
+#include "flatAst.h"
 
 
-class Parser {
+// Node factory the Parser uses to build the pointer tree in an Arena
+class TreeBuilder {
+public:
+	using Node = ASTNodePtr;
+	using Result = Program;
+	static constexpr Node none = nullptr;
+	static constexpr bool kLazyBodies = true;
+
+	TreeBuilder() : arena(std::make_shared<Arena>()) {}
+	// Build into an existing arena, so many small trees can share one
+	explicit TreeBuilder(std::shared_ptr<Arena> arena) : arena(std::move(arena)) {}
+
+	void reserveFor(size_t /*sourceBytes*/) {}
+
+	std::string_view intern(std::string_view s) { return arena->intern(s); }
+
+	Node number(const Token& token) {
+		switch (token.numberKind) {
+			case NumberKind::Int: return arena->make<NumberNode>(token.integer);
+			case NumberKind::BigInt: return arena->make<NumberNode>(arena->copyText(token.value));
+			default: return arena->make<NumberNode>(token.number);
+		}
+	}
+	Node binary(Node left, BinaryOp op, Node right) { return arena->make<BinaryOpNode>(left, op, right); }
+	Node comparisonChain(const Node* operands, const BinaryOp* ops, size_t opCount) {
+		return arena->make<ComparisonChainNode>(arena->copy(operands, opCount + 1), arena->copy(ops, opCount));
+	}
+	Node unary(UnaryOp op, Node operand) { return arena->make<UnaryOpNode>(op, operand); }
+	Node var(std::string_view name) { return arena->make<VarNode>(name); }
+	Node assignment(Node var, Node value) { return arena->make<AssignmentNode>(var, value); }
+	Node boolean(bool value) { return arena->make<BooleanNode>(value); }
+	Node string(std::string_view value) { return arena->make<StringNode>(value); }
+	Node list(const Node* elements, size_t count) { return arena->make<ListNode>(arena->copy(elements, count)); }
+	Node dict(const Node* items, size_t pairCount) { return arena->make<DictNode>(arena->copy(items, 2 * pairCount)); }
+	Node index(Node container, Node index) { return arena->make<IndexNode>(container, index); }
+	bool isIndex(Node node) const { return dynamic_cast<IndexNode*>(node) != nullptr; }
+	Node indexAssignment(Node target, Node value) { return arena->make<IndexAssignmentNode>(target, value); }
+	Node block(const Node* statements, size_t count) { return arena->make<BlockNode>(arena->copy(statements, count)); }
+	Node ifNode(Node condition, Node body, Node elseBody) { return arena->make<IfNode>(condition, body, elseBody); }
+	Node whileNode(Node condition, Node body) { return arena->make<WhileNode>(condition, body); }
+	Node forRange(Node var, Node start, Node stop, Node step, Node body) { return arena->make<ForRangeNode>(var, start, stop, step, body); }
+	Node forEach(Node var, Node iterable, Node body) { return arena->make<ForEachNode>(var, iterable, body); }
+	Node breakNode() { return arena->make<BreakNode>(); }
+	Node continueNode() { return arena->make<ContinueNode>(); }
+	Node call(std::string_view name, const Node* args, size_t count) { return arena->make<FunctionCallNode>(name, arena->copy(args, count)); }
+	Node functionDef(std::string_view name, const std::string_view* params, size_t count, Node body) {
+		return arena->make<FunctionDefNode>(name, arena->copy(params, count), body);
+	}
+	Node returnNode(Node value) { return arena->make<ReturnNode>(value); }
+	// Body left unparsed, `source` is copied since the definition may outlive the text
+	Node lazyFunctionDef(std::string_view name, const std::string_view* params, size_t count, std::string_view source) {
+		return arena->make<FunctionDefNode>(name, arena->copy(params, count), arena->copyText(source));
+	}
+
+	Result finish(Node root) { return Program{ arena, root }; }
+
+private:
+	std::shared_ptr<Arena> arena;
+};
+
+
+// Recursive descent parser for the grammar in Grammar/python.gram. The same
+// rules emit the pointer tree (Parser) or the flat form (FlatParser).
+//
+// With lazyFunctions, function bodies are only skipped over by indentation
+// and kept as source text (FunctionDefNode::source); the engines parse them
+// with parseFunction() on the first call, so syntax errors in a body surface
+// only then. The flat form is always parsed eagerly.
+template <typename Builder>
+class BasicParser {
 
 public:
-	explicit Parser(Lexer& lexer);
-	ASTNodePtr parse();
+	using Node = typename Builder::Node;
+
+	explicit BasicParser(Lexer& lexer, bool lazyFunctions = false, Builder builder = Builder());
+	typename Builder::Result parse();
+	// Parse the source of a lazily parsed function: its body now, the
+	// functions nested in it lazily again
+	typename Builder::Result parseFunction();
 
 private:
 	Lexer& lexer;
+	bool lazyFunctions;
 	Token currentToken;
+	Builder build;
+	std::vector<Node> pending;	// statements/arguments of the lists being parsed
+	uint32_t loopDepth = 0;		// loops around the statement being parsed, in the current function
+
+	Node blockFrom(size_t start);
+
 	void eat(TokenType type);
 	// Grammar rules
-	ASTNodePtr  expr();					// expr : comparison ( (OR | AND) comparison )*
-	ASTNodePtr  disjunction();			// disjunction : conjunction ( OR conjunction )*
-	ASTNodePtr  conjunction();			// conjunction : inversion ( AND inversion )*
-	ASTNodePtr  inversion();			// inversion : NOT inversion | comparison
-	ASTNodePtr  comparison();			// comparison : arith_expr ( (EQEQUAL | NOTEQUAL | LESSEQUAL | GREATEREQUAL | LESS | GREATER) arith_expr )*
-	ASTNodePtr arith_expr();			// term ((PLUS | MINUS) term)*
-	ASTNodePtr  term();					// term : factor ((MUL | DIV) factor)*
-	ASTNodePtr  factor();				// factor : INTEGER | LPAREN expr RPAREN | (PLUS | MINUS) factor | BOOLEAN | STRING | NAME | function_call
-
-	ASTNodePtr  program();				// program : statements EOF_TOKEN
-	std::vector<ASTNodePtr> statements();// ( compound_statement | simple_statement NEWLINE )*
-	ASTNodePtr simple_stmt();		// simple_statement : assignment_stmt | expr
-	ASTNodePtr compound_stmt();	// compound_statement : if_statement
-	ASTNodePtr if_stmt();		// if_statement : IF expr COLON NEWLINE block ( elif_stmt | else )?
-	ASTNodePtr elif_stmt();		// elif_statement : ELIF expr COLON NEWLINE block ( elif_stmt | else )?
-	ASTNodePtr else_stmt();		// else_statement : ELSE COLON NEWLINE block
-	ASTNodePtr while_stmt();	// while_statement : WHILE expr COLON NEWLINE block
-	std::vector<ASTNodePtr> block();					// block : INDENT statements DEDENT
-	ASTNodePtr assignment_stmt();		// assignment_stmt : IDENTIFIER ASSIGN expr
-	ASTNodePtr function_call(std::string func_name);		// function_call : NAME LPAR (expr (COMMA expr)*)? RPAR
-	ASTNodePtr function_def(); // function_def : DEF NAME LPAR (NAME (COMMA NAME)*)? RPAR COLON NEWLINE block
-	ASTNodePtr return_stmt(); // return_stmt : RETURN expr
+	Node expr();				// expr : comparison ( (OR | AND) comparison )*
+	Node disjunction();			// disjunction : conjunction ( OR conjunction )*
+	Node conjunction();			// conjunction : inversion ( AND inversion )*
+	Node inversion();			// inversion : NOT inversion | comparison
+	Node comparison();			// comparison : arith_expr ( (EQEQUAL | NOTEQUAL | LESSEQUAL | GREATEREQUAL | LESS | GREATER | IN | NOT IN) arith_expr )*, chained
+	BinaryOp comparisonOperator();
+	Node arith_expr();			// term ((PLUS | MINUS) term)*
+	Node term();				// term : factor ((MUL | DIV) factor)*
+	Node factor();				// factor : (PLUS | MINUS) factor | primary
+	Node primary();				// primary : atom ( LSQB expr RSQB | DOT NAME LPAR (expr (COMMA expr)*)? RPAR )*
+	Node atom();				// atom : NUMBER | LPAR expr RPAR | BOOLEAN | STRING | NAME | function_call | list_display | dict_display
+	Node list_display();		// list_display : LSQB (expr (COMMA expr)* COMMA?)? RSQB
+	Node dict_display();		// dict_display : LBRACE (expr COLON expr (COMMA expr COLON expr)* COMMA?)? RBRACE
+
+	Node program();				// program : statements EOF_TOKEN
+	Node statements();			// ( compound_statement | simple_statement NEWLINE )*
+	Node simple_stmt();			// simple_statement : assignment_stmt | expr
+	Node compound_stmt();		// compound_statement : if_statement
+	Node if_stmt();				// if_statement : IF expr COLON NEWLINE block ( elif_stmt | else )?
+	Node elif_stmt();			// elif_statement : ELIF expr COLON NEWLINE block ( elif_stmt | else )?
+	Node else_stmt();			// else_statement : ELSE COLON NEWLINE block
+	Node while_stmt();			// while_statement : WHILE expr COLON NEWLINE block
+	Node for_stmt();			// for_statement : FOR NAME IN (NAME LPAR expr (COMMA expr (COMMA expr)?)? RPAR | expr) COLON NEWLINE block
+	Node loop_body();			// block, with break and continue allowed
+	Node loop_control();		// break_stmt : BREAK | continue_stmt : CONTINUE
+	Node block();				// block : INDENT statements DEDENT
+	Node assignment_stmt();		// assignment_stmt : IDENTIFIER ASSIGN expr
+	Node function_call(std::string_view func_name, Node receiver = Builder::none);	// function_call : NAME LPAR (expr (COMMA expr)*)? RPAR
+	Node function_def(bool allowLazy = true);	// function_def : DEF NAME LPAR (NAME (COMMA NAME)*)? RPAR COLON NEWLINE block
+	Node return_stmt();			// return_stmt : RETURN expr
 };
 
+using Parser = BasicParser<TreeBuilder>;
+using FlatParser = BasicParser<FlatBuilder>;
 
+extern template class BasicParser<TreeBuilder>;
+extern template class BasicParser<FlatBuilder>;
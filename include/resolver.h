@@ -0,0 +1,69 @@
+#pragma once
+
+#include "ast.h"
+#include "flatAst.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Module level variable names, numbered in order of first appearance.
+// Lives as long as the engine so REPL lines keep resolving to the same slots.
+struct GlobalScope {
+	std::vector<std::string> names;
+	std::unordered_map<std::string, uint32_t> slots;
+
+	uint32_t slotFor(std::string_view name);
+};
+
+// Gives every VarNode a fixed slot before execution.
+// Inside a function, parameters and every name assigned in the body are
+// locals (numbered in the FunctionDefNode's frame); all other names are globals.
+class Resolver : public Visitor {
+public:
+	// Frame layouts are stored in `arena`, the one owning the tree
+	Resolver(GlobalScope& globals, Arena& arena) : globals(globals), arena(arena) {}
+
+	void resolve(ASTNode& program);
+
+	void visit(NumberNode& node) override;
+	void visit(BinaryOpNode& node) override;
+	void visit(ComparisonChainNode& node) override;
+	void visit(UnaryOpNode& node) override;
+	void visit(VarNode& node) override;
+	void visit(AssignmentNode& node) override;
+	void visit(BooleanNode& node) override;
+	void visit(StringNode& node) override;
+	void visit(ListNode& node) override;
+	void visit(DictNode& node) override;
+	void visit(IndexNode& node) override;
+	void visit(IndexAssignmentNode& node) override;
+	void visit(BlockNode& node) override;
+	void visit(IfNode& node) override;
+	void visit(WhileNode& node) override;
+	void visit(ForRangeNode& node) override;
+	void visit(ForEachNode& node) override;
+	void visit(BreakNode& node) override;
+	void visit(ContinueNode& node) override;
+	void visit(FunctionCallNode& node) override;
+	void visit(FunctionDefNode& node) override;
+	void visit(ReturnNode& node) override;
+
+private:
+	GlobalScope& globals;
+	Arena& arena;
+	FunctionDefNode* function = nullptr; // null at module level
+	std::unordered_map<std::string_view, uint32_t> locals;
+	std::vector<std::string_view> localNames; // of `function`, parameters first
+
+	void declareLocal(std::string_view name);
+};
+
+// Appends every name assigned anywhere in a function body, in order and with
+// repeats; nested function definitions are left out, they get their own scope
+void collectAssignedNames(ASTNode& body, std::vector<std::string_view>& names);
+
+// The same rules for a FlatAst: Var nodes get their VarScope in ops and their
+// slot in b, FunctionDef nodes their frame layout in their FlatFunction.
+void resolveFlat(FlatAst& ast, GlobalScope& globals);
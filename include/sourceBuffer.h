@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Text of a script, loaded in one pass. Regular files are memory mapped;
+// pipes, stdin and files that cannot be mapped are read fully into memory.
+// The Lexer borrows text(), so the buffer must outlive it and its tokens.
+class SourceBuffer {
+public:
+	// Throws std::runtime_error if the file cannot be opened or read
+	static SourceBuffer fromFile(const std::string& path);
+	static SourceBuffer fromStdin();
+
+	explicit SourceBuffer(std::string text) : owned(std::move(text)) {}
+	SourceBuffer(SourceBuffer&& other) noexcept;
+	SourceBuffer& operator=(SourceBuffer&& other) noexcept;
+	SourceBuffer(const SourceBuffer&) = delete;
+	SourceBuffer& operator=(const SourceBuffer&) = delete;
+	~SourceBuffer();
+
+	std::string_view text() const { return mapped.data() ? mapped : std::string_view(owned); }
+	bool isMapped() const { return mapped.data() != nullptr; }
+
+private:
+	SourceBuffer() = default;
+
+	std::string_view mapped;	// the mapping, if the file was mapped
+	std::string owned;			// the text otherwise
+#ifdef _WIN32
+	void* mappingHandle = nullptr;
+#endif
+
+	void unmap();
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <string_view>
+
+// The rule that splits a script into top-level statements, fed one line at
+// a time. A statement ends where the next line starting in column 0 begins,
+// unless that line continues it (elif/else) or lies inside a string literal.
+// Blank lines go with the statement before them; leading ones with the first.
+class StatementSplitter {
+public:
+	// Whether `line` (with its '\n', if any) begins the next statement, so
+	// the one assembled so far is complete
+	bool endsStatement(std::string_view line) const;
+	// Append `line` to the statement being assembled
+	void add(std::string_view line);
+	// Start assembling the next statement
+	void finishStatement() { haveStatement = false; }
+
+	bool hasStatement() const { return haveStatement; } // a non-blank line was added
+	bool inString() const { return insideString; }		// the lines added end inside a string literal
+
+private:
+	bool haveStatement = false;
+	bool insideString = false;
+};
+
+// Reads a script in chunks and hands it out one top-level statement at a
+// time, so each statement can be parsed and run before the rest of the input
+// has arrived. Only the statement being assembled and one chunk are held in
+// memory. Statements are delimited by StatementSplitter.
+class StatementReader {
+public:
+	explicit StatementReader(std::istream& in, size_t chunkSize = 1 << 16);
+
+	// Next complete statement, with its trailing newline. The view is valid
+	// until the next call. False at the end of the input.
+	bool next(std::string_view& statement);
+
+	// Bytes currently buffered, for checking the memory bound
+	size_t bufferSize() const { return buffer.capacity(); }
+
+private:
+	std::istream& in;
+	size_t chunkSize;
+	std::string buffer;
+	size_t consumed = 0;		// start of the statement being assembled
+	size_t scanPos = 0;			// first line not classified yet
+	StatementSplitter splitter;	// state at scanPos
+	bool eof = false;
+
+	void fill();
+};
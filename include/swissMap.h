@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPPYTHON_SWISS_SSE2 1
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// An insertion ordered hash map in the style of Abseil's Swiss tables.
+// Entries live in one array in the order they were inserted, which is also
+// the iteration order. The index over them is open addressing: a control
+// byte per slot (empty, or 7 bits of the hash) next to an array of entry
+// numbers. Slots are probed 16 at a time: one SSE2 comparison of a group of
+// control bytes finds every slot whose hash bits match, so a lookup usually
+// touches one group and compares the key once.
+//
+// There is no erase, neither the dict nor the string intern table needs one. `Hash`
+// returns a 64 bit hash that need not be well mixed (an int may hash to
+// itself); each entry keeps it, so growing never hashes a key again.
+template <typename Key, typename T, typename Hash, typename KeyEqual>
+class SwissMap {
+public:
+	struct Entry {
+		uint64_t hash;
+		Key key;
+		T value;
+	};
+
+	size_t size() const { return entries.size(); }
+	bool empty() const { return entries.empty(); }
+
+	// Entries in insertion order
+	const Entry& entry(size_t index) const { return entries[index]; }
+	Entry& entry(size_t index) { return entries[index]; }
+
+	// Room for `count` entries without growing
+	void reserve(size_t count) {
+		entries.reserve(count);
+		if (count > capacity() - capacity() / 8)
+			rehash(capacityFor(count));
+	}
+
+	// Null when `key` is absent
+	T* find(const Key& key) {
+		size_t index = lookup(key, mix(hasher(key)));
+		return index == kNotFound ? nullptr : &entries[index].value;
+	}
+	const T* find(const Key& key) const {
+		size_t index = lookup(key, mix(hasher(key)));
+		return index == kNotFound ? nullptr : &entries[index].value;
+	}
+
+	// Adds `key` unless an equal key is there; either way returns its value
+	// and whether it was added. An existing key keeps its value and identity.
+	std::pair<T*, bool> insert(Key key, T value) {
+		uint64_t hash = mix(hasher(key));
+		size_t index = lookup(key, hash);
+		if (index != kNotFound)
+			return { &entries[index].value, false };
+		if (entries.size() >= UINT32_MAX)
+			throw std::length_error("SwissMap is too large");
+		if (entries.size() + 1 > capacity() - capacity() / 8)
+			rehash(capacityFor(entries.size() + 1));
+		place(hash, static_cast<uint32_t>(entries.size()));
+		entries.push_back({ hash, std::move(key), std::move(value) });
+		return { &entries.back().value, true };
+	}
+
+	// Sets the value of `key`, adding it when absent
+	void insertOrAssign(Key key, T value) {
+		auto [slot, added] = insert(std::move(key), T());
+		*slot = std::move(value);
+	}
+
+	// Bytes held, for comparing with other containers
+	size_t memoryUsed() const {
+		return entries.capacity() * sizeof(Entry) + control.capacity() + slots.capacity() * sizeof(uint32_t);
+	}
+
+private:
+	static constexpr size_t kGroupSize = 16;
+	static constexpr int8_t kEmpty = -128; // a full slot holds 0..127
+	static constexpr size_t kNotFound = SIZE_MAX;
+
+	std::vector<Entry> entries;
+	std::vector<int8_t> control;	// capacity() bytes, a multiple of kGroupSize
+	std::vector<uint32_t> slots;	// entry number of each full slot
+	Hash hasher;
+	KeyEqual equal;
+
+	size_t capacity() const { return control.size(); }
+
+	// Smallest power of two group count keeping `count` entries under 7/8 load
+	static size_t capacityFor(size_t count) {
+		size_t capacity = kGroupSize;
+		while (count > capacity - capacity / 8)
+			capacity *= 2;
+		return capacity;
+	}
+
+	// The low 7 bits pick the control byte, the rest the first group, so
+	// both need to depend on every bit of the hash
+	static uint64_t mix(uint64_t h) {
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		return h;
+	}
+	static int8_t controlByte(uint64_t hash) { return static_cast<int8_t>(hash & 0x7F); }
+
+	// Bit i set where byte i of the group equals `byte`
+	static uint32_t matchByte(const int8_t* group, int8_t byte) {
+#ifdef CPPYTHON_SWISS_SSE2
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+		return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(byte))));
+#else
+		uint32_t mask = 0;
+		for (size_t i = 0; i < kGroupSize; i++)
+			mask |= static_cast<uint32_t>(group[i] == byte) << i;
+		return mask;
+#endif
+	}
+
+	static unsigned lowestBit(uint32_t mask) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return index;
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	// Groups are visited at triangular offsets, which reaches every group of
+	// a power of two table; the load limit guarantees an empty slot somewhere
+	size_t lookup(const Key& key, uint64_t hash) const {
+		if (entries.empty())
+			return kNotFound;
+		size_t groupMask = capacity() / kGroupSize - 1;
+		size_t group = (hash >> 7) & groupMask;
+		int8_t byte = controlByte(hash);
+		for (size_t step = 1;; step++) {
+			const int8_t* bytes = control.data() + group * kGroupSize;
+			for (uint32_t match = matchByte(bytes, byte); match; match &= match - 1) {
+				const Entry& candidate = entries[slots[group * kGroupSize + lowestBit(match)]];
+				if (candidate.hash == hash && equal(candidate.key, key))
+					return &candidate - entries.data();
+			}
+			if (matchByte(bytes, kEmpty))
+				return kNotFound;
+			group = (group + step) & groupMask;
+		}
+	}
+
+	// Index entry `index` in the first empty slot of its probe sequence
+	void place(uint64_t hash, uint32_t index) {
+		size_t groupMask = capacity() / kGroupSize - 1;
+		size_t group = (hash >> 7) & groupMask;
+		for (size_t step = 1;; step++) {
+			uint32_t free = matchByte(control.data() + group * kGroupSize, kEmpty);
+			if (free) {
+				size_t slot = group * kGroupSize + lowestBit(free);
+				control[slot] = controlByte(hash);
+				slots[slot] = index;
+				return;
+			}
+			group = (group + step) & groupMask;
+		}
+	}
+
+	void rehash(size_t newCapacity) {
+		control.assign(newCapacity, kEmpty);
+		slots.assign(newCapacity, 0);
+		for (size_t i = 0; i < entries.size(); i++)
+			place(entries[i].hash, static_cast<uint32_t>(i));
+	}
+};
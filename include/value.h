@@ -1,41 +1,239 @@
 #pragma once
 
-#include <variant>
+#include "bigInt.h"
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <stdexcept>
 
-// TODO: add None type 
-class Value {
-public:
-    using ValueType = std::variant<double, bool, std::string>;
+// Heap allocated part of a Value. Reference counted by the Values that
+// point at it; doubles, inline integers and booleans never need one.
+struct Object {
+    enum class Kind : uint8_t {
+        String,
+        BigInt,
+        List,
+        Dict,
+    };
+
+    uint32_t refCount = 1;
+    Kind kind;
+
+    explicit Object(Kind k) : kind(k) {}
+    virtual ~Object() = default;
+};
+
+struct StringObject : Object {
+    std::string value;
+    bool interned = false; // the one copy in the intern table, see Value::internedString
+
+    explicit StringObject(std::string s) : Object(Kind::String), value(std::move(s)) {}
+
+    // Strings never change, so the hash is computed once, on first use
+    uint64_t hash() const {
+        if (!hashed) {
+            hashCode = hashString(value);
+            hashed = true;
+        }
+        return hashCode;
+    }
+    static uint64_t hashString(std::string_view s);
 
 private:
-    ValueType data;
+    mutable uint64_t hashCode = 0;
+    mutable bool hashed = false;
+};
+
+// Integers outside the inline 48 bit range
+struct BigIntObject : Object {
+    BigInt value;
+
+    explicit BigIntObject(BigInt v) : Object(Kind::BigInt), value(std::move(v)) {}
+};
 
+struct ListObject; // list.h
+struct DictObject; // dict.h
+
+// TODO: add None type
+// An 8 byte NaN-boxed value. Doubles are stored as their own bits; every
+// other type hides in the payload of a quiet NaN that no arithmetic produces:
+//
+//   0 | 0x7FFC | 00 ...tag       booleans and the undefined marker
+//   0 | 0x7FFC | 01 48 bit int   integers in [-2^47, 2^47)
+//   1 | 0x7FFC | 48 bit pointer  heap Objects (strings, larger integers, lists, dicts)
+//
+// Integers are exact: every integer has exactly one representation, inline
+// when it fits and a BigIntObject otherwise, so equal integers have equal
+// kinds. Arithmetic on them promotes to BigInt instead of overflowing.
+class Value {
 public:
     // Constructors
-    Value();
-    Value(double d);
-    Value(bool b);
+    Value() : bits(0) {} // 0.0
+    Value(double d) {
+        if (d != d) d = canonicalNaN(); // keep NaN payloads out of the tag space
+        std::memcpy(&bits, &d, sizeof d);
+    }
+    Value(bool b) : bits(b ? kTrue : kFalse) {}
     Value(const std::string& s);
+    Value(std::string&& s);
     Value(const char* s);
+    Value(std::string_view s);
+    explicit Value(ListObject* list); // takes over the reference `list` was created with
+    explicit Value(DictObject* dict); // likewise
+
+    // The one shared copy of `s`. String literals are interned, so dict
+    // lookups with them find the key by comparing pointers. Interned strings
+    // live as long as the program.
+    static Value internedString(std::string_view s);
+
+    // Integers, inline when they fit
+    static Value integer(int64_t i) {
+        if (i >= kSmallIntMin && i <= kSmallIntMax)
+            return fromBits(kSmallIntTag | (static_cast<uint64_t>(i) & kPayloadMask));
+        return boxedInteger(i);
+    }
+    static Value integer(BigInt i);
+    // Decimal digits with an optional leading '-'
+    static Value integerFromDecimal(std::string_view digits);
+
+    Value(const Value& other) : bits(other.bits) { retain(); }
+    Value(Value&& other) noexcept : bits(other.bits) { other.bits = 0; }
+    Value& operator=(const Value& other) {
+        other.retain();
+        release();
+        bits = other.bits;
+        return *this;
+    }
+    Value& operator=(Value&& other) noexcept {
+        if (this != &other) {
+            release();
+            bits = other.bits;
+            other.bits = 0;
+        }
+        return *this;
+    }
+    ~Value() { release(); }
+
+    // Marker for slots that were never assigned (not visible to scripts)
+    static Value undefined() { return fromBits(kUndefined); }
 
     // Type checking
-    bool isNumber() const;
-    bool isBool() const;
-    bool isString() const;
+    bool isDouble() const { return (bits & kQNaN) != kQNaN; }
+    bool isSmallInt() const { return (bits & kSmallIntMask) == kSmallIntTag; }
+    bool isBigInt() const { return isObject() && asObject()->kind == Object::Kind::BigInt; }
+    bool isInteger() const { return isSmallInt() || isBigInt(); }
+    bool isNumber() const { return isDouble() || isInteger(); }
+    bool isBool() const { return (bits | 1) == kTrue; }
+    bool isString() const { return isObject() && asObject()->kind == Object::Kind::String; }
+    bool isList() const { return isObject() && asObject()->kind == Object::Kind::List; }
+    bool isDict() const { return isObject() && asObject()->kind == Object::Kind::Dict; }
+    bool isUndefined() const { return bits == kUndefined; }
+
+    // A double or an inline integer, which converts to a double exactly, so
+    // mixed arithmetic and comparisons can run on doubles
+    bool isInlineNumber() const { return isDouble() || isSmallInt(); }
+    double inlineNumberAsDouble() const { return isSmallInt() ? static_cast<double>(asSmallInt()) : asDouble(); }
 
-    // Type accessors with error checking
-    double asNumber() const;
-    bool asBool() const;
-    std::string asString() const;
+    // Both inline integers, the common case of integer arithmetic
+    static bool bothSmallInts(const Value& a, const Value& b) {
+        return ((a.bits & kSmallIntMask) == kSmallIntTag) & ((b.bits & kSmallIntMask) == kSmallIntTag);
+    }
+    // Range of inline integers; sums and differences of two stay far inside 64 bits
+    static constexpr int64_t kSmallIntMin = -(int64_t(1) << 47);
+    static constexpr int64_t kSmallIntMax = (int64_t(1) << 47) - 1;
+
+    // Type accessors, unchecked where the name says what the caller tested
+    double asDouble() const {
+        double d;
+        std::memcpy(&d, &bits, sizeof d);
+        return d;
+    }
+    int64_t asSmallInt() const { return static_cast<int64_t>(bits << 16) >> 16; }
+    const BigInt& asBigInt() const;
+    // Any number or bool as a double, with error checking
+    double asNumber() const {
+        if (isDouble()) return asDouble();
+        if (isSmallInt()) return static_cast<double>(asSmallInt());
+        if (isBool()) return bits == kTrue ? 1.0 : 0.0;
+        return asNumberSlow();
+    }
+    // An integer or bool that fits 64 bits
+    bool toInt64(int64_t& out) const {
+        if (isSmallInt()) out = asSmallInt();
+        else if (isBool()) out = bits == kTrue;
+        else if (isBigInt()) return asBigInt().fitsInt64(out);
+        else return false;
+        return true;
+    }
+    BigInt toBigInt() const; // an integer or bool
+    bool asBool() const {
+        if (isBool()) return bits == kTrue;
+        throw std::runtime_error("Value is not a boolean");
+    }
+    const std::string& asString() const;
+    const StringObject& asStringObject() const { return *static_cast<const StringObject*>(asObject()); } // isString()
+    // Lists are shared, mutating one is seen through every Value holding it
+    ListObject& asList() const;
+    DictObject& asDict() const;
 
     // Convert to string for printing
     std::string toString() const;
+    // The same, but a string in quotes, as it appears inside a list or dict
+    std::string repr() const;
 
     // Type name for error messages
     std::string typeName() const;
 
     // Truthiness (for conditions)
-    bool isTruthy() const;
+    bool isTruthy() const {
+        if (bits == kTrue) return true;
+        if (bits == kFalse || bits == kUndefined) return false;
+        if (isDouble()) return asDouble() != 0.0;
+        if (isSmallInt()) return asSmallInt() != 0;
+        return isTruthySlow();
+    }
+
+private:
+    uint64_t bits;
+
+    static constexpr uint64_t kSignBit = 0x8000000000000000ull;
+    static constexpr uint64_t kQNaN = 0x7FFC000000000000ull;
+    static constexpr uint64_t kPayloadMask = 0x0000FFFFFFFFFFFFull;
+    static constexpr uint64_t kObjectTag = kSignBit | kQNaN;
+
+    static constexpr uint64_t kUndefined = kQNaN | 1;
+    static constexpr uint64_t kFalse = kQNaN | 2;
+    static constexpr uint64_t kTrue = kQNaN | 3;
+    static constexpr uint64_t kSmallIntTag = kQNaN | (1ull << 48);
+    static constexpr uint64_t kSmallIntMask = kSignBit | kQNaN | (3ull << 48);
+
+    static double canonicalNaN() {
+        const uint64_t nan = 0x7FF8000000000000ull;
+        double d;
+        std::memcpy(&d, &nan, sizeof d);
+        return d;
+    }
+    static Value fromBits(uint64_t b) {
+        Value v;
+        v.bits = b;
+        return v;
+    }
+    explicit Value(Object* object) : bits(kObjectTag | reinterpret_cast<uintptr_t>(object)) {}
+
+    bool isObject() const { return (bits & kObjectTag) == kObjectTag; }
+    Object* asObject() const { return reinterpret_cast<Object*>(static_cast<uintptr_t>(bits & kPayloadMask)); }
+
+    void retain() const {
+        if (isObject()) asObject()->refCount++;
+    }
+    void release() {
+        if (isObject() && --asObject()->refCount == 0) delete asObject();
+    }
+
+    static Value boxedInteger(int64_t i); // out of line, keeps integer() small enough to inline
+    bool isTruthySlow() const;
+    double asNumberSlow() const;
 };
+
+static_assert(sizeof(Value) == 8, "Value must stay NaN-boxed");
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "ast.h"
+#include "bytecode.h"
+#include "frameArena.h"
+#include "value.h"
+#include <string>
+#include <vector>
+
+// Stack based virtual machine running the bytecode produced by the Compiler.
+class VM {
+public:
+	Module module;
+
+	VM();
+
+	// Compile and run a program, returns the value of a trailing expression
+	Value run(Program& program);
+	Value execute(const FunctionProto& script);
+
+	// Names of the functions that were active when an error was thrown
+	std::vector<std::string> backtrace() const;
+
+private:
+	struct CallFrame {
+		const FunctionProto* proto;
+		const Instruction* ip;
+		Value* base; // first local slot
+	};
+
+	static constexpr size_t kStackSize = 1 << 16;
+
+	std::vector<Value> stack;
+	std::vector<CallFrame> frames;
+	std::vector<Value> globals;					// indexed by GlobalScope slot
+	std::vector<FunctionProto*> functions;	// indexed by Module::functionSlots
+	std::vector<Value> argBuffer;
+	const std::string* activeBuiltin = nullptr;
+
+	void registerBuiltins();
+	void compileLazy(FunctionProto& proto);
+	[[noreturn]] void undefinedVariable(const std::string& name) const;
+};
@@ -33,14 +33,24 @@ std::string tokenTypeToString(TokenType type) {
 		case TokenType::AND: return "AND";
 		case TokenType::NOT: return "NOT";
 		case TokenType::PERCENT: return "PERCENT";
+		case TokenType::DOUBLESLASH: return "DOUBLESLASH";
 		case TokenType::DEF: return "DEF";
 		case TokenType::RETURN: return "RETURN";
+		case TokenType::FOR: return "FOR";
+		case TokenType::IN: return "IN";
+		case TokenType::BREAK: return "BREAK";
+		case TokenType::CONTINUE: return "CONTINUE";
+		case TokenType::LSQB: return "LSQB";
+		case TokenType::RSQB: return "RSQB";
+		case TokenType::DOT: return "DOT";
+		case TokenType::LBRACE: return "LBRACE";
+		case TokenType::RBRACE: return "RBRACE";
 		case TokenType::EOF_TOKEN: return "EOF";
 		default:                 return "UNKNOWN";
 	}
 }
 
 std::string Token::toString() const {
-	std::string str = "Token(" + tokenTypeToString(type) + ", \"" + value + "\")";
+	std::string str = "Token(" + tokenTypeToString(type) + ", \"" + std::string(value) + "\")";
 	return str;
 }
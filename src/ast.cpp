@@ -1,42 +1,99 @@
 #include "ast.h"
+#include "value.h"
+#include <charconv>
+
+const char* binaryOpSymbol(BinaryOp op) {
+    switch (op) {
+        case BinaryOp::Add: return "+";
+        case BinaryOp::Sub: return "-";
+        case BinaryOp::Mul: return "*";
+        case BinaryOp::Div: return "/";
+        case BinaryOp::FloorDiv: return "//";
+        case BinaryOp::Mod: return "%";
+        case BinaryOp::Equal: return "==";
+        case BinaryOp::NotEqual: return "!=";
+        case BinaryOp::Less: return "<";
+        case BinaryOp::LessEqual: return "<=";
+        case BinaryOp::Greater: return ">";
+        case BinaryOp::GreaterEqual: return ">=";
+        case BinaryOp::And: return "and";
+        case BinaryOp::Or: return "or";
+        case BinaryOp::In: return "in";
+        case BinaryOp::NotIn: return "not in";
+        default: return "?";
+    }
+}
+
+const char* unaryOpSymbol(UnaryOp op) {
+    switch (op) {
+        case UnaryOp::Plus: return "+";
+        case UnaryOp::Minus: return "-";
+        case UnaryOp::Not: return "not";
+        default: return "?";
+    }
+}
 
 // NumberNode class
-NumberNode::NumberNode(const std::string val) : value(val) {}
+NumberNode::NumberNode(double val) : kind(NumberKind::Float), value(val) {}
+NumberNode::NumberNode(int64_t val) : kind(NumberKind::Int), integer(val) {}
+NumberNode::NumberNode(std::string_view bigDigits) : kind(NumberKind::BigInt), digits(bigDigits) {}
+
+Value NumberNode::literal() const {
+    switch (kind) {
+        case NumberKind::Int: return Value::integer(integer);
+        case NumberKind::BigInt: return Value::integerFromDecimal(digits);
+        default: return Value(value);
+    }
+}
 
 std::string NumberNode::toString() const {
-    return value;
+    if (kind == NumberKind::Int)
+        return std::to_string(integer);
+    if (kind == NumberKind::BigInt)
+        return std::string(digits);
+    char buffer[32];
+    auto end = std::to_chars(buffer, buffer + sizeof buffer, value).ptr; // shortest round-trip form
+    return std::string(buffer, end);
 }
 
 std::string NumberNode::getNodeType() const { return "Number"; }
 
 
 // BinaryOpNode class
-BinaryOpNode::BinaryOpNode(ASTNodePtr l, const std::string& operation, ASTNodePtr r)
-    : left(std::move(l)), op(operation), right(std::move(r)) {}
+BinaryOpNode::BinaryOpNode(ASTNodePtr l, BinaryOp operation, ASTNodePtr r)
+    : left(l), op(operation), right(r) {}
 
 std::string BinaryOpNode::toString() const {
-    return "{" + left->toString() + " " + op + " " + right->toString() + "}";
+    return "{" + left->toString() + " " + binaryOpSymbol(op) + " " + right->toString() + "}";
 }
 
 std::string BinaryOpNode::getNodeType() const { return "BinaryOp"; }
 
 
+std::string ComparisonChainNode::toString() const {
+    std::string s = "{" + operands[0]->toString();
+    for (size_t i = 0; i < ops.size(); i++)
+        s += std::string(" ") + binaryOpSymbol(ops[i]) + " " + operands[i + 1]->toString();
+    return s + "}";
+}
+
+
 // UnaryOpNode class
-UnaryOpNode::UnaryOpNode(const std::string& operation, ASTNodePtr factorNode)
-	: op(operation), factor(std::move(factorNode)) {}
+UnaryOpNode::UnaryOpNode(UnaryOp operation, ASTNodePtr factorNode)
+	: op(operation), factor(factorNode) {}
 
 std::string UnaryOpNode::toString() const {
-	return "{" + op + factor->toString() + "}";
+	return "{" + std::string(unaryOpSymbol(op)) + factor->toString() + "}";
 }
 
 std::string UnaryOpNode::getNodeType() const { return "UnaryOp"; }
 
 
 // VarNode class
-VarNode::VarNode(const std::string n) : name(n) {}
+VarNode::VarNode(std::string_view n) : name(n) {}
 
 std::string VarNode::toString() const {
-	return name;
+	return std::string(name);
 }
 
 std::string VarNode::getNodeType() const { return "Var"; }
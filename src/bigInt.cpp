@@ -0,0 +1,368 @@
+#include "bigInt.h"
+#include <cmath>
+
+using Limbs = std::vector<uint32_t>;
+
+static constexpr uint32_t kDecimalChunk = 1000000000; // 10^9, the largest power of ten in a limb
+
+
+static void trimLimbs(Limbs& limbs) {
+	while (!limbs.empty() && limbs.back() == 0)
+		limbs.pop_back();
+}
+
+static int compareMagnitudes(const Limbs& a, const Limbs& b) {
+	if (a.size() != b.size())
+		return a.size() < b.size() ? -1 : 1;
+	for (size_t i = a.size(); i-- > 0;)
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+	return 0;
+}
+
+static Limbs addMagnitudes(const Limbs& a, const Limbs& b) {
+	const Limbs& longer = a.size() >= b.size() ? a : b;
+	const Limbs& shorter = a.size() >= b.size() ? b : a;
+	Limbs sum(longer.size() + 1);
+	uint64_t carry = 0;
+	for (size_t i = 0; i < longer.size(); i++) {
+		carry += static_cast<uint64_t>(longer[i]) + (i < shorter.size() ? shorter[i] : 0);
+		sum[i] = static_cast<uint32_t>(carry);
+		carry >>= 32;
+	}
+	sum[longer.size()] = static_cast<uint32_t>(carry);
+	trimLimbs(sum);
+	return sum;
+}
+
+// a - b, where a >= b
+static Limbs subtractMagnitudes(const Limbs& a, const Limbs& b) {
+	Limbs difference(a.size());
+	uint64_t borrow = 0;
+	for (size_t i = 0; i < a.size(); i++) {
+		uint64_t d = static_cast<uint64_t>(a[i]) - (i < b.size() ? b[i] : 0) - borrow;
+		difference[i] = static_cast<uint32_t>(d);
+		borrow = d >> 63;
+	}
+	trimLimbs(difference);
+	return difference;
+}
+
+static Limbs multiplyMagnitudes(const Limbs& a, const Limbs& b) {
+	if (a.empty() || b.empty())
+		return {};
+	Limbs product(a.size() + b.size());
+	for (size_t i = 0; i < a.size(); i++) {
+		uint64_t carry = 0;
+		for (size_t j = 0; j < b.size(); j++) {
+			carry += static_cast<uint64_t>(a[i]) * b[j] + product[i + j];
+			product[i + j] = static_cast<uint32_t>(carry);
+			carry >>= 32;
+		}
+		product[i + b.size()] = static_cast<uint32_t>(carry);
+	}
+	trimLimbs(product);
+	return product;
+}
+
+// a = a * factor + addend
+static void multiplyAdd(Limbs& a, uint32_t factor, uint32_t addend) {
+	uint64_t carry = addend;
+	for (uint32_t& limb : a) {
+		carry += static_cast<uint64_t>(limb) * factor;
+		limb = static_cast<uint32_t>(carry);
+		carry >>= 32;
+	}
+	if (carry)
+		a.push_back(static_cast<uint32_t>(carry));
+}
+
+// a = a / divisor, returns the remainder
+static uint32_t divideSmall(Limbs& a, uint32_t divisor) {
+	uint64_t remainder = 0;
+	for (size_t i = a.size(); i-- > 0;) {
+		uint64_t current = (remainder << 32) | a[i];
+		a[i] = static_cast<uint32_t>(current / divisor);
+		remainder = current % divisor;
+	}
+	trimLimbs(a);
+	return static_cast<uint32_t>(remainder);
+}
+
+static int leadingZeros(uint32_t x) {
+	int n = 0;
+	for (uint32_t bit = 0x80000000u; bit && !(x & bit); bit >>= 1)
+		n++;
+	return n;
+}
+
+// Truncating division of magnitudes, Knuth's algorithm D. `v` is not zero.
+static void divideMagnitudes(const Limbs& u, const Limbs& v, Limbs& quotient, Limbs& remainder) {
+	if (compareMagnitudes(u, v) < 0) {
+		quotient.clear();
+		remainder = u;
+		return;
+	}
+	if (v.size() == 1) {
+		quotient = u;
+		uint32_t r = divideSmall(quotient, v[0]);
+		remainder.clear();
+		if (r)
+			remainder.push_back(r);
+		return;
+	}
+
+	// Shift so the divisor's top limb has its high bit set, which keeps the
+	// quotient digit estimates at most two too large
+	size_t n = v.size(), m = u.size();
+	int shift = leadingZeros(v.back());
+	Limbs vn(n), un(m + 1);
+	for (size_t i = n - 1; i > 0; i--)
+		vn[i] = (v[i] << shift) | (shift ? v[i - 1] >> (32 - shift) : 0);
+	vn[0] = v[0] << shift;
+	un[m] = shift ? u[m - 1] >> (32 - shift) : 0;
+	for (size_t i = m - 1; i > 0; i--)
+		un[i] = (u[i] << shift) | (shift ? u[i - 1] >> (32 - shift) : 0);
+	un[0] = u[0] << shift;
+
+	quotient.assign(m - n + 1, 0);
+	for (size_t j = m - n + 1; j-- > 0;) {
+		uint64_t numerator = (static_cast<uint64_t>(un[j + n]) << 32) | un[j + n - 1];
+		uint64_t qhat = numerator / vn[n - 1];
+		uint64_t rhat = numerator % vn[n - 1];
+		while (qhat > UINT32_MAX || qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2])) {
+			qhat--;
+			rhat += vn[n - 1];
+			if (rhat > UINT32_MAX)
+				break;
+		}
+
+		// un[j..j+n] -= qhat * vn
+		uint64_t carry = 0, borrow = 0;
+		for (size_t i = 0; i < n; i++) {
+			uint64_t product = qhat * vn[i] + carry;
+			carry = product >> 32;
+			uint64_t d = static_cast<uint64_t>(un[i + j]) - static_cast<uint32_t>(product) - borrow;
+			un[i + j] = static_cast<uint32_t>(d);
+			borrow = d >> 63;
+		}
+		uint64_t d = static_cast<uint64_t>(un[j + n]) - carry - borrow;
+		un[j + n] = static_cast<uint32_t>(d);
+
+		if (d >> 63) { // one too many, add the divisor back
+			qhat--;
+			uint64_t sum = 0;
+			for (size_t i = 0; i < n; i++) {
+				sum += static_cast<uint64_t>(un[i + j]) + vn[i];
+				un[i + j] = static_cast<uint32_t>(sum);
+				sum >>= 32;
+			}
+			un[j + n] += static_cast<uint32_t>(sum);
+		}
+		quotient[j] = static_cast<uint32_t>(qhat);
+	}
+
+	remainder.resize(n);
+	for (size_t i = 0; i < n; i++)
+		remainder[i] = (un[i] >> shift) | (shift ? un[i + 1] << (32 - shift) : 0);
+	trimLimbs(quotient);
+	trimLimbs(remainder);
+}
+
+
+BigInt::BigInt(int64_t v) {
+	negative = v < 0;
+	uint64_t magnitude = negative ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v);
+	while (magnitude) {
+		limbs.push_back(static_cast<uint32_t>(magnitude));
+		magnitude >>= 32;
+	}
+}
+
+void BigInt::trim() {
+	trimLimbs(limbs);
+	if (limbs.empty())
+		negative = false;
+}
+
+BigInt BigInt::fromDecimal(std::string_view digits) {
+	BigInt result;
+	bool minus = !digits.empty() && digits[0] == '-';
+	if (minus)
+		digits.remove_prefix(1);
+	// Nine digits at a time, the first chunk takes the odd ones
+	size_t chunk = digits.size() % 9 ? digits.size() % 9 : 9;
+	for (size_t i = 0; i < digits.size(); i += chunk, chunk = 9) {
+		uint32_t value = 0, scale = 1;
+		for (size_t k = i; k < i + chunk; k++) {
+			value = value * 10 + static_cast<uint32_t>(digits[k] - '0');
+			scale *= 10;
+		}
+		multiplyAdd(result.limbs, scale, value);
+	}
+	result.negative = minus;
+	result.trim();
+	return result;
+}
+
+BigInt BigInt::fromDouble(double d) {
+	BigInt result;
+	int exponent;
+	double fraction = std::frexp(std::fabs(d), &exponent); // |d| = fraction * 2^exponent
+	uint64_t mantissa = static_cast<uint64_t>(std::ldexp(fraction, 53));
+	exponent -= 53;
+	if (exponent < 0)
+		mantissa >>= -exponent; // integral, so only zeros are shifted out
+	result.limbs = { static_cast<uint32_t>(mantissa), static_cast<uint32_t>(mantissa >> 32) };
+	if (exponent > 0) {
+		result.limbs.insert(result.limbs.begin(), exponent / 32, 0);
+		if (int bits = exponent % 32) {
+			result.limbs.push_back(0);
+			for (size_t i = result.limbs.size() - 1; i > 0; i--)
+				result.limbs[i] = (result.limbs[i] << bits) | (result.limbs[i - 1] >> (32 - bits));
+			result.limbs[0] <<= bits;
+		}
+	}
+	result.negative = d < 0;
+	result.trim();
+	return result;
+}
+
+bool BigInt::fitsInt64(int64_t& out) const {
+	if (limbs.size() > 2)
+		return false;
+	uint64_t magnitude = 0;
+	for (size_t i = limbs.size(); i-- > 0;)
+		magnitude = (magnitude << 32) | limbs[i];
+	if (negative) {
+		if (magnitude > static_cast<uint64_t>(INT64_MAX) + 1)
+			return false;
+		out = static_cast<int64_t>(0 - magnitude);
+	}
+	else {
+		if (magnitude > static_cast<uint64_t>(INT64_MAX))
+			return false;
+		out = static_cast<int64_t>(magnitude);
+	}
+	return true;
+}
+
+// The top 64 bits go through a single rounding conversion; a sticky low
+// bit stands in for anything nonzero below them so halfway cases round right
+double BigInt::toDouble() const {
+	if (limbs.empty())
+		return 0.0;
+	size_t bits = limbs.size() * 32 - leadingZeros(limbs.back());
+	uint64_t top = 0;
+	bool sticky = false;
+	if (bits <= 64) {
+		for (size_t i = limbs.size(); i-- > 0;)
+			top = (top << 32) | limbs[i];
+	}
+	else {
+		size_t low = bits - 64; // bit index of the lowest bit kept
+		for (size_t i = 0; i < low / 32; i++)
+			sticky = sticky || limbs[i] != 0;
+		size_t limb = low / 32, offset = low % 32;
+		if (offset && (limbs[limb] & ((1u << offset) - 1)))
+			sticky = true;
+		// Assemble bits [low, low + 64) from up to three limbs
+		for (size_t i = 0; i < 3 && limb + i < limbs.size(); i++) {
+			uint64_t part = limbs[limb + i];
+			size_t position = i * 32;
+			if (position < offset)
+				top |= part >> (offset - position);
+			else if (position - offset < 64)
+				top |= part << (position - offset);
+		}
+		if (sticky)
+			top |= 1;
+	}
+	double magnitude = std::ldexp(static_cast<double>(top), bits > 64 ? static_cast<int>(bits - 64) : 0);
+	return negative ? -magnitude : magnitude;
+}
+
+std::string BigInt::toString() const {
+	if (limbs.empty())
+		return "0";
+	Limbs rest = limbs;
+	std::vector<uint32_t> chunks; // base 10^9, least significant first
+	while (!rest.empty())
+		chunks.push_back(divideSmall(rest, kDecimalChunk));
+	std::string text = negative ? "-" : "";
+	text += std::to_string(chunks.back());
+	for (size_t i = chunks.size() - 1; i-- > 0;) {
+		std::string chunk = std::to_string(chunks[i]);
+		text.append(9 - chunk.size(), '0');
+		text += chunk;
+	}
+	return text;
+}
+
+BigInt BigInt::operator-() const {
+	BigInt result = *this;
+	if (!result.limbs.empty())
+		result.negative = !negative;
+	return result;
+}
+
+BigInt BigInt::signedSum(const BigInt& a, const BigInt& b, bool negateB) {
+	bool bNegative = b.negative != negateB;
+	BigInt result;
+	if (a.negative == bNegative) {
+		result.limbs = addMagnitudes(a.limbs, b.limbs);
+		result.negative = a.negative;
+	}
+	else if (compareMagnitudes(a.limbs, b.limbs) >= 0) {
+		result.limbs = subtractMagnitudes(a.limbs, b.limbs);
+		result.negative = a.negative;
+	}
+	else {
+		result.limbs = subtractMagnitudes(b.limbs, a.limbs);
+		result.negative = bNegative;
+	}
+	result.trim();
+	return result;
+}
+
+BigInt operator+(const BigInt& a, const BigInt& b) {
+	return BigInt::signedSum(a, b, false);
+}
+
+BigInt operator-(const BigInt& a, const BigInt& b) {
+	return BigInt::signedSum(a, b, true);
+}
+
+BigInt operator*(const BigInt& a, const BigInt& b) {
+	BigInt result;
+	result.limbs = multiplyMagnitudes(a.limbs, b.limbs);
+	result.negative = a.negative != b.negative;
+	result.trim();
+	return result;
+}
+
+void BigInt::floorDivMod(const BigInt& a, const BigInt& b, BigInt* quotient, BigInt* remainder) {
+	BigInt q, r;
+	divideMagnitudes(a.limbs, b.limbs, q.limbs, r.limbs);
+	q.negative = a.negative != b.negative;
+	r.negative = a.negative;
+	q.trim();
+	r.trim();
+	// Truncation rounded toward zero; floor needs one step down when the
+	// signs differ and something was left over
+	if (!r.isZero() && a.negative != b.negative) {
+		q = q - BigInt(1);
+		r = r + b;
+	}
+	if (quotient)
+		*quotient = std::move(q);
+	if (remainder)
+		*remainder = std::move(r);
+}
+
+int BigInt::compare(const BigInt& a, const BigInt& b) {
+	if (a.negative != b.negative)
+		return a.negative ? -1 : 1;
+	int magnitude = compareMagnitudes(a.limbs, b.limbs);
+	return a.negative ? -magnitude : magnitude;
+}
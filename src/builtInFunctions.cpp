@@ -1,4 +1,8 @@
 #include "builtInFunctions.h"
+#include "operators.h"
+#include "dict.h"
+#include "list.h"
+#include "listKernels.h"
 #include <iostream>
 #include <vector>
 #include <string>
@@ -20,18 +24,66 @@ Value printlnFunc(const std::vector<Value>& args) {
 }
 
 
+// Compared exactly, so the largest of several big integers is not lost to rounding
+static const Value& maxOf(const Value* values, size_t count) {
+    const Value* maxVal = &values[0];
+    maxVal->asNumber(); // numbers only
+    for (size_t i = 1; i < count; i++) {
+        if (greaterValues(values[i], *maxVal).asBool()) {
+            maxVal = &values[i];
+        }
+    }
+    return *maxVal;
+}
+
+static const Value& minOf(const Value* values, size_t count) {
+    const Value* minVal = &values[0];
+    minVal->asNumber(); // numbers only
+    for (size_t i = 1; i < count; i++) {
+        if (lessValues(values[i], *minVal).asBool()) {
+            minVal = &values[i];
+        }
+    }
+    return *minVal;
+}
+
+// max(list) and min(list): the SIMD kernels on unboxed storage, the
+// comparisons above on anything else (and on floats with a NaN among them)
+static Value listExtreme(const char* name, const ListObject& list, bool isMax) {
+    size_t count = list.size();
+    if (count == 0) {
+        throw std::runtime_error(std::string(name) + "() arg is an empty sequence");
+    }
+    const ListKernels& kernels = defaultListKernels();
+    if (list.storage() == ListObject::Storage::Ints) {
+        return Value::integer(isMax ? kernels.maxInts(list.ints(), count) : kernels.minInts(list.ints(), count));
+    }
+    if (list.storage() == ListObject::Storage::Doubles) {
+        double extreme;
+        if ((isMax ? kernels.maxDoubles : kernels.minDoubles)(list.doubles(), count, &extreme)) {
+            return Value(extreme);
+        }
+    }
+    if (list.storage() == ListObject::Storage::Boxed) {
+        return isMax ? maxOf(list.boxed(), count) : minOf(list.boxed(), count);
+    }
+    std::vector<Value> values;
+    values.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        values.push_back(list.get(i));
+    }
+    return isMax ? maxOf(values.data(), count) : minOf(values.data(), count);
+}
+
+
 Value maxFunc(const std::vector<Value>& args) {
     if (args.empty()) {
         throw std::runtime_error("max() requires at least one argument");
     }
-    double maxVal = args[0].asNumber();
-    for (const auto& v : args) {
-        double num = v.asNumber();
-        if (num > maxVal) {
-            maxVal = num;
-        }
+    if (args.size() == 1 && args[0].isList()) {
+        return listExtreme("max", args[0].asList(), true);
     }
-    return Value(maxVal);
+    return maxOf(args.data(), args.size());
 }
 
 
@@ -39,14 +91,10 @@ Value minFunc(const std::vector<Value>& args) {
     if (args.empty()) {
         throw std::runtime_error("min() requires at least one argument");
     }
-    double minVal = args[0].asNumber();
-    for (const auto& v : args) {
-        double num = v.asNumber();
-        if (num < minVal) {
-            minVal = num;
-        }
+    if (args.size() == 1 && args[0].isList()) {
+        return listExtreme("min", args[0].asList(), false);
     }
-    return Value(minVal);
+    return minOf(args.data(), args.size());
 }
 
 Value nowFunc(const std::vector<Value>& args) {
@@ -56,4 +104,65 @@ Value nowFunc(const std::vector<Value>& args) {
     // Return current time as a string
 	auto time = std::chrono::system_clock::now();
 
-}
\ No newline at end of file
+}
+
+
+Value lenFunc(const std::vector<Value>& args) {
+    if (args.size() != 1) {
+        throw std::runtime_error("len() takes exactly one argument (" + std::to_string(args.size()) + " given)");
+    }
+    if (args[0].isList()) {
+        return Value::integer(static_cast<int64_t>(args[0].asList().size()));
+    }
+    if (args[0].isString()) {
+        return Value::integer(static_cast<int64_t>(args[0].asString().size()));
+    }
+    if (args[0].isDict()) {
+        return Value::integer(static_cast<int64_t>(args[0].asDict().size()));
+    }
+    throw std::runtime_error("object of type '" + args[0].typeName() + "' has no len()");
+}
+
+
+Value appendFunc(const std::vector<Value>& args) {
+    if (args.empty() || !args[0].isList()) {
+        throw std::runtime_error("append() needs a list, got " + (args.empty() ? std::string("nothing") : args[0].typeName()));
+    }
+    if (args.size() != 2) {
+        throw std::runtime_error("append() takes exactly one argument (" + std::to_string(args.size() - 1) + " given)");
+    }
+    args[0].asList().append(args[1]);
+    return Value(); // return nothing / null
+}
+
+
+// sum(list) and sum(list, start). Integers add exactly: when the SIMD sum
+// overflows 64 bits the elements are added again one by one, promoting to
+// BigInt. Floats add left to right, as the loop over boxed elements does.
+Value sumFunc(const std::vector<Value>& args) {
+    if (args.empty() || args.size() > 2) {
+        throw std::runtime_error("sum() takes 1 or 2 arguments (" + std::to_string(args.size()) + " given)");
+    }
+    if (!args[0].isList()) {
+        throw std::runtime_error("'" + args[0].typeName() + "' object is not iterable");
+    }
+    const ListObject& list = args[0].asList();
+    Value total = args.size() == 2 ? args[1] : Value::integer(0);
+    size_t count = list.size();
+    const ListKernels& kernels = defaultListKernels();
+    if (list.storage() == ListObject::Storage::Ints) {
+        int64_t sum;
+        if (kernels.sumInts(list.ints(), count, &sum)) {
+            return addValues(total, Value::integer(sum));
+        }
+    }
+    else if (list.storage() == ListObject::Storage::Doubles && count > 0) {
+        // The first element makes the total a float, the kernel adds the rest
+        total = addValues(total, Value(list.doubles()[0]));
+        return Value(kernels.sumDoubles(total.asNumber(), list.doubles() + 1, count - 1));
+    }
+    for (size_t i = 0; i < count; i++) {
+        total = addValues(total, list.get(i));
+    }
+    return total;
+}
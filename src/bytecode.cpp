@@ -0,0 +1,107 @@
+#include "bytecode.h"
+
+uint32_t Module::functionSlot(const std::string& name) {
+	auto it = functionSlots.find(name);
+	if (it != functionSlots.end())
+		return it->second;
+	uint32_t slot = static_cast<uint32_t>(functionNames.size());
+	functionNames.push_back(name);
+	functionSlots[name] = slot;
+	return slot;
+}
+
+void Module::addBuiltin(const std::string& name, BuiltinFunc func) {
+	builtinSlots[name] = static_cast<uint32_t>(builtins.size());
+	builtinNames.push_back(name);
+	builtins.push_back(std::move(func));
+}
+
+const char* opcodeName(OpCode op) {
+	switch (op) {
+		case OpCode::CONSTANT: return "CONSTANT";
+		case OpCode::NONE: return "NONE";
+		case OpCode::TRUE_: return "TRUE";
+		case OpCode::FALSE_: return "FALSE";
+		case OpCode::POP: return "POP";
+		case OpCode::LOAD_LOCAL: return "LOAD_LOCAL";
+		case OpCode::STORE_LOCAL: return "STORE_LOCAL";
+		case OpCode::LOAD_GLOBAL: return "LOAD_GLOBAL";
+		case OpCode::STORE_GLOBAL: return "STORE_GLOBAL";
+		case OpCode::ADD: return "ADD";
+		case OpCode::SUB: return "SUB";
+		case OpCode::MUL: return "MUL";
+		case OpCode::DIV: return "DIV";
+		case OpCode::FLOORDIV: return "FLOORDIV";
+		case OpCode::MOD: return "MOD";
+		case OpCode::EQ: return "EQ";
+		case OpCode::NE: return "NE";
+		case OpCode::LT: return "LT";
+		case OpCode::LE: return "LE";
+		case OpCode::GT: return "GT";
+		case OpCode::GE: return "GE";
+		case OpCode::COMPARE_CHAIN: return "COMPARE_CHAIN";
+		case OpCode::NEG: return "NEG";
+		case OpCode::NOT: return "NOT";
+		case OpCode::BUILD_LIST: return "BUILD_LIST";
+		case OpCode::INDEX: return "INDEX";
+		case OpCode::STORE_INDEX: return "STORE_INDEX";
+		case OpCode::BUILD_DICT: return "BUILD_DICT";
+		case OpCode::IN: return "IN";
+		case OpCode::NOT_IN: return "NOT_IN";
+		case OpCode::JUMP: return "JUMP";
+		case OpCode::JUMP_IF_FALSE: return "JUMP_IF_FALSE";
+		case OpCode::JUMP_IF_FALSE_OR_POP: return "JUMP_IF_FALSE_OR_POP";
+		case OpCode::JUMP_IF_TRUE_OR_POP: return "JUMP_IF_TRUE_OR_POP";
+		case OpCode::RANGE_SETUP: return "RANGE_SETUP";
+		case OpCode::FOR_RANGE: return "FOR_RANGE";
+		case OpCode::FOR_EACH: return "FOR_EACH";
+		case OpCode::CALL: return "CALL";
+		case OpCode::CALL_BUILTIN: return "CALL_BUILTIN";
+		case OpCode::RETURN: return "RETURN";
+		case OpCode::DEF_FUNCTION: return "DEF_FUNCTION";
+		default: return "UNKNOWN";
+	}
+}
+
+std::string disassemble(const FunctionProto& proto) {
+	std::string out = "== " + proto.name + " (locals: " + std::to_string(proto.localNames.size())
+		+ ", stack: " + std::to_string(proto.maxStack) + ") ==\n";
+	for (size_t i = 0; i < proto.code.size(); i++) {
+		OpCode op = opcodeOf(proto.code[i]);
+		uint32_t arg = operandOf(proto.code[i]);
+		out += std::to_string(i) + "\t" + opcodeName(op);
+		switch (op) {
+			case OpCode::CONSTANT:
+				out += " " + proto.constants[arg].toString();
+				break;
+			case OpCode::LOAD_LOCAL:
+			case OpCode::STORE_LOCAL:
+				out += " " + proto.localNames[arg];
+				break;
+			case OpCode::LOAD_GLOBAL:
+			case OpCode::STORE_GLOBAL:
+			case OpCode::JUMP:
+			case OpCode::JUMP_IF_FALSE:
+			case OpCode::JUMP_IF_FALSE_OR_POP:
+			case OpCode::JUMP_IF_TRUE_OR_POP:
+			case OpCode::FOR_RANGE:
+			case OpCode::FOR_EACH:
+			case OpCode::BUILD_LIST:
+			case OpCode::BUILD_DICT:
+			case OpCode::DEF_FUNCTION:
+				out += " " + std::to_string(arg);
+				break;
+			case OpCode::COMPARE_CHAIN:
+				out += std::string(" ") + binaryOpSymbol(static_cast<BinaryOp>(arg));
+				break;
+			case OpCode::CALL:
+			case OpCode::CALL_BUILTIN:
+				out += " " + std::to_string(arg >> 8) + " argc=" + std::to_string(arg & 0xFF);
+				break;
+			default:
+				break;
+		}
+		out += "\n";
+	}
+	return out;
+}
@@ -0,0 +1,191 @@
+#include "charScan.h"
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CPPYTHON_SCAN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// AVX2 code is compiled per function so the rest of the build keeps its target
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+
+static const char* scalarIdentifierEnd(const char* p, const char* end) {
+	while (p < end && isIdentifierChar(*p))
+		p++;
+	return p;
+}
+
+static const char* scalarDigitsEnd(const char* p, const char* end) {
+	while (p < end && isDigitChar(*p))
+		p++;
+	return p;
+}
+
+static const char* scalarSpacesEnd(const char* p, const char* end) {
+	while (p < end && *p == ' ')
+		p++;
+	return p;
+}
+
+static const char* scalarStringEnd(const char* p, const char* end) {
+	while (p < end && *p != '"' && *p != '\0')
+		p++;
+	return p;
+}
+
+static const CharScanner scalarScanner = {
+	ScanIsa::Scalar, scalarIdentifierEnd, scalarDigitsEnd, scalarSpacesEnd, scalarStringEnd
+};
+
+
+#ifdef CPPYTHON_SCAN_X86
+
+static inline unsigned lowestBit(uint32_t mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+// Byte masks (0xFF where the byte is in the class). Comparisons are signed,
+// so bytes >= 0x80 fall below every range and never match.
+
+static inline __m128i inRange16(__m128i c, char lo, char hi) {
+	return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8(hi + 1)));
+}
+static inline __m128i digits16(__m128i c) { return inRange16(c, '0', '9'); }
+static inline __m128i identifier16(__m128i c) {
+	__m128i letter = inRange16(_mm_or_si128(c, _mm_set1_epi8(0x20)), 'a', 'z');
+	return _mm_or_si128(_mm_or_si128(letter, digits16(c)), _mm_cmpeq_epi8(c, _mm_set1_epi8('_')));
+}
+static inline __m128i spaces16(__m128i c) { return _mm_cmpeq_epi8(c, _mm_set1_epi8(' ')); }
+static inline __m128i stringBody16(__m128i c) {
+	__m128i stop = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('"')), _mm_cmpeq_epi8(c, _mm_setzero_si128()));
+	return _mm_andnot_si128(stop, _mm_set1_epi8(-1));
+}
+
+// Skip whole blocks while every byte matches, the scalar loop finishes the tail
+template <__m128i (*Match)(__m128i), const char* (*Tail)(const char*, const char*)>
+static const char* sse2RunEnd(const char* p, const char* end) {
+	while (end - p >= 16) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		uint32_t miss = ~static_cast<uint32_t>(_mm_movemask_epi8(Match(block))) & 0xFFFF;
+		if (miss)
+			return p + lowestBit(miss);
+		p += 16;
+	}
+	return Tail(p, end);
+}
+
+static const CharScanner sse2Scanner = {
+	ScanIsa::SSE2,
+	sse2RunEnd<identifier16, scalarIdentifierEnd>,
+	sse2RunEnd<digits16, scalarDigitsEnd>,
+	sse2RunEnd<spaces16, scalarSpacesEnd>,
+	sse2RunEnd<stringBody16, scalarStringEnd>,
+};
+
+
+TARGET_AVX2 static inline __m256i inRange32(__m256i c, char lo, char hi) {
+	return _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8(lo - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), c));
+}
+TARGET_AVX2 static inline __m256i digits32(__m256i c) { return inRange32(c, '0', '9'); }
+TARGET_AVX2 static inline __m256i identifier32(__m256i c) {
+	__m256i letter = inRange32(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), 'a', 'z');
+	return _mm256_or_si256(_mm256_or_si256(letter, digits32(c)), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('_')));
+}
+TARGET_AVX2 static inline __m256i spaces32(__m256i c) { return _mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')); }
+TARGET_AVX2 static inline __m256i stringBody32(__m256i c) {
+	__m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(c, _mm256_setzero_si256()));
+	return _mm256_andnot_si256(stop, _mm256_set1_epi8(-1));
+}
+
+// Same as sse2RunEnd, the SSE2 version takes over for the last 16-31 bytes
+template <__m256i (*Match)(__m256i), const char* (*Tail)(const char*, const char*)>
+TARGET_AVX2 static const char* avx2RunEnd(const char* p, const char* end) {
+	while (end - p >= 32) {
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		uint32_t miss = ~static_cast<uint32_t>(_mm256_movemask_epi8(Match(block)));
+		if (miss)
+			return p + lowestBit(miss);
+		p += 32;
+	}
+	return Tail(p, end);
+}
+
+static const CharScanner avx2Scanner = {
+	ScanIsa::AVX2,
+	avx2RunEnd<identifier32, sse2RunEnd<identifier16, scalarIdentifierEnd>>,
+	avx2RunEnd<digits32, sse2RunEnd<digits16, scalarDigitsEnd>>,
+	avx2RunEnd<spaces32, sse2RunEnd<spaces16, scalarSpacesEnd>>,
+	avx2RunEnd<stringBody32, sse2RunEnd<stringBody16, scalarStringEnd>>,
+};
+
+static bool cpuHasAvx2() {
+#ifdef _MSC_VER
+	int regs[4];
+	__cpuid(regs, 1);
+	bool osSavesYmm = (regs[2] & (1 << 27)) && (regs[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+	__cpuidex(regs, 7, 0);
+	return osSavesYmm && (regs[1] & (1 << 5));
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // CPPYTHON_SCAN_X86
+
+
+bool scanIsaSupported(ScanIsa isa) {
+	switch (isa) {
+		case ScanIsa::Scalar:
+			return true;
+#ifdef CPPYTHON_SCAN_X86
+		case ScanIsa::SSE2:
+			return true; // part of x86-64
+		case ScanIsa::AVX2: {
+			static const bool avx2 = cpuHasAvx2();
+			return avx2;
+		}
+#endif
+		default:
+			return false;
+	}
+}
+
+const CharScanner& scannerFor(ScanIsa isa) {
+	if (!scanIsaSupported(isa))
+		return scalarScanner;
+	switch (isa) {
+#ifdef CPPYTHON_SCAN_X86
+		case ScanIsa::SSE2: return sse2Scanner;
+		case ScanIsa::AVX2: return avx2Scanner;
+#endif
+		default: return scalarScanner;
+	}
+}
+
+const CharScanner& defaultScanner() {
+	static const CharScanner& best = scanIsaSupported(ScanIsa::AVX2) ? scannerFor(ScanIsa::AVX2) : scannerFor(ScanIsa::SSE2);
+	return best;
+}
+
+const char* scanIsaName(ScanIsa isa) {
+	switch (isa) {
+		case ScanIsa::Scalar: return "scalar";
+		case ScanIsa::SSE2: return "SSE2";
+		case ScanIsa::AVX2: return "AVX2";
+	}
+	return "unknown";
+}
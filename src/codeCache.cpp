@@ -0,0 +1,291 @@
+#include "codeCache.h"
+#include "sourceBuffer.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+// File layout, all integers in native byte order (the marker rejects files
+// from a machine of the other endianness):
+//   "CPYC" version marker key
+//   builtin names, global names, function names
+//   function count, index of the top level, then per function:
+//     name arity nameSlot maxStack localNames code constants lazySource
+//   (a stub has no code and its definition as lazySource, a compiled
+//   function an empty lazySource)
+//   checksum of everything before it
+// Lists are a u32 count followed by the items, strings a u32 length and
+// the bytes. A constant is a tag byte followed by its payload.
+
+static const char kMagic[4] = { 'C', 'P', 'Y', 'C' };
+static const uint32_t kEndianMarker = 0x01020304;
+
+enum class ConstantTag : uint8_t { Number, String, True, False, Int, BigInt };
+
+// FNV-1a, plenty for telling versions of one script apart
+static uint64_t fnv1a(std::string_view bytes, uint64_t hash = 0xcbf29ce484222325ull) {
+	for (unsigned char c : bytes) {
+		hash ^= c;
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+uint64_t codeCacheKey(std::string_view source, bool optimized, bool lazy) {
+	return fnv1a(lazy ? "L" : "-", fnv1a(optimized ? "O" : "-", fnv1a(source)));
+}
+
+std::string codeCachePath(const std::string& scriptPath, const std::string& cacheDir) {
+	fs::path script(scriptPath);
+	std::string stem = script.stem().string();
+	if (cacheDir.empty())
+		return (script.parent_path() / "__cppycache__" / (stem + ".cpyc")).string();
+	// Scripts from different directories share the cache directory
+	std::error_code error;
+	fs::path absolute = fs::absolute(script, error);
+	char hash[17];
+	std::snprintf(hash, sizeof hash, "%016llx", static_cast<unsigned long long>(fnv1a(absolute.string())));
+	return (fs::path(cacheDir) / (stem + "." + hash + ".cpyc")).string();
+}
+
+
+namespace {
+
+class Writer {
+public:
+	std::string out;
+
+	void u8(uint8_t v) { out.push_back(static_cast<char>(v)); }
+	void u32(uint32_t v) { out.append(reinterpret_cast<const char*>(&v), sizeof v); }
+	void u64(uint64_t v) { out.append(reinterpret_cast<const char*>(&v), sizeof v); }
+	void f64(double v) { out.append(reinterpret_cast<const char*>(&v), sizeof v); }
+	void string(std::string_view s) {
+		u32(static_cast<uint32_t>(s.size()));
+		out.append(s.data(), s.size());
+	}
+	void strings(const std::vector<std::string>& list) {
+		u32(static_cast<uint32_t>(list.size()));
+		for (const std::string& s : list)
+			string(s);
+	}
+};
+
+// Reads from the mapped file. Running past the end or reading a count that
+// cannot fit clears `ok` instead of throwing; callers check it once at the end.
+class Reader {
+public:
+	Reader(std::string_view data) : p(data.data()), end(data.data() + data.size()) {}
+	bool ok = true;
+
+	bool bytes(void* dest, size_t size) {
+		if (static_cast<size_t>(end - p) < size) {
+			ok = false;
+			p = end;
+			return false;
+		}
+		if (size) // dest is null for an empty vector, a stub's code
+			std::memcpy(dest, p, size);
+		p += size;
+		return true;
+	}
+	uint8_t u8() { uint8_t v = 0; bytes(&v, sizeof v); return v; }
+	uint32_t u32() { uint32_t v = 0; bytes(&v, sizeof v); return v; }
+	uint64_t u64() { uint64_t v = 0; bytes(&v, sizeof v); return v; }
+	double f64() { double v = 0; bytes(&v, sizeof v); return v; }
+	// A count of items at least `itemSize` bytes each
+	uint32_t count(size_t itemSize) {
+		uint32_t n = u32();
+		if (static_cast<size_t>(end - p) / itemSize < n) {
+			ok = false;
+			p = end;
+			return 0;
+		}
+		return n;
+	}
+	std::string_view string() {
+		uint32_t size = count(1);
+		std::string_view s(p, size);
+		p += size;
+		return s;
+	}
+	std::vector<std::string> strings() {
+		std::vector<std::string> list(count(sizeof(uint32_t)));
+		for (std::string& s : list)
+			s = string();
+		return list;
+	}
+	bool atEnd() const { return p == end; }
+
+private:
+	const char* p;
+	const char* end;
+};
+
+}
+
+
+// Decimal digits of a BigInt constant, anything else is damage
+static Value readBigInt(Reader& r) {
+	std::string_view digits = r.string();
+	size_t first = !digits.empty() && digits[0] == '-' ? 1 : 0;
+	if (digits.size() == first || digits.find_first_not_of("0123456789", first) != std::string_view::npos) {
+		r.ok = false;
+		return Value();
+	}
+	return Value::integerFromDecimal(digits);
+}
+
+
+bool saveCodeCache(const std::string& path, uint64_t key, const Module& module, const FunctionProto& script) {
+	Writer w;
+	w.out.append(kMagic, sizeof kMagic);
+	w.u32(kCodeCacheVersion);
+	w.u32(kEndianMarker);
+	w.u64(key);
+	w.strings(module.builtinNames);
+	w.strings(module.globals.names);
+	w.strings(module.functionNames);
+
+	uint32_t scriptIndex = UINT32_MAX;
+	w.u32(static_cast<uint32_t>(module.functions.size()));
+	for (size_t i = 0; i < module.functions.size(); i++)
+		if (module.functions[i].get() == &script)
+			scriptIndex = static_cast<uint32_t>(i);
+	if (scriptIndex == UINT32_MAX)
+		return false;
+	w.u32(scriptIndex);
+
+	for (const auto& proto : module.functions) {
+		if (!proto)
+			return false; // released after running, the module is not fresh
+		w.string(proto->name);
+		w.u32(proto->arity);
+		w.u32(proto->nameSlot);
+		w.u32(proto->maxStack);
+		w.strings(proto->localNames);
+		w.u32(static_cast<uint32_t>(proto->code.size()));
+		w.out.append(reinterpret_cast<const char*>(proto->code.data()), proto->code.size() * sizeof(Instruction));
+		w.u32(static_cast<uint32_t>(proto->constants.size()));
+		for (const Value& constant : proto->constants) {
+			if (constant.isString()) {
+				w.u8(static_cast<uint8_t>(ConstantTag::String));
+				w.string(constant.asString());
+			}
+			else if (constant.isBool()) {
+				w.u8(static_cast<uint8_t>(constant.asBool() ? ConstantTag::True : ConstantTag::False));
+			}
+			else if (constant.isDouble()) {
+				w.u8(static_cast<uint8_t>(ConstantTag::Number));
+				w.f64(constant.asDouble());
+			}
+			else if (constant.isSmallInt()) {
+				w.u8(static_cast<uint8_t>(ConstantTag::Int));
+				w.u64(static_cast<uint64_t>(constant.asSmallInt()));
+			}
+			else if (constant.isBigInt()) {
+				w.u8(static_cast<uint8_t>(ConstantTag::BigInt));
+				w.string(constant.asBigInt().toString());
+			}
+			else {
+				return false; // nothing else is compiled to a constant
+			}
+		}
+		w.string(proto->lazySource);
+	}
+
+	w.u64(fnv1a(w.out));
+
+	// Write a private temporary file and rename it over the old one
+	std::error_code error;
+	fs::path target(path);
+	if (target.has_parent_path())
+		fs::create_directories(target.parent_path(), error);
+	fs::path temp = target;
+	temp += ".tmp" + std::to_string(std::random_device{}());
+	{
+		std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+		if (!file.write(w.out.data(), static_cast<std::streamsize>(w.out.size()))) {
+			file.close();
+			fs::remove(temp, error);
+			return false;
+		}
+	}
+	fs::rename(temp, target, error);
+	if (error) {
+		fs::remove(temp, error);
+		return false;
+	}
+	return true;
+}
+
+const FunctionProto* loadCodeCache(const std::string& path, uint64_t key, Module& module) {
+	if (!module.functions.empty() || !module.globals.names.empty() || !module.functionNames.empty())
+		return nullptr;
+
+	SourceBuffer file(std::string{});
+	try {
+		file = SourceBuffer::fromFile(path);
+	}
+	catch (const std::exception&) {
+		return nullptr; // no cache yet
+	}
+	std::string_view data = file.text();
+	uint64_t checksum;
+	if (data.size() < sizeof checksum)
+		return nullptr;
+	std::memcpy(&checksum, data.data() + data.size() - sizeof checksum, sizeof checksum);
+	data.remove_suffix(sizeof checksum);
+	if (fnv1a(data) != checksum)
+		return nullptr; // damaged or truncated
+
+	Reader r(data);
+	char magic[sizeof kMagic] = {};
+	r.bytes(magic, sizeof magic);
+	if (!r.ok || std::memcmp(magic, kMagic, sizeof kMagic) != 0 || r.u32() != kCodeCacheVersion ||
+		r.u32() != kEndianMarker || r.u64() != key || r.strings() != module.builtinNames)
+		return nullptr;
+
+	// Decode everything before touching the module, a damaged file leaves it as it was
+	std::vector<std::string> globalNames = r.strings();
+	std::vector<std::string> functionNames = r.strings();
+	std::vector<std::unique_ptr<FunctionProto>> functions(r.count(1));
+	uint32_t scriptIndex = r.u32();
+	for (auto& proto : functions) {
+		proto = std::make_unique<FunctionProto>();
+		proto->name = r.string();
+		proto->arity = r.u32();
+		proto->nameSlot = r.u32();
+		proto->maxStack = r.u32();
+		proto->localNames = r.strings();
+		proto->code.resize(r.count(sizeof(Instruction)));
+		r.bytes(proto->code.data(), proto->code.size() * sizeof(Instruction));
+		proto->constants.resize(r.count(1));
+		for (Value& constant : proto->constants) {
+			switch (static_cast<ConstantTag>(r.u8())) {
+				case ConstantTag::Number: constant = Value(r.f64()); break;
+				case ConstantTag::String: constant = Value::internedString(r.string()); break;
+				case ConstantTag::True: constant = Value(true); break;
+				case ConstantTag::False: constant = Value(false); break;
+				case ConstantTag::Int: constant = Value::integer(static_cast<int64_t>(r.u64())); break;
+				case ConstantTag::BigInt: constant = readBigInt(r); break;
+				default: r.ok = false; break;
+			}
+		}
+		proto->lazySource = r.string();
+		if (!r.ok || proto->code.empty() == proto->lazySource.empty())
+			return nullptr; // either code or a stub's source
+	}
+	if (!r.ok || !r.atEnd() || scriptIndex >= functions.size())
+		return nullptr;
+
+	for (const std::string& name : globalNames)
+		module.globals.slotFor(name);
+	for (const std::string& name : functionNames)
+		module.functionSlot(name);
+	module.functions = std::move(functions);
+	return module.functions[scriptIndex].get();
+}
@@ -0,0 +1,457 @@
+#include "compiler.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "resolver.h"
+#include <stdexcept>
+#include <string>
+
+
+FunctionProto* Compiler::newFunction(const std::string& name) {
+	module.functions.push_back(std::make_unique<FunctionProto>());
+	FunctionProto* proto = module.functions.back().get();
+	proto->name = name;
+	return proto;
+}
+
+FunctionProto* Compiler::compile(Program& program) {
+	Resolver(module.globals, *program.arena).resolve(*program.root);
+
+	current = newFunction("<module>");
+	stackDepth = 0;
+
+	auto block = dynamic_cast<BlockNode*>(program.root);
+	if (!block) {
+		expression(*program.root);
+		emit(OpCode::RETURN);
+		return current;
+	}
+
+	// Keep the value of a trailing expression statement as the result
+	for (size_t i = 0; i < block->statements.size(); i++) {
+		if (i + 1 < block->statements.size()) {
+			statement(*block->statements[i]);
+			continue;
+		}
+		uint32_t depth = stackDepth;
+		inExpression = false;
+		block->statements[i]->accept(*this);
+		if (stackDepth > depth) {
+			emit(OpCode::RETURN);
+			return current;
+		}
+	}
+	emit(OpCode::NONE);
+	emit(OpCode::RETURN);
+	return current;
+}
+
+// Compile a node for its side effects; expression statements are popped
+void Compiler::statement(ASTNode& node) {
+	uint32_t depth = stackDepth;
+	bool saved = inExpression;
+	inExpression = false;
+	node.accept(*this);
+	inExpression = saved;
+	if (stackDepth > depth)
+		emit(OpCode::POP);
+}
+
+// Compile a node that leaves exactly one value on the stack
+void Compiler::expression(ASTNode& node) {
+	bool saved = inExpression;
+	inExpression = true;
+	node.accept(*this);
+	inExpression = saved;
+}
+
+
+void Compiler::emit(OpCode op, uint32_t arg) {
+	if (arg > kMaxOperand)
+		throw std::runtime_error("Compiler limit exceeded: operand too large");
+	current->code.push_back(encode(op, arg));
+
+	// Track the temporary stack depth so the VM can size frames up front
+	switch (op) {
+		case OpCode::CONSTANT:
+		case OpCode::NONE:
+		case OpCode::TRUE_:
+		case OpCode::FALSE_:
+		case OpCode::LOAD_LOCAL:
+		case OpCode::LOAD_GLOBAL:
+		case OpCode::FOR_RANGE: // on the path into the body
+		case OpCode::FOR_EACH:
+			stackDepth++;
+			break;
+		case OpCode::CALL:
+		case OpCode::CALL_BUILTIN:
+			stackDepth = stackDepth - (arg & 0xFF) + 1;
+			break;
+		case OpCode::BUILD_LIST:
+			stackDepth = stackDepth - arg + 1;
+			break;
+		case OpCode::BUILD_DICT:
+			stackDepth = stackDepth - 2 * arg + 1;
+			break;
+		case OpCode::STORE_INDEX:
+			stackDepth -= 3;
+			break;
+		case OpCode::NEG:
+		case OpCode::NOT:
+		case OpCode::JUMP:
+		case OpCode::RANGE_SETUP:
+		case OpCode::COMPARE_CHAIN:
+		case OpCode::DEF_FUNCTION:
+			break;
+		default: // POP, stores, binary operators, conditional jumps (on the path that pops), RETURN
+			stackDepth--;
+			break;
+	}
+	if (stackDepth > current->maxStack)
+		current->maxStack = stackDepth;
+}
+
+size_t Compiler::emitJump(OpCode op) {
+	emit(op, 0);
+	return current->code.size() - 1;
+}
+
+void Compiler::patchJump(size_t at) {
+	uint32_t target = static_cast<uint32_t>(current->code.size());
+	if (target > kMaxOperand)
+		throw std::runtime_error("Compiler limit exceeded: function body too large");
+	current->code[at] = encode(opcodeOf(current->code[at]), target);
+}
+
+uint32_t Compiler::addConstant(const Value& value) {
+	current->constants.push_back(value);
+	return static_cast<uint32_t>(current->constants.size() - 1);
+}
+
+
+void Compiler::visit(NumberNode& node) {
+	emit(OpCode::CONSTANT, addConstant(node.literal()));
+}
+
+void Compiler::visit(BinaryOpNode& node) {
+	expression(*node.left);
+	if (node.op == BinaryOp::And || node.op == BinaryOp::Or) {
+		// The left operand stays as the result when it decides
+		size_t skip = emitJump(node.op == BinaryOp::And ? OpCode::JUMP_IF_FALSE_OR_POP : OpCode::JUMP_IF_TRUE_OR_POP);
+		expression(*node.right);
+		patchJump(skip);
+		return;
+	}
+	expression(*node.right);
+
+	switch (node.op) {
+		case BinaryOp::Add: emit(OpCode::ADD); break;
+		case BinaryOp::Sub: emit(OpCode::SUB); break;
+		case BinaryOp::Mul: emit(OpCode::MUL); break;
+		case BinaryOp::Div: emit(OpCode::DIV); break;
+		case BinaryOp::FloorDiv: emit(OpCode::FLOORDIV); break;
+		case BinaryOp::Mod: emit(OpCode::MOD); break;
+		case BinaryOp::Equal: emit(OpCode::EQ); break;
+		case BinaryOp::NotEqual: emit(OpCode::NE); break;
+		case BinaryOp::Less: emit(OpCode::LT); break;
+		case BinaryOp::LessEqual: emit(OpCode::LE); break;
+		case BinaryOp::Greater: emit(OpCode::GT); break;
+		case BinaryOp::GreaterEqual: emit(OpCode::GE); break;
+		case BinaryOp::In: emit(OpCode::IN); break;
+		case BinaryOp::NotIn: emit(OpCode::NOT_IN); break;
+		default: throw std::runtime_error(std::string("Unknown binary operator: ") + binaryOpSymbol(node.op));
+	}
+}
+
+static OpCode comparisonOpcode(BinaryOp op) {
+	switch (op) {
+		case BinaryOp::Equal: return OpCode::EQ;
+		case BinaryOp::NotEqual: return OpCode::NE;
+		case BinaryOp::Less: return OpCode::LT;
+		case BinaryOp::LessEqual: return OpCode::LE;
+		case BinaryOp::Greater: return OpCode::GT;
+		case BinaryOp::In: return OpCode::IN;
+		case BinaryOp::NotIn: return OpCode::NOT_IN;
+		default: return OpCode::GE;
+	}
+}
+
+//   a b COMPARE_CHAIN(<) JUMP_IF_FALSE_OR_POP false
+//   c COMPARE_CHAIN(<) JUMP_IF_FALSE_OR_POP false ...
+//   z LT; JUMP end
+//   false: POP POP FALSE	(the kept operand and the false result)
+//   end:
+void Compiler::visit(ComparisonChainNode& node) {
+	expression(*node.operands[0]);
+	std::vector<size_t> falseJumps;
+	size_t last = node.ops.size() - 1;
+	for (size_t i = 0; i < last; i++) {
+		expression(*node.operands[i + 1]);
+		emit(OpCode::COMPARE_CHAIN, static_cast<uint32_t>(node.ops[i]));
+		falseJumps.push_back(emitJump(OpCode::JUMP_IF_FALSE_OR_POP));
+	}
+	expression(*node.operands[last + 1]);
+	emit(comparisonOpcode(node.ops[last]));
+	uint32_t depth = stackDepth;
+	size_t endJump = emitJump(OpCode::JUMP);
+	for (size_t at : falseJumps)
+		patchJump(at);
+	stackDepth = depth + 1; // the kept operand and the result
+	emit(OpCode::POP);
+	emit(OpCode::POP);
+	emit(OpCode::FALSE_);
+	patchJump(endJump);
+}
+
+void Compiler::visit(UnaryOpNode& node) {
+	expression(*node.factor);
+	if (node.op == UnaryOp::Minus)
+		emit(OpCode::NEG);
+	else if (node.op == UnaryOp::Not)
+		emit(OpCode::NOT);
+	// unary plus, do nothing
+}
+
+void Compiler::visit(VarNode& node) {
+	emit(node.scope == VarScope::Local ? OpCode::LOAD_LOCAL : OpCode::LOAD_GLOBAL, node.slot);
+}
+
+void Compiler::visit(AssignmentNode& node) {
+	expression(*node.value);
+	auto& var = static_cast<VarNode&>(*node.varNode);
+	emit(var.scope == VarScope::Local ? OpCode::STORE_LOCAL : OpCode::STORE_GLOBAL, var.slot);
+}
+
+void Compiler::visit(BooleanNode& node) {
+	emit(node.value ? OpCode::TRUE_ : OpCode::FALSE_);
+}
+
+// Literals are interned: every use of "key" is the same string, so dict
+// lookups with it compare pointers
+void Compiler::visit(StringNode& node) {
+	emit(OpCode::CONSTANT, addConstant(Value::internedString(node.value)));
+}
+
+void Compiler::visit(ListNode& node) {
+	if (node.elements.size() > kMaxOperand)
+		throw std::runtime_error("Compiler limit exceeded: list display too long");
+	for (const auto& element : node.elements)
+		expression(*element);
+	emit(OpCode::BUILD_LIST, static_cast<uint32_t>(node.elements.size()));
+}
+
+void Compiler::visit(DictNode& node) {
+	if (node.items.size() / 2 > kMaxOperand)
+		throw std::runtime_error("Compiler limit exceeded: dict display too long");
+	for (const auto& item : node.items)
+		expression(*item);
+	emit(OpCode::BUILD_DICT, static_cast<uint32_t>(node.items.size() / 2));
+}
+
+void Compiler::visit(IndexNode& node) {
+	expression(*node.container);
+	expression(*node.index);
+	emit(OpCode::INDEX);
+}
+
+void Compiler::visit(IndexAssignmentNode& node) {
+	expression(*node.value);
+	auto& target = static_cast<IndexNode&>(*node.target);
+	expression(*target.container);
+	expression(*target.index);
+	emit(OpCode::STORE_INDEX);
+}
+
+void Compiler::visit(BlockNode& node) {
+	if (!inExpression) {
+		for (const auto& stmt : node.statements)
+			statement(*stmt);
+		return;
+	}
+	// A block used as an expression (the arms of `a if c else b`)
+	// evaluates to its last statement
+	if (node.statements.empty()) {
+		emit(OpCode::NONE);
+		return;
+	}
+	for (size_t i = 0; i + 1 < node.statements.size(); i++)
+		statement(*node.statements[i]);
+	expression(*node.statements.back());
+}
+
+void Compiler::visit(IfNode& node) {
+	bool asExpression = inExpression;
+	expression(*node.condition);
+	size_t elseJump = emitJump(OpCode::JUMP_IF_FALSE);
+	uint32_t depth = stackDepth;
+
+	if (asExpression) expression(*node.body);
+	else statement(*node.body);
+
+	if (!node.elseBody && !asExpression) {
+		patchJump(elseJump);
+		return;
+	}
+	size_t endJump = emitJump(OpCode::JUMP);
+	patchJump(elseJump);
+	stackDepth = depth; // only one arm runs
+	if (!node.elseBody) emit(OpCode::NONE);
+	else if (asExpression) expression(*node.elseBody);
+	else statement(*node.elseBody);
+	patchJump(endJump);
+}
+
+void Compiler::visit(WhileNode& node) {
+	uint32_t loopStart = static_cast<uint32_t>(current->code.size());
+	expression(*node.condition);
+	size_t exitJump = emitJump(OpCode::JUMP_IF_FALSE);
+	loops.push_back({ loopStart, {} });
+	statement(*node.body);
+	emit(OpCode::JUMP, loopStart);
+	patchJump(exitJump);
+	for (size_t at : loops.back().breaks)
+		patchJump(at);
+	loops.pop_back();
+}
+
+// The range state stays on the stack while the loop runs, so the counter
+// needs no allocation and no name lookup:
+//   start stop step RANGE_SETUP
+//   loop: FOR_RANGE end; STORE var; body; JUMP loop
+//   end: POP POP POP
+// A break jumps to end, past FOR_RANGE but before the state is popped.
+void Compiler::visit(ForRangeNode& node) {
+	if (node.start) expression(*node.start);
+	else emit(OpCode::CONSTANT, addConstant(Value::integer(0)));
+	expression(*node.stop);
+	if (node.step) expression(*node.step);
+	else emit(OpCode::CONSTANT, addConstant(Value::integer(1)));
+	emit(OpCode::RANGE_SETUP);
+
+	uint32_t loopStart = static_cast<uint32_t>(current->code.size());
+	size_t exitJump = emitJump(OpCode::FOR_RANGE);
+	auto& var = static_cast<VarNode&>(*node.varNode);
+	emit(var.scope == VarScope::Local ? OpCode::STORE_LOCAL : OpCode::STORE_GLOBAL, var.slot);
+	loops.push_back({ loopStart, {} });
+	statement(*node.body);
+	emit(OpCode::JUMP, loopStart);
+	patchJump(exitJump);
+	for (size_t at : loops.back().breaks)
+		patchJump(at);
+	loops.pop_back();
+	for (int i = 0; i < 3; i++)
+		emit(OpCode::POP);
+}
+
+// Like a range loop, with the iterable and the position on the stack:
+//   iterable CONSTANT(0)
+//   loop: FOR_EACH end; STORE var; body; JUMP loop
+//   end: POP POP
+void Compiler::visit(ForEachNode& node) {
+	expression(*node.iterable);
+	emit(OpCode::CONSTANT, addConstant(Value::integer(0)));
+
+	uint32_t loopStart = static_cast<uint32_t>(current->code.size());
+	size_t exitJump = emitJump(OpCode::FOR_EACH);
+	auto& var = static_cast<VarNode&>(*node.varNode);
+	emit(var.scope == VarScope::Local ? OpCode::STORE_LOCAL : OpCode::STORE_GLOBAL, var.slot);
+	loops.push_back({ loopStart, {} });
+	statement(*node.body);
+	emit(OpCode::JUMP, loopStart);
+	patchJump(exitJump);
+	for (size_t at : loops.back().breaks)
+		patchJump(at);
+	loops.pop_back();
+	emit(OpCode::POP);
+	emit(OpCode::POP);
+}
+
+void Compiler::visit(BreakNode&) {
+	loops.back().breaks.push_back(emitJump(OpCode::JUMP));
+}
+
+void Compiler::visit(ContinueNode&) {
+	emit(OpCode::JUMP, loops.back().continueTarget);
+}
+
+void Compiler::visit(FunctionCallNode& node) {
+	if (node.arguments.size() > 0xFF)
+		throw std::runtime_error("Function '" + std::string(node.funcName) + "' called with too many arguments");
+	for (const auto& arg : node.arguments)
+		expression(*arg);
+	uint32_t argc = static_cast<uint32_t>(node.arguments.size());
+
+	// Built-ins take precedence over user functions, as in the Interpreter
+	std::string name(node.funcName);
+	auto builtin = module.builtinSlots.find(name);
+	if (builtin != module.builtinSlots.end())
+		emit(OpCode::CALL_BUILTIN, builtin->second << 8 | argc);
+	else
+		emit(OpCode::CALL, module.functionSlot(name) << 8 | argc);
+}
+
+void Compiler::visit(FunctionDefNode& node) {
+	if (node.parameters.size() > 0xFF)
+		throw std::runtime_error("Function '" + std::string(node.funcName) + "' has too many parameters");
+
+	FunctionProto* proto = newFunction(std::string(node.funcName));
+	proto->arity = static_cast<uint32_t>(node.parameters.size());
+	proto->nameSlot = module.functionSlot(proto->name);
+	uint32_t index = static_cast<uint32_t>(module.functions.size() - 1);
+	if (node.body)
+		functionBody(*proto, node);
+	else
+		proto->lazySource.assign(node.source); // a stub until the first call
+
+	emit(OpCode::DEF_FUNCTION, index);
+}
+
+void Compiler::functionBody(FunctionProto& proto, FunctionDefNode& node) {
+	// Save the enclosing function's state
+	FunctionProto* enclosing = current;
+	uint32_t enclosingDepth = stackDepth;
+	bool enclosingInExpression = inExpression;
+	std::vector<Loop> enclosingLoops = std::move(loops);
+	loops.clear();
+
+	current = &proto;
+	current->localNames.assign(node.localNames.begin(), node.localNames.end());
+	stackDepth = 0;
+
+	statement(*node.body);
+	emit(OpCode::NONE);
+	emit(OpCode::RETURN);
+
+	current = enclosing;
+	stackDepth = enclosingDepth;
+	inExpression = enclosingInExpression;
+	loops = std::move(enclosingLoops);
+}
+
+void Compiler::compileLazy(FunctionProto& proto) {
+	Lexer lexer(proto.lazySource);
+	Program program = Parser(lexer, true).parseFunction();
+	if (module.optimizeLazyBodies)
+		Optimizer().optimize(program);
+	Resolver(module.globals, *program.arena).resolve(*program.root);
+
+	try {
+		functionBody(proto, static_cast<FunctionDefNode&>(*program.root));
+	}
+	catch (...) {
+		// Leave a stub behind, not half a body
+		proto.code.clear();
+		proto.constants.clear();
+		proto.localNames.clear();
+		proto.maxStack = 0;
+		throw;
+	}
+	std::string().swap(proto.lazySource);
+}
+
+void Compiler::visit(ReturnNode& node) {
+	if (node.value != nullptr)
+		expression(*node.value);
+	else
+		emit(OpCode::NONE);
+	emit(OpCode::RETURN);
+}
@@ -0,0 +1,90 @@
+#include "dict.h"
+#include "operators.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+
+// Equal numbers hash alike: an int by its value, a double that holds an
+// integer like that integer. Integers past 64 bits hash like the double they
+// round to, which is exact when they equal one.
+uint64_t DictKeyHash::operator()(const Value& key) const {
+	if (key.isString())
+		return key.asStringObject().hash();
+	int64_t integer;
+	if (key.toInt64(integer))
+		return static_cast<uint64_t>(integer);
+	if (key.isDouble() || key.isBigInt()) {
+		double d = key.isDouble() ? key.asDouble() : key.asBigInt().toDouble();
+		if (d == std::trunc(d) && d >= -9223372036854775808.0 && d < 9223372036854775808.0)
+			return static_cast<uint64_t>(static_cast<int64_t>(d));
+		uint64_t bits;
+		std::memcpy(&bits, &d, sizeof bits);
+		return bits;
+	}
+	throw std::runtime_error("unhashable type: '" + key.typeName() + "'");
+}
+
+// Only called for keys with equal hashes
+bool DictKeyEqual::operator()(const Value& a, const Value& b) const {
+	if (a.isString() || b.isString()) {
+		if (!a.isString() || !b.isString())
+			return false;
+		const StringObject& x = a.asStringObject();
+		const StringObject& y = b.asStringObject();
+		if (&x == &y)
+			return true;
+		if (x.interned && y.interned)
+			return false; // there is one interned copy of each string
+		return x.value == y.value;
+	}
+	return equalValues(a, b).asBool();
+}
+
+
+std::string DictObject::repr() const {
+	// A dict inside itself prints as {...}
+	thread_local std::vector<const DictObject*> printing;
+	if (std::find(printing.begin(), printing.end(), this) != printing.end())
+		return "{...}";
+	printing.push_back(this);
+	std::string out = "{";
+	try {
+		for (size_t i = 0; i < size(); i++) {
+			if (i)
+				out += ", ";
+			out += keyAt(i).repr() + ": " + valueAt(i).repr();
+		}
+	}
+	catch (...) {
+		printing.pop_back();
+		throw;
+	}
+	printing.pop_back();
+	return out + "}";
+}
+
+
+Value makeDict(const Value* pairs, size_t count) {
+	DictObject* dict = new DictObject();
+	Value result(dict);
+	dict->reserve(count);
+	for (size_t i = 0; i < count; i++)
+		dict->set(pairs[2 * i], pairs[2 * i + 1]);
+	return result;
+}
+
+bool dictsEqual(const DictObject& a, const DictObject& b) {
+	if (&a == &b)
+		return true;
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++) {
+		const Value* other = b.find(a.keyAt(i));
+		if (!other || !valuesEqual(a.valueAt(i), *other))
+			return false;
+	}
+	return true;
+}
@@ -1,32 +1,35 @@
 #include "dotGenerator.h"
+#include <utility>
 
 
-std::string DotGenerator::generate(const ASTNodePtr root) {
+std::string DotGenerator::generate(ASTNode& root) {
 	dot = "digraph G {\n";
+	counter = 0;
+	stack.clear();
 	// traverse the AST and build the dot representation
-	root->accept(*this);
+	root.accept(*this);
 	dot += "}\n";
 	return dot;
 }
 
-void DotGenerator::visit(const UnaryOpNode& node) {
+void DotGenerator::visit(UnaryOpNode& node) {
 	std::string id = newId();
-	dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + node.op + "]" + "\"];\n";
+	dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + unaryOpSymbol(node.op) + "]" + "\"];\n";
 	node.factor->accept(*this);
 	std::string factorId = stack.back().id; stack.pop_back();
 	dot += "    " + id + " -> " + factorId + ";\n";
 	stack.push_back({ id });
 }
 
-void DotGenerator::visit(const NumberNode& node) {
+void DotGenerator::visit(NumberNode& node) {
     std::string id = newId();
-    dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + node.value + "]" + "\"];\n";
+    dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + node.toString() + "]" + "\"];\n";
     stack.push_back({ id });
 }
 
-void DotGenerator::visit(const BinaryOpNode& node) {
+void DotGenerator::visit(BinaryOpNode& node) {
     std::string id = newId();
-    dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + node.op + "]" + "\"];\n";
+    dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + binaryOpSymbol(node.op) + "]" + "\"];\n";
 
     node.left->accept(*this);
     std::string leftId = stack.back().id; stack.pop_back();
@@ -40,13 +43,28 @@ void DotGenerator::visit(const BinaryOpNode& node) {
 }
 
 
-void DotGenerator::visit(const VarNode& node) {
+void DotGenerator::visit(ComparisonChainNode& node) {
 	std::string id = newId();
-	dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + node.name + "]" + "\"];\n";
+	std::string ops;
+	for (BinaryOp op : node.ops)
+		ops += std::string(ops.empty() ? "" : " ") + binaryOpSymbol(op);
+	dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + ops + "]" + "\"];\n";
+	for (const auto& operand : node.operands) {
+		operand->accept(*this);
+		std::string operandId = stack.back().id; stack.pop_back();
+		dot += "    " + id + " -> " + operandId + ";\n";
+	}
 	stack.push_back({ id });
 }
 
-void DotGenerator::visit(const AssignmentNode& node) {
+
+void DotGenerator::visit(VarNode& node) {
+	std::string id = newId();
+	dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + std::string(node.name) + "]" + "\"];\n";
+	stack.push_back({ id });
+}
+
+void DotGenerator::visit(AssignmentNode& node) {
 	std::string id = newId();
 	dot += "    " + id + " [label=\"" + node.getNodeType() + "\"];\n";
 	// Variable node
@@ -54,25 +72,72 @@ void DotGenerator::visit(const AssignmentNode& node) {
 	dot += "    " + varId + " [label=\"Var[" + node.varNode->toString() + "]\"];\n";
 	dot += "    " + id + " -> " + varId + ";\n";
 	// Value expression
-	node.value->accept(*this);
-	std::string valueId = stack.back().id; stack.pop_back();
-	dot += "    " + id + " -> " + valueId + ";\n";
+	if (node.value) {
+		node.value->accept(*this);
+		std::string valueId = stack.back().id; stack.pop_back();
+		dot += "    " + id + " -> " + valueId + ";\n";
+	}
+	stack.push_back({ id });
+}
+
+void DotGenerator::visit(BooleanNode& node) {
+	std::string id = newId();
+	dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + node.toString() + "]" + "\"];\n";
+	stack.push_back({ id });
+}
+
+void DotGenerator::visit(StringNode& node) {
+	std::string id = newId();
+	dot += "    " + id + " [label=\"" + node.getNodeType() + "[\\\"" + std::string(node.value) + "\\\"]" + "\"];\n";
+	stack.push_back({ id });
+}
+
+void DotGenerator::visit(ListNode& node) {
+	std::string id = newId();
+	dot += "    " + id + " [label=\"" + node.getNodeType() + "\"];\n";
+	for (const auto& element : node.elements) {
+		element->accept(*this);
+		std::string elementId = stack.back().id; stack.pop_back();
+		dot += "    " + id + " -> " + elementId + ";\n";
+	}
+	stack.push_back({ id });
+}
+
+// Keys and values alternate, as in the flat tree
+void DotGenerator::visit(DictNode& node) {
+	std::string id = newId();
+	dot += "    " + id + " [label=\"" + node.getNodeType() + "\"];\n";
+	for (size_t i = 0; i < node.items.size(); i++) {
+		node.items[i]->accept(*this);
+		std::string itemId = stack.back().id; stack.pop_back();
+		dot += "    " + id + " -> " + itemId + " [label=\"" + (i % 2 ? "value" : "key") + "\"];\n";
+	}
 	stack.push_back({ id });
 }
 
-void DotGenerator::visit(const BooleanNode& node) {
+void DotGenerator::visit(IndexNode& node) {
 	std::string id = newId();
-	dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + (node.value) + "]" + "\"];\n";
+	dot += "    " + id + " [label=\"" + node.getNodeType() + "\"];\n";
+	for (ASTNodePtr child : { node.container, node.index }) {
+		child->accept(*this);
+		std::string childId = stack.back().id; stack.pop_back();
+		dot += "    " + id + " -> " + childId + ";\n";
+	}
 	stack.push_back({ id });
 }
 
-void DotGenerator::visit(const StringNode& node) {
+void DotGenerator::visit(IndexAssignmentNode& node) {
 	std::string id = newId();
-	dot += "    " + id + " [label=\"" + node.getNodeType() + "[\\\"" + node.value + "\\\"]" + "\"];\n";
+	dot += "    " + id + " [label=\"" + node.getNodeType() + "\"];\n";
+	for (ASTNodePtr child : { node.target, node.value }) {
+		child->accept(*this);
+		std::string childId = stack.back().id; stack.pop_back();
+		dot += "    " + id + " -> " + childId + ";\n";
+	}
 	stack.push_back({ id });
 }
 
-void DotGenerator::visit(const BlockNode& node) {
+void DotGenerator::visit(BlockNode& node) {
 	std::string id = newId();
 	dot += "    " + id + " [label=\"" + node.getNodeType() + "\"];\n";
 	for (const auto& stmt : node.statements) {
@@ -83,7 +148,7 @@ void DotGenerator::visit(const BlockNode& node) {
 	stack.push_back({ id });
 }
 
-void DotGenerator::visit(const IfNode& node) {
+void DotGenerator::visit(IfNode& node) {
 	std::string id = newId();
 	dot += "    " + id + " [label=\"" + node.getNodeType() + "\"];\n";
 	// Condition
@@ -102,7 +167,7 @@ void DotGenerator::visit(const IfNode& node) {
 	}
 }
 
-void DotGenerator::visit(const WhileNode& node) {
+void DotGenerator::visit(WhileNode& node) {
 	std::string id = newId();
 	dot += "    " + id + " [label=\"" + node.getNodeType() + "\"];\n";
 	// Condition
@@ -116,9 +181,54 @@ void DotGenerator::visit(const WhileNode& node) {
 	stack.push_back({ id });
 }
 
-void DotGenerator::visit(const FunctionCallNode& node) {
+void DotGenerator::visit(ForRangeNode& node) {
+	std::string id = newId();
+	dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + node.varNode->toString() + "]" + "\"];\n";
+	// Bounds of the range
+	std::pair<ASTNodePtr, const char*> bounds[] = { { node.start, "start" }, { node.stop, "stop" }, { node.step, "step" } };
+	for (const auto& bound : bounds) {
+		if (!bound.first)
+			continue;
+		bound.first->accept(*this);
+		std::string boundId = stack.back().id; stack.pop_back();
+		dot += "    " + id + " -> " + boundId + " [label=\"" + bound.second + "\"];\n";
+	}
+	// Body
+	node.body->accept(*this);
+	std::string bodyId = stack.back().id; stack.pop_back();
+	dot += "    " + id + " -> " + bodyId + " [label=\"body\"];\n";
+	stack.push_back({ id });
+}
+
+void DotGenerator::visit(ForEachNode& node) {
+	std::string id = newId();
+	dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + node.varNode->toString() + "]" + "\"];\n";
+	// Iterable
+	node.iterable->accept(*this);
+	std::string iterableId = stack.back().id; stack.pop_back();
+	dot += "    " + id + " -> " + iterableId + " [label=\"iterable\"];\n";
+	// Body
+	node.body->accept(*this);
+	std::string bodyId = stack.back().id; stack.pop_back();
+	dot += "    " + id + " -> " + bodyId + " [label=\"body\"];\n";
+	stack.push_back({ id });
+}
+
+void DotGenerator::visit(BreakNode& node) {
+	std::string id = newId();
+	dot += "    " + id + " [label=\"" + node.getNodeType() + "\"];\n";
+	stack.push_back({ id });
+}
+
+void DotGenerator::visit(ContinueNode& node) {
+	std::string id = newId();
+	dot += "    " + id + " [label=\"" + node.getNodeType() + "\"];\n";
+	stack.push_back({ id });
+}
+
+void DotGenerator::visit(FunctionCallNode& node) {
 	std::string id = newId();
-	dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + node.funcName + "]" + "\"];\n";
+	dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + std::string(node.funcName) + "]" + "\"];\n";
 	// Arguments
 	for (const auto& arg : node.arguments) {
 		arg->accept(*this);
@@ -136,7 +246,12 @@ void DotGenerator::visit(FunctionDefNode& node) {
 		if (!paramsStr.empty()) paramsStr += ", ";
 		paramsStr += param;
 	}
-	dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + node.funcName + "(" + paramsStr + ")]" + "\"];\n";
+	std::string lazy = node.body ? "" : " lazy";
+	dot += "    " + id + " [label=\"" + node.getNodeType() + "[" + std::string(node.funcName) + "(" + paramsStr + ")]" + lazy + "\"];\n";
+	if (!node.body) {
+		stack.push_back({ id });
+		return;
+	}
 	// Body
 	node.body->accept(*this);
 	std::string bodyId = stack.back().id; stack.pop_back();
@@ -148,8 +263,148 @@ void DotGenerator::visit(ReturnNode& node) {
 	std::string id = newId();
 	dot += "    " + id + " [label=\"" + node.getNodeType() + "\"];\n";
 	// Value expression
-	node.value->accept(*this);
-	std::string valueId = stack.back().id; stack.pop_back();
-	dot += "    " + id + " -> " + valueId + ";\n";
+	if (node.value) {
+		node.value->accept(*this);
+		std::string valueId = stack.back().id; stack.pop_back();
+		dot += "    " + id + " -> " + valueId + ";\n";
+	}
 	stack.push_back({ id });
-}
\ No newline at end of file
+}
+
+
+std::string DotGenerator::generate(const FlatAst& ast) {
+	dot = "digraph G {\n";
+	counter = 0;
+	if (ast.root != kNoNode)
+		flatNode(ast, ast.root);
+	dot += "}\n";
+	return dot;
+}
+
+std::string DotGenerator::flatNode(const FlatAst& ast, FlatIndex node) {
+	std::string id = newId();
+	auto label = [&](const std::string& text) { dot += "    " + id + " [label=\"" + text + "\"];\n"; };
+	auto edge = [&](FlatIndex child, const char* edgeLabel) {
+		std::string childId = flatNode(ast, child);
+		dot += "    " + id + " -> " + childId + (edgeLabel ? std::string(" [label=\"") + edgeLabel + "\"]" : "") + ";\n";
+	};
+
+	switch (ast.kind(node)) {
+		case FlatKind::Number: {
+			const Value& number = ast.numbers[ast.a[node]];
+			label("Number[" + (number.isDouble() ? NumberNode(number.asDouble()).toString() : number.toString()) + "]"); // spelled like the tree's
+			break;
+		}
+		case FlatKind::BinaryOp:
+			label(std::string("BinaryOp[") + binaryOpSymbol(ast.binaryOp(node)) + "]");
+			edge(ast.a[node], nullptr);
+			edge(ast.b[node], nullptr);
+			break;
+		case FlatKind::ComparisonChain: {
+			const uint32_t* links = ast.list(ast.a[node]);
+			std::string ops;
+			for (uint32_t i = 0; i < ast.b[node]; i++)
+				ops += std::string(i ? " " : "") + binaryOpSymbol(static_cast<BinaryOp>(links[2 * i + 1]));
+			label("Comparison[" + ops + "]");
+			for (uint32_t i = 0; i <= ast.b[node]; i++)
+				edge(links[2 * i], nullptr);
+			break;
+		}
+		case FlatKind::UnaryOp:
+			label(std::string("UnaryOp[") + unaryOpSymbol(ast.unaryOp(node)) + "]");
+			edge(ast.a[node], nullptr);
+			break;
+		case FlatKind::Var:
+			label("Var[" + std::string(ast.name(node)) + "]");
+			break;
+		case FlatKind::Assignment: {
+			label("Assignment");
+			std::string varId = newId();
+			dot += "    " + varId + " [label=\"Var[" + std::string(ast.name(ast.a[node])) + "]\"];\n";
+			dot += "    " + id + " -> " + varId + ";\n";
+			edge(ast.b[node], nullptr);
+			break;
+		}
+		case FlatKind::Boolean:
+			label(ast.ops[node] ? "Boolean[True]" : "Boolean[False]");
+			break;
+		case FlatKind::String:
+			label("String[\\\"" + std::string(ast.name(node)) + "\\\"]");
+			break;
+		case FlatKind::Block:
+			label("Block");
+			for (uint32_t i = 0; i < ast.b[node]; i++)
+				edge(ast.lists[ast.a[node] + i], nullptr);
+			break;
+		case FlatKind::List:
+			label("List");
+			for (uint32_t i = 0; i < ast.b[node]; i++)
+				edge(ast.lists[ast.a[node] + i], nullptr);
+			break;
+		case FlatKind::Dict:
+			label("Dict");
+			for (uint32_t i = 0; i < 2 * ast.b[node]; i++)
+				edge(ast.lists[ast.a[node] + i], i % 2 ? "value" : "key");
+			break;
+		case FlatKind::Index:
+		case FlatKind::IndexAssignment:
+			label(ast.kind(node) == FlatKind::Index ? "Index" : "IndexAssignment");
+			edge(ast.a[node], nullptr);
+			edge(ast.b[node], nullptr);
+			break;
+		case FlatKind::If:
+			label("If");
+			edge(ast.a[node], "condition");
+			edge(ast.lists[ast.b[node]], "body");
+			if (ast.lists[ast.b[node] + 1] != kNoNode)
+				edge(ast.lists[ast.b[node] + 1], "else");
+			break;
+		case FlatKind::While:
+			label("While");
+			edge(ast.a[node], "condition");
+			edge(ast.b[node], "body");
+			break;
+		case FlatKind::ForRange: {
+			label("For[" + std::string(ast.name(ast.a[node])) + "]");
+			const uint32_t* fields = ast.list(ast.b[node]);
+			const char* edgeLabels[] = { "start", "stop", "step", "body" };
+			for (int i = 0; i < 4; i++)
+				if (fields[i] != kNoNode)
+					edge(fields[i], edgeLabels[i]);
+			break;
+		}
+		case FlatKind::ForEach:
+			label("ForEach[" + std::string(ast.name(ast.a[node])) + "]");
+			edge(ast.lists[ast.b[node]], "iterable");
+			edge(ast.lists[ast.b[node] + 1], "body");
+			break;
+		case FlatKind::Break:
+			label("Break");
+			break;
+		case FlatKind::Continue:
+			label("Continue");
+			break;
+		case FlatKind::FunctionCall:
+			label("FunctionCall[" + std::string(ast.name(node)) + "]");
+			for (uint32_t i = 1; i <= ast.lists[ast.b[node]]; i++)
+				edge(ast.lists[ast.b[node] + i], "arg");
+			break;
+		case FlatKind::FunctionDef: {
+			const FlatFunction& function = ast.function(node);
+			std::string paramsStr;
+			for (uint32_t i = 0; i < function.paramCount; i++) {
+				if (!paramsStr.empty()) paramsStr += ", ";
+				paramsStr += ast.names[ast.lists[function.params + i]];
+			}
+			label("FunctionDef[" + std::string(ast.name(node)) + "(" + paramsStr + ")]");
+			edge(function.body, "body");
+			break;
+		}
+		case FlatKind::Return:
+			label("Return");
+			if (ast.a[node] != kNoNode)
+				edge(ast.a[node], nullptr);
+			break;
+	}
+	return id;
+}
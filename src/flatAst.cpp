@@ -0,0 +1,187 @@
+#include "flatAst.h"
+
+
+size_t FlatAst::memoryUsed() const {
+	return kinds.capacity() * sizeof(FlatKind) + ops.capacity() +
+		(a.capacity() + b.capacity() + lists.capacity() + localNames.capacity()) * sizeof(uint32_t) +
+		numbers.capacity() * sizeof(Value) +
+		names.capacity() * sizeof(std::string_view) +
+		functions.capacity() * sizeof(FlatFunction) +
+		strings->bytesAllocated();
+}
+
+
+FlatBuilder::FlatBuilder() {
+	ast.strings = std::make_shared<Arena>();
+}
+
+// Typical code has about one node per five bytes and half as many list entries
+void FlatBuilder::reserveFor(size_t sourceBytes) {
+	size_t nodes = sourceBytes / 5 + 16;
+	ast.kinds.reserve(nodes);
+	ast.ops.reserve(nodes);
+	ast.a.reserve(nodes);
+	ast.b.reserve(nodes);
+	ast.lists.reserve(nodes / 2);
+	ast.numbers.reserve(nodes / 4);
+}
+
+FlatIndex FlatBuilder::add(FlatKind kind, uint32_t a, uint32_t b, uint8_t op) {
+	FlatIndex node = static_cast<FlatIndex>(ast.kinds.size());
+	ast.kinds.push_back(kind);
+	ast.ops.push_back(op);
+	ast.a.push_back(a);
+	ast.b.push_back(b);
+	return node;
+}
+
+// Strings are numbered as they are interned, so a node needs no second lookup
+std::string_view FlatBuilder::intern(std::string_view s) {
+	auto it = nameIndex.find(s);
+	if (it == nameIndex.end()) {
+		std::string_view stored = ast.strings->intern(s);
+		it = nameIndex.emplace(stored, static_cast<uint32_t>(ast.names.size())).first;
+		ast.names.push_back(stored);
+	}
+	lastInterned = it->second;
+	return ast.names[lastInterned];
+}
+
+// Every name the Parser passes in came from intern()
+uint32_t FlatBuilder::nameFor(std::string_view name) {
+	if (lastInterned < ast.names.size() && ast.names[lastInterned].data() == name.data())
+		return lastInterned;
+	return nameIndex.at(name);
+}
+
+uint32_t FlatBuilder::addList(const uint32_t* items, size_t count) {
+	uint32_t first = static_cast<uint32_t>(ast.lists.size());
+	ast.lists.insert(ast.lists.end(), items, items + count);
+	return first;
+}
+
+
+FlatIndex FlatBuilder::number(const Token& token) {
+	switch (token.numberKind) {
+		case NumberKind::Int: ast.numbers.push_back(Value::integer(token.integer)); break;
+		case NumberKind::BigInt: ast.numbers.push_back(Value::integerFromDecimal(token.value)); break;
+		default: ast.numbers.push_back(Value(token.number)); break;
+	}
+	return add(FlatKind::Number, static_cast<uint32_t>(ast.numbers.size() - 1));
+}
+
+FlatIndex FlatBuilder::binary(Node left, BinaryOp op, Node right) {
+	return add(FlatKind::BinaryOp, left, right, static_cast<uint8_t>(op));
+}
+
+FlatIndex FlatBuilder::comparisonChain(const Node* operands, const BinaryOp* ops, size_t opCount) {
+	uint32_t first = static_cast<uint32_t>(ast.lists.size());
+	ast.lists.push_back(operands[0]);
+	for (size_t i = 0; i < opCount; i++) {
+		ast.lists.push_back(static_cast<uint32_t>(ops[i]));
+		ast.lists.push_back(operands[i + 1]);
+	}
+	return add(FlatKind::ComparisonChain, first, static_cast<uint32_t>(opCount));
+}
+
+FlatIndex FlatBuilder::unary(UnaryOp op, Node operand) {
+	return add(FlatKind::UnaryOp, operand, 0, static_cast<uint8_t>(op));
+}
+
+FlatIndex FlatBuilder::var(std::string_view name) {
+	return add(FlatKind::Var, nameFor(name), 0, static_cast<uint8_t>(VarScope::Unresolved));
+}
+
+FlatIndex FlatBuilder::assignment(Node var, Node value) {
+	return add(FlatKind::Assignment, var, value);
+}
+
+FlatIndex FlatBuilder::boolean(bool value) {
+	return add(FlatKind::Boolean, 0, 0, value);
+}
+
+FlatIndex FlatBuilder::string(std::string_view value) {
+	return add(FlatKind::String, nameFor(value));
+}
+
+FlatIndex FlatBuilder::list(const Node* elements, size_t count) {
+	return add(FlatKind::List, addList(elements, count), static_cast<uint32_t>(count));
+}
+
+FlatIndex FlatBuilder::dict(const Node* items, size_t pairCount) {
+	return add(FlatKind::Dict, addList(items, 2 * pairCount), static_cast<uint32_t>(pairCount));
+}
+
+FlatIndex FlatBuilder::index(Node container, Node index) {
+	return add(FlatKind::Index, container, index);
+}
+
+FlatIndex FlatBuilder::indexAssignment(Node target, Node value) {
+	return add(FlatKind::IndexAssignment, target, value);
+}
+
+FlatIndex FlatBuilder::block(const Node* statements, size_t count) {
+	return add(FlatKind::Block, addList(statements, count), static_cast<uint32_t>(count));
+}
+
+FlatIndex FlatBuilder::ifNode(Node condition, Node body, Node elseBody) {
+	FlatIndex arms[] = { body, elseBody };
+	return add(FlatKind::If, condition, addList(arms, 2));
+}
+
+FlatIndex FlatBuilder::whileNode(Node condition, Node body) {
+	return add(FlatKind::While, condition, body);
+}
+
+FlatIndex FlatBuilder::forRange(Node var, Node start, Node stop, Node step, Node body) {
+	FlatIndex fields[] = { start, stop, step, body };
+	return add(FlatKind::ForRange, var, addList(fields, 4));
+}
+
+FlatIndex FlatBuilder::forEach(Node var, Node iterable, Node body) {
+	FlatIndex fields[] = { iterable, body };
+	return add(FlatKind::ForEach, var, addList(fields, 2));
+}
+
+FlatIndex FlatBuilder::breakNode() {
+	return add(FlatKind::Break);
+}
+
+FlatIndex FlatBuilder::continueNode() {
+	return add(FlatKind::Continue);
+}
+
+FlatIndex FlatBuilder::call(std::string_view name, const Node* args, size_t count) {
+	uint32_t first = static_cast<uint32_t>(ast.lists.size());
+	ast.lists.push_back(static_cast<uint32_t>(count));
+	addList(args, count);
+	return add(FlatKind::FunctionCall, nameFor(name), first);
+}
+
+FlatIndex FlatBuilder::functionDef(std::string_view name, const std::string_view* params, size_t count, Node body) {
+	FlatFunction function;
+	function.body = body;
+	function.params = static_cast<uint32_t>(ast.lists.size());
+	function.paramCount = static_cast<uint32_t>(count);
+	for (size_t i = 0; i < count; i++)
+		ast.lists.push_back(nameFor(params[i]));
+	ast.functions.push_back(function);
+	return add(FlatKind::FunctionDef, nameFor(name), static_cast<uint32_t>(ast.functions.size() - 1));
+}
+
+FlatIndex FlatBuilder::returnNode(Node value) {
+	return add(FlatKind::Return, value);
+}
+
+// The arrays only grow while parsing; give back the slack of their last doubling
+FlatAst FlatBuilder::finish(Node root) {
+	ast.root = root;
+	nameIndex.clear();
+	ast.kinds.shrink_to_fit();
+	ast.ops.shrink_to_fit();
+	ast.a.shrink_to_fit();
+	ast.b.shrink_to_fit();
+	ast.lists.shrink_to_fit();
+	ast.numbers.shrink_to_fit();
+	return std::move(ast);
+}
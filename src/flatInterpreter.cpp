@@ -0,0 +1,369 @@
+#include "flatInterpreter.h"
+#include "dict.h"
+#include "list.h"
+#include "operators.h"
+#include "resolver.h"
+
+
+FlatInterpreter::FlatInterpreter() : arena(kArenaSlots) {
+	frames.reserve(kMaxCallDepth);
+	builtins["print"] = printFunc;
+	builtins["println"] = printlnFunc;
+	builtins["max"] = maxFunc;
+	builtins["min"] = minFunc;
+	builtins["len"] = lenFunc;
+	builtins["append"] = appendFunc;
+	builtins["sum"] = sumFunc;
+}
+
+std::vector<std::string> FlatInterpreter::backtrace() const {
+	std::vector<std::string> names;
+	for (const auto& frame : frames)
+		names.emplace_back(frame.ast->name(frame.node));
+	if (activeBuiltin)
+		names.emplace_back(*activeBuiltin);
+	return names;
+}
+
+Value FlatInterpreter::interpret(FlatAst program) {
+	if (program.root == kNoNode)
+		throw std::runtime_error("No AST to interpret");
+	programs.push_back(std::make_unique<FlatAst>(std::move(program)));
+	resolveFlat(*programs.back(), globalScope);
+	setCode(programs.back().get());
+	globals.resize(globalScope.names.size(), Value::undefined()); // the REPL may add names
+	// Drop whatever an earlier failed run left behind
+	locals = nullptr;
+	frames.clear();
+	arena.reset();
+	activeBuiltin = nullptr;
+	completion = Completion::Normal;
+	size_t functionCount = definedFunctions.size();
+	try {
+		eval(code->root);
+	}
+	catch (...) {
+		releaseUnlessDefining(functionCount);
+		throw;
+	}
+	releaseUnlessDefining(functionCount);
+	return result;
+}
+
+// A program is kept only while functions it defined may still be called
+void FlatInterpreter::releaseUnlessDefining(size_t functionCount) {
+	if (definedFunctions.size() == functionCount) {
+		programs.pop_back();
+		setCode(nullptr);
+	}
+}
+
+// Leaves the node's value in `result`, like Interpreter's visit methods
+void FlatInterpreter::eval(FlatIndex node) {
+	const View& ast = view;
+	switch (ast.kinds[node]) {
+		case FlatKind::Number:
+			result = ast.numbers[ast.a[node]];
+			break;
+
+		case FlatKind::BinaryOp: {
+			eval(ast.a[node]);
+			BinaryOp op = static_cast<BinaryOp>(ast.ops[node]);
+			if (op == BinaryOp::And || op == BinaryOp::Or) {
+				if (!shortCircuits(op, result))
+					eval(ast.b[node]);
+				break; // result holds the deciding operand
+			}
+			Value lresult = std::move(result);
+			eval(ast.b[node]);
+			result = applyBinary(op, lresult, result);
+			break;
+		}
+
+		case FlatKind::ComparisonChain: {
+			const uint32_t* links = ast.lists + ast.a[node]; // operand, then (op, operand) pairs
+			eval(links[0]);
+			Value left = std::move(result);
+			for (uint32_t i = 0; i < ast.b[node]; i++) {
+				eval(links[2 * i + 2]);
+				Value right = std::move(result);
+				result = applyBinary(static_cast<BinaryOp>(links[2 * i + 1]), left, right);
+				if (!result.isTruthy())
+					break;
+				left = std::move(right);
+			}
+			break;
+		}
+
+		case FlatKind::UnaryOp:
+			eval(ast.a[node]);
+			result = applyUnary(static_cast<UnaryOp>(ast.ops[node]), result);
+			break;
+
+		case FlatKind::Var: {
+			bool local = ast.ops[node] == static_cast<uint8_t>(VarScope::Local);
+			const Value& value = local ? locals[ast.b[node]] : globals[ast.b[node]];
+			if (value.isUndefined())
+				undefinedVariable(node);
+			result = value;
+			break;
+		}
+
+		case FlatKind::Assignment: {
+			eval(ast.b[node]);
+			FlatIndex var = ast.a[node];
+			if (ast.ops[var] == static_cast<uint8_t>(VarScope::Local))
+				locals[ast.b[var]] = result;
+			else
+				globals[ast.b[var]] = result;
+			break;
+		}
+
+		case FlatKind::Boolean:
+			result = Value(ast.ops[node] != 0);
+			break;
+
+		case FlatKind::String:
+			result = Value(code->name(node));
+			break;
+
+		case FlatKind::List: {
+			const uint32_t* elements = ast.lists + ast.a[node];
+			uint32_t count = ast.b[node];
+			Value* items = arena.push(count);
+			for (uint32_t i = 0; i < count; i++) {
+				eval(elements[i]);
+				items[i] = result;
+			}
+			result = makeList(items, count);
+			arena.pop(items);
+			break;
+		}
+
+		case FlatKind::Dict: {
+			const uint32_t* pairs = ast.lists + ast.a[node];
+			uint32_t count = 2 * ast.b[node];
+			Value* items = arena.push(count);
+			for (uint32_t i = 0; i < count; i++) {
+				eval(pairs[i]);
+				items[i] = result;
+			}
+			result = makeDict(items, ast.b[node]);
+			arena.pop(items);
+			break;
+		}
+
+		case FlatKind::Index: {
+			eval(ast.a[node]);
+			Value container = std::move(result);
+			eval(ast.b[node]);
+			result = indexValue(container, result);
+			break;
+		}
+
+		case FlatKind::IndexAssignment: {
+			eval(ast.b[node]);
+			Value value = std::move(result);
+			FlatIndex target = ast.a[node];
+			eval(ast.a[target]);
+			Value container = std::move(result);
+			eval(ast.b[target]);
+			storeIndex(container, result, value);
+			result = std::move(value);
+			break;
+		}
+
+		case FlatKind::Block: {
+			const uint32_t* statements = ast.lists + ast.a[node];
+			for (uint32_t i = 0; i < ast.b[node]; i++) {
+				eval(statements[i]);
+				if (completion != Completion::Normal)
+					break;
+			}
+			break;
+		}
+
+		case FlatKind::If: {
+			const uint32_t* arms = ast.lists + ast.b[node];
+			eval(ast.a[node]);
+			if (result.isTruthy())
+				eval(arms[0]);
+			else if (arms[1] != kNoNode)
+				eval(arms[1]);
+			break;
+		}
+
+		case FlatKind::While:
+			eval(ast.a[node]);
+			while (result.isTruthy()) {
+				eval(ast.b[node]);
+				if (loopExits())
+					break;
+				eval(ast.a[node]);
+			}
+			break;
+
+		case FlatKind::ForRange:
+			forRange(node);
+			break;
+
+		case FlatKind::ForEach:
+			forEach(node);
+			break;
+
+		case FlatKind::Break:
+			completion = Completion::Break;
+			break;
+
+		case FlatKind::Continue:
+			completion = Completion::Continue;
+			break;
+
+		case FlatKind::FunctionCall:
+			call(node);
+			break;
+
+		case FlatKind::FunctionDef:
+			define(node);
+			break;
+
+		case FlatKind::Return:
+			if (ast.a[node] != kNoNode)
+				eval(ast.a[node]);
+			else
+				result = Value(); // return None
+			completion = Completion::Return;
+			break;
+	}
+}
+
+// Same as Interpreter::loopExits()
+bool FlatInterpreter::loopExits() {
+	if (completion == Completion::Normal)
+		return false;
+	if (completion == Completion::Return)
+		return true;
+	bool exits = completion == Completion::Break;
+	completion = Completion::Normal;
+	return exits;
+}
+
+void FlatInterpreter::forRange(FlatIndex node) {
+	const View& ast = view;
+	const uint32_t* fields = ast.lists + ast.b[node]; // start, stop, step, body
+	Value start = Value::integer(0), step = Value::integer(1);
+	if (fields[0] != kNoNode) {
+		eval(fields[0]);
+		start = result;
+	}
+	eval(fields[1]);
+	Value stop = result;
+	if (fields[2] != kNoNode) {
+		eval(fields[2]);
+		step = result;
+	}
+	IntRange range = makeRange(start, stop, step);
+
+	FlatIndex var = ast.a[node];
+	bool local = ast.ops[var] == static_cast<uint8_t>(VarScope::Local);
+	for (; range.hasNext(); range.advance()) {
+		(local ? locals[ast.b[var]] : globals[ast.b[var]]) = Value::integer(range.next);
+		eval(fields[3]);
+		if (loopExits())
+			return;
+	}
+}
+
+void FlatInterpreter::forEach(FlatIndex node) {
+	const View& ast = view;
+	const uint32_t* fields = ast.lists + ast.b[node]; // iterable, body
+	eval(fields[0]);
+	Value iterable = std::move(result);
+
+	FlatIndex var = ast.a[node];
+	bool local = ast.ops[var] == static_cast<uint8_t>(VarScope::Local);
+	Value item;
+	for (size_t i = 0; iterationItem(iterable, i, item); i++) {
+		(local ? locals[ast.b[var]] : globals[ast.b[var]]) = std::move(item);
+		eval(fields[1]);
+		if (loopExits())
+			return;
+	}
+}
+
+void FlatInterpreter::setCode(const FlatAst* ast) {
+	code = ast;
+	if (!ast) {
+		view = {};
+		return;
+	}
+	view = { ast->kinds.data(), ast->ops.data(), ast->a.data(), ast->b.data(), ast->lists.data(), ast->numbers.data() };
+}
+
+void FlatInterpreter::undefinedVariable(FlatIndex node) const {
+	std::string_view name = code->name(node);
+	std::cerr << "Error: Variable '" << name << "' not defined." << std::endl;
+	throw std::runtime_error("Variable '" + std::string(name) + "' not defined");
+}
+
+void FlatInterpreter::define(FlatIndex node) {
+	std::string_view name = code->name(node);
+	if (definedFunctions.find(name) != definedFunctions.end())
+		throw std::runtime_error("Function '" + std::string(name) + "' already defined");
+	definedFunctions[name] = { code, node };
+}
+
+void FlatInterpreter::call(FlatIndex node) {
+	const FlatAst& ast = *code;
+	std::string_view name = ast.name(node);
+
+	// Arguments are evaluated straight into the callee's frame
+	const uint32_t* args = ast.list(ast.b[node]) + 1;
+	uint32_t argc = args[-1];
+	Value* frame = arena.push(argc);
+	for (uint32_t i = 0; i < argc; i++) {
+		eval(args[i]);
+		frame[i] = result;
+	}
+
+	auto builtin = builtins.find(name);
+	if (builtin != builtins.end()) {
+		std::vector<Value> args(frame, frame + argc);
+		arena.pop(frame);
+		activeBuiltin = &builtin->first;
+		result = builtin->second(args);
+		activeBuiltin = nullptr;
+		return;
+	}
+
+	auto defined = definedFunctions.find(name);
+	if (defined == definedFunctions.end())
+		throw std::runtime_error("Function '" + std::string(name) + "' not defined");
+
+	Function callee = defined->second;
+	const FlatFunction& function = callee.ast->function(callee.node);
+	if (argc != function.paramCount) {
+		throw std::runtime_error("Function '" + std::string(name) + "' expects " + std::to_string(function.paramCount) + " arguments, got " + std::to_string(argc));
+	}
+	if (frames.size() >= kMaxCallDepth) {
+		throw std::runtime_error("Maximum recursion depth exceeded");
+	}
+	// Parameters are the first locals, the rest start undefined
+	arena.grow(frame, function.localCount);
+	frames.push_back(callee);
+	Value* savedLocals = locals;
+	const FlatAst* savedCode = code;
+	locals = frame;
+	setCode(callee.ast);
+
+	eval(function.body);
+	if (completion == Completion::Return)
+		completion = Completion::Normal; // result holds the return value
+	else
+		result = Value(); // fell off the end: return None
+
+	setCode(savedCode);
+	locals = savedLocals;
+	frames.pop_back();
+	arena.pop(frame);
+}
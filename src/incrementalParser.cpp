@@ -0,0 +1,150 @@
+#include "incrementalParser.h"
+#include "parser.h"
+#include "statementReader.h"
+#include <algorithm>
+#include <stdexcept>
+
+
+IncrementalParser::IncrementalParser(std::string_view text) {
+	edit(0, 0, text);
+}
+
+std::string IncrementalParser::text() const {
+	std::string all;
+	all.reserve(size());
+	for (const Statement& statement : statements)
+		all += statement.text;
+	return all;
+}
+
+// Index of the statement containing `offset` (the last one at the end of the buffer)
+size_t IncrementalParser::statementAt(size_t offset) const {
+	auto it = std::upper_bound(begins.begin(), begins.end(), offset);
+	return it == begins.begin() ? 0 : static_cast<size_t>(it - begins.begin()) - 1;
+}
+
+IncrementalParser::Statement IncrementalParser::parse(std::string text) {
+	Statement statement{ std::move(text), Program{}, std::string{}, false };
+	try {
+		Lexer lexer(statement.text);
+		statement.tree = Parser(lexer).parse();
+	}
+	catch (const std::string& e) { // parse errors
+		statement.error = e;
+	}
+	catch (const char* e) { // lexer errors
+		statement.error = e;
+	}
+	return statement;
+}
+
+void IncrementalParser::edit(size_t offset, size_t removed, std::string_view inserted) {
+	size_t total = size();
+	if (offset > total || removed > total - offset)
+		throw std::out_of_range("IncrementalParser: edit outside the buffer");
+
+	// An edit can join its statement to the one before (an indented line
+	// inserted at its start, say), so re-splitting starts there
+	size_t first = statementAt(offset);
+	if (first > 0)
+		first--;
+	size_t next = statements.empty() ? 0 : statementAt(offset + removed) + 1;
+	size_t regionBegin = statements.empty() ? 0 : begins[first];
+	std::string region;
+	for (size_t i = first; i < next; i++)
+		region += statements[i].text;
+	region.replace(offset - regionBegin, removed, inserted);
+
+	// Split the region. Where it ends outside a string, after a statement,
+	// the next old statement still begins one and everything from there on
+	// is unchanged. Otherwise that statement is pulled into the region too.
+	std::vector<std::pair<size_t, size_t>> pieces;
+	while (true) {
+		pieces.clear();
+		StatementSplitter splitter;
+		size_t start = 0;
+		for (size_t pos = 0; pos < region.size();) {
+			size_t newline = region.find('\n', pos);
+			size_t lineEnd = newline == std::string::npos ? region.size() : newline + 1;
+			std::string_view line(region.data() + pos, lineEnd - pos);
+			if (splitter.endsStatement(line)) {
+				pieces.emplace_back(start, pos);
+				start = pos;
+				splitter.finishStatement();
+			}
+			splitter.add(line);
+			pos = lineEnd;
+		}
+		bool clean = splitter.hasStatement() && !splitter.inString();
+		if (clean || next == statements.size()) {
+			if (start < region.size())
+				pieces.emplace_back(start, region.size());
+			break;
+		}
+		region += statements[next++].text;
+	}
+
+	std::vector<Statement> fresh;
+	std::vector<size_t> freshBegins;
+	fresh.reserve(pieces.size());
+	for (const auto& piece : pieces) {
+		fresh.push_back(parse(region.substr(piece.first, piece.second - piece.first)));
+		freshBegins.push_back(regionBegin + piece.first);
+	}
+
+	for (size_t i = first; i < next; i++)
+		failed -= !statements[i].error.empty();
+	for (const Statement& statement : fresh)
+		failed += !statement.error.empty();
+	ptrdiff_t delta = static_cast<ptrdiff_t>(inserted.size()) - static_cast<ptrdiff_t>(removed);
+	for (size_t i = next; i < begins.size(); i++)
+		begins[i] += delta;
+	reparsed = fresh.size();
+	if (fresh.size() == next - first) { // the usual keystroke, nothing to shift around
+		std::move(fresh.begin(), fresh.end(), statements.begin() + first);
+		std::copy(freshBegins.begin(), freshBegins.end(), begins.begin() + first);
+		return;
+	}
+	statements.erase(statements.begin() + first, statements.begin() + next);
+	statements.insert(statements.begin() + first, std::make_move_iterator(fresh.begin()), std::make_move_iterator(fresh.end()));
+	begins.erase(begins.begin() + first, begins.begin() + next);
+	begins.insert(begins.begin() + first, freshBegins.begin(), freshBegins.end());
+}
+
+Program IncrementalParser::program(size_t first) const {
+	auto arena = std::make_shared<Arena>();
+	std::vector<ASTNodePtr> roots;
+	for (size_t i = first; i < statements.size(); i++) {
+		const Program& tree = statements[i].tree;
+		if (!tree.root)
+			continue;
+		for (ASTNodePtr stmt : static_cast<BlockNode&>(*tree.root).statements)
+			roots.push_back(stmt);
+		arena->adopt(tree.arena);
+	}
+	ASTNodePtr root = arena->make<BlockNode>(arena->copy(roots));
+	return Program{ arena, root };
+}
+
+OptimizerStats IncrementalParser::optimize(size_t first) {
+	OptimizerStats total;
+	Optimizer optimizer;
+	for (size_t i = first; i < statements.size(); i++) {
+		Statement& statement = statements[i];
+		if (!statement.tree.root || statement.optimized)
+			continue;
+		optimizer.optimize(statement.tree);
+		statement.optimized = true;
+		total += optimizer.stats();
+	}
+	return total;
+}
+
+std::string IncrementalParser::error(size_t first) const {
+	if (failed == 0)
+		return {};
+	for (size_t i = first; i < statements.size(); i++)
+		if (!statements[i].error.empty())
+			return statements[i].error;
+	return {};
+}
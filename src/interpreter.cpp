@@ -1,13 +1,19 @@
 #include "interpreter.h"
 #include "builtInFunctions.h"
+#include "dict.h"
+#include "list.h"
+#include "operators.h"
+#include "optimizer.h"
+#include "parser.h"
 #include <string>
 
 
 void Interpreter::printVariables() const {
 	std::cout << "------------------\n";
     std::cout << "Current Variables:\n";
-    for (const auto& [name, value] : variables) {
-        std::cout << "  " << name << " = " << value.toString() << "\n";
+    for (size_t i = 0; i < globalScope.names.size(); i++) {
+        if (i < globals.size() && !globals[i].isUndefined())
+            std::cout << "  " << globalScope.names[i] << " = " << globals[i].toString() << "\n";
     }
     std::cout << "------------------\n";
 }
@@ -17,12 +23,33 @@ void Interpreter::registetrBuiltins() {
 	builtins["println"] = printlnFunc;
 	builtins["max"] = maxFunc;
 	builtins["min"] = minFunc;
+	builtins["len"] = lenFunc;
+	builtins["append"] = appendFunc;
+	builtins["sum"] = sumFunc;
+}
+
+
+std::vector<std::string> Interpreter::backtrace() const {
+    std::vector<std::string> names;
+    for (const auto& frame : frames)
+        names.emplace_back(frame.function->funcName);
+    if (activeBuiltin)
+        names.emplace_back(*activeBuiltin);
+    return names;
 }
 
 
 Value Interpreter::interpret() {
-    if (tree) {
-        tree->accept(*this);
+    if (program.root) {
+        Resolver(globalScope, *program.arena).resolve(*program.root);
+        globals.resize(globalScope.names.size(), Value::undefined()); // the REPL may add names
+        // Drop whatever an earlier failed run left behind
+        locals = nullptr;
+        frames.clear();
+        arena.reset();
+        activeBuiltin = nullptr;
+        completion = Completion::Normal;
+        program.root->accept(*this);
     }
     else {
         throw std::runtime_error("No AST to interpret");
@@ -31,151 +58,117 @@ Value Interpreter::interpret() {
 }
 
 
-void Interpreter::visit(const NumberNode& node) {
-	result = Value(std::stod(node.value));
+void Interpreter::visit(NumberNode& node) {
+	result = node.literal();
 }
 
-void Interpreter::visit(const BinaryOpNode& node) {
+void Interpreter::visit(BinaryOpNode& node) {
     node.left->accept(*this);
-    Value lresult = result;
+    if (node.op == BinaryOp::And || node.op == BinaryOp::Or) {
+        if (!shortCircuits(node.op, result))
+            node.right->accept(*this);
+        return; // result holds the deciding operand
+    }
+    Value lresult = std::move(result);
     node.right->accept(*this);
-    Value rresult = result;
-
-    if (node.op == "+") {
-		if (lresult.isString() && rresult.isString()) { // string concatenation
-            result = Value(lresult.asString() + rresult.asString());
-            return;
-		}
+    result = applyBinary(node.op, lresult, result);
+}
 
-        result = Value(lresult.asNumber() + rresult.asNumber());
-    }
-    else if (node.op == "-") {
-        result = Value(lresult.asNumber() - rresult.asNumber());
-    }
-    else if (node.op == "*") {
-		if (lresult.isString() && rresult.isNumber()) { // string repetition
-            int times = static_cast<int>(rresult.asNumber());
-            if (times < 0) times = 0;
-            std::string repeated;
-            for (int i = 0; i < times; ++i) {
-                repeated += lresult.asString();
-            }
-            result = Value(repeated);
+void Interpreter::visit(ComparisonChainNode& node) {
+    node.operands[0]->accept(*this);
+    Value left = std::move(result);
+    for (size_t i = 0; i < node.ops.size(); i++) {
+        node.operands[i + 1]->accept(*this);
+        Value right = std::move(result);
+        result = applyBinary(node.ops[i], left, right);
+        if (!result.isTruthy())
             return;
-        }
-		else if (lresult.isNumber() && rresult.isString()) { // string repetition
-            int times = static_cast<int>(lresult.asNumber());
-            if (times < 0) times = 0; // prevent negative repetitions
-            std::string repeated;
-            for (int i = 0; i < times; ++i) {
-                repeated += rresult.asString();
-            }
-            result = Value(repeated);
-            return;
-		}
-
-        result = Value(lresult.asNumber() * rresult.asNumber());
-    }
-    else if (node.op == "/") {
-        result = Value(lresult.asNumber() / rresult.asNumber());
-    }
-
-    else if (node.op == "==") {
-        if (!(lresult.isString() || rresult.isString()))
-			result = Value(lresult.asNumber() == rresult.asNumber());
-        else if (lresult.isString() && rresult.isString())
-            result = Value(lresult.asString() == rresult.asString());
-        else
-            throw std::runtime_error("Type error in '==': cannot compare " + lresult.typeName() + " and " + rresult.typeName());
-    }
-    else if (node.op == "!=") {
-        if (!(lresult.isString() || rresult.isString()))
-            result = Value(lresult.asNumber() != rresult.asNumber());
-        else if (lresult.isString() && rresult.isString())
-            result = Value(lresult.asString() != rresult.asString());
-        else
-            throw std::runtime_error("Type error in '!=': cannot compare " + lresult.typeName() + " and " + rresult.typeName());
+        left = std::move(right);
     }
-    else if (node.op == "<") {
-        if (!(lresult.isString() || rresult.isString()))
-            result = Value(lresult.asNumber() < rresult.asNumber());
-        else
-            throw std::runtime_error("Type error in '<': cannot compare " + lresult.typeName() + " and " + rresult.typeName());
-    }
-    else if (node.op == "<=") {
-        if (!(lresult.isString() || rresult.isString()))
-            result = Value(lresult.asNumber() <= rresult.asNumber());
-        else
-            throw std::runtime_error("Type error in '<=': cannot compare " + lresult.typeName() + " and " + rresult.typeName());
-    }
-    else if (node.op == ">") {
-        if (!(lresult.isString() || rresult.isString()))
-            result = Value(lresult.asNumber() > rresult.asNumber());
-        else
-            throw std::runtime_error("Type error in '>': cannot compare " + lresult.typeName() + " and " + rresult.typeName());
-    }
-    else if (node.op == ">=") {
-        if (!(lresult.isString() || rresult.isString()))
-            result = Value(lresult.asNumber() >= rresult.asNumber());
-        else
-            throw std::runtime_error("Type error in '>=': cannot compare " + lresult.typeName() + " and " + rresult.typeName());
-    }
-    else if (node.op == "and") {
-        result = Value(lresult.isTruthy() && rresult.isTruthy());
-    }
-    else if (node.op == "or") {
-        result = Value(lresult.isTruthy() || rresult.isTruthy());
-	}
-    else if (node.op == "%") {
-        result = Value(static_cast<double>(static_cast<int>(lresult.asNumber()) % static_cast<int>(rresult.asNumber())));
-	}
-    else {
-        throw std::runtime_error("Unknown binary operator: " + node.op);
-	}
 }
 
-void Interpreter::visit(const UnaryOpNode& node) {
+void Interpreter::visit(UnaryOpNode& node) {
 	node.factor->accept(*this);
-    if (node.op == "+")
-        ;// unary plus, do nothing
-	else if (node.op == "-")
-		result = Value(- result.asNumber());
-	else if (node.op == "not")
-        result = Value(! result.isTruthy());
+    result = applyUnary(node.op, result);
 }
 
 
-void Interpreter::visit(const VarNode& node) {
-    if (variables.find(node.toString()) == variables.end()) {
-		std::cerr << "Error: Variable '" << node.toString() << "' not defined." << std::endl;
-        throw std::runtime_error("Variable '" + node.toString() + "' not defined");
+void Interpreter::visit(VarNode& node) {
+    const Value& value = node.scope == VarScope::Local ? locals[node.slot] : globals[node.slot];
+    if (value.isUndefined()) {
+		std::cerr << "Error: Variable '" << node.name << "' not defined." << std::endl;
+        throw std::runtime_error("Variable '" + std::string(node.name) + "' not defined");
 	}
-	result = variables[node.toString()];
+	result = value;
 }
 
-void Interpreter::visit(const AssignmentNode& node) {
+void Interpreter::visit(AssignmentNode& node) {
     node.value->accept(*this);
-	variables[node.varNode->toString()] = result;
+    auto& var = static_cast<VarNode&>(*node.varNode);
+    if (var.scope == VarScope::Local)
+        locals[var.slot] = result;
+    else
+        globals[var.slot] = result;
 }
 
-void Interpreter::visit(const BooleanNode& node) {
-	if (node.value == "True")
-		result = Value(true);
-	else
-        result = Value(false);
+void Interpreter::visit(BooleanNode& node) {
+	result = Value(node.value);
 }
 
-void Interpreter::visit(const StringNode& node) {
+void Interpreter::visit(StringNode& node) {
     result = Value(node.value);
 }
 
-void Interpreter::visit(const BlockNode& node) {
+void Interpreter::visit(ListNode& node) {
+    // Elements are evaluated into the frame arena, like call arguments
+    size_t count = node.elements.size();
+    Value* items = arena.push(count);
+    for (size_t i = 0; i < count; ++i) {
+        node.elements[i]->accept(*this);
+        items[i] = result;
+    }
+    result = makeList(items, count);
+    arena.pop(items);
+}
+
+void Interpreter::visit(DictNode& node) {
+    size_t count = node.items.size();
+    Value* items = arena.push(count);
+    for (size_t i = 0; i < count; ++i) {
+        node.items[i]->accept(*this);
+        items[i] = result;
+    }
+    result = makeDict(items, count / 2);
+    arena.pop(items);
+}
+
+void Interpreter::visit(IndexNode& node) {
+    node.container->accept(*this);
+    Value container = std::move(result);
+    node.index->accept(*this);
+    result = indexValue(container, result);
+}
+
+void Interpreter::visit(IndexAssignmentNode& node) {
+    node.value->accept(*this);
+    Value value = std::move(result);
+    auto& target = static_cast<IndexNode&>(*node.target);
+    target.container->accept(*this);
+    Value container = std::move(result);
+    target.index->accept(*this);
+    storeIndex(container, result, value);
+    result = std::move(value);
+}
+
+void Interpreter::visit(BlockNode& node) {
     for (const auto& stmt : node.statements) {
         stmt->accept(*this);
+        if (completion != Completion::Normal)
+            return;
     }
 }
 
-void Interpreter::visit(const IfNode& node) {
+void Interpreter::visit(IfNode& node) {
     node.condition->accept(*this);
     Value cond = result;
     if (cond.isTruthy()) {
@@ -187,61 +180,127 @@ void Interpreter::visit(const IfNode& node) {
 	}
 }
 
-void Interpreter::visit(const WhileNode& node) {
+// After a loop body: whether the loop ends here. A break or continue is
+// handled by the loop, a return passes on to the function.
+bool Interpreter::loopExits() {
+    if (completion == Completion::Normal)
+        return false;
+    if (completion == Completion::Return)
+        return true;
+    bool exits = completion == Completion::Break;
+    completion = Completion::Normal;
+    return exits;
+}
+
+void Interpreter::visit(WhileNode& node) {
     node.condition->accept(*this);
     Value cond = result;
     while (cond.isTruthy()) {
         node.body->accept(*this);
+        if (loopExits())
+            return;
 
         node.condition->accept(*this);
         cond = result;
     }
 }
 
-void Interpreter::visit(const FunctionCallNode& node) {
-	std::string funcName = node.funcName;
-    callStack.push_back(funcName);
-	std::vector<Value> args;
-    for (const auto& argNode : node.arguments) {
-        argNode->accept(*this);
-        args.push_back(result);
+void Interpreter::visit(ForRangeNode& node) {
+    Value start = Value::integer(0), step = Value::integer(1);
+    if (node.start) {
+        node.start->accept(*this);
+        start = result;
+    }
+    node.stop->accept(*this);
+    Value stop = result;
+    if (node.step) {
+        node.step->accept(*this);
+        step = result;
+    }
+    IntRange range = makeRange(start, stop, step);
+
+    auto& var = static_cast<VarNode&>(*node.varNode);
+    for (; range.hasNext(); range.advance()) {
+        // globals may grow while the body runs, so no pointer to the slot is kept
+        (var.scope == VarScope::Local ? locals[var.slot] : globals[var.slot]) = Value::integer(range.next);
+        node.body->accept(*this);
+        if (loopExits())
+            return;
+    }
+}
+
+void Interpreter::visit(ForEachNode& node) {
+    node.iterable->accept(*this);
+    Value iterable = std::move(result);
+    auto& var = static_cast<VarNode&>(*node.varNode);
+    Value item;
+    for (size_t i = 0; iterationItem(iterable, i, item); i++) {
+        (var.scope == VarScope::Local ? locals[var.slot] : globals[var.slot]) = std::move(item);
+        node.body->accept(*this);
+        if (loopExits())
+            return;
+    }
+}
+
+void Interpreter::visit(BreakNode&) {
+    completion = Completion::Break;
+}
+
+void Interpreter::visit(ContinueNode&) {
+    completion = Completion::Continue;
+}
+
+void Interpreter::visit(FunctionCallNode& node) {
+	// Arguments are evaluated straight into the callee's frame; calls made
+	// while evaluating them release their own frames before we continue
+	size_t argc = node.arguments.size();
+	Value* frame = arena.push(argc);
+    for (size_t i = 0; i < argc; ++i) {
+        node.arguments[i]->accept(*this);
+        frame[i] = result;
 	}
 
 	// Handle built-in functions
-    if(builtins.find(funcName) != builtins.end()) {
-        result = builtins[funcName](args);
-		callStack.pop_back();
+    auto builtin = builtins.find(node.funcName);
+    if (builtin != builtins.end()) {
+        std::vector<Value> args(frame, frame + argc);
+        arena.pop(frame);
+        activeBuiltin = &builtin->first;
+        result = builtin->second(args);
+        activeBuiltin = nullptr;
         return;
 	}
     
 	// Handle user-defined functions
-    if (definedFunctions.find(funcName) != definedFunctions.end()) {
-        auto funcDef = definedFunctions[funcName].get();
-        if (args.size() != funcDef->parameters.size()) {
-            throw std::runtime_error("Function '" + funcName + "' expects " + std::to_string(funcDef->parameters.size()) + " arguments, got " + std::to_string(args.size()));
+    auto defined = definedFunctions.find(node.funcName);
+    if (defined != definedFunctions.end()) {
+        if (!defined->second->body)
+            defined->second = parseLazy(*defined->second);
+        const FunctionDefNode* funcDef = defined->second;
+        if (argc != funcDef->parameters.size()) {
+            throw std::runtime_error("Function '" + std::string(node.funcName) + "' expects " + std::to_string(funcDef->parameters.size()) + " arguments, got " + std::to_string(argc));
         }
-        // Save current variables to restore later (simple scope handling)
-        auto savedVariables = variables;
-        // Set function parameters
-        for (size_t i = 0; i < args.size(); ++i) {
-            variables[funcDef->parameters[i]] = args[i];
+        if (frames.size() >= kMaxCallDepth) {
+            throw std::runtime_error("Maximum recursion depth exceeded");
         }
+        // Parameters are the first locals, the rest start undefined
+        arena.grow(frame, funcDef->localNames.size());
+        frames.push_back({ funcDef, frame });
+        Value* savedLocals = locals;
+        locals = frame;
         // Execute function body
-        try {
-            funcDef->body->accept(*this);
-        }
-        catch (const Value& returnValue) {
-            result = returnValue; // Capture return value
-        }
-        // Restore previous variables
-		variables = savedVariables;
-        // Restore previous variables
-        variables = savedVariables;
-		callStack.pop_back();
+        funcDef->body->accept(*this);
+        if (completion == Completion::Return)
+            completion = Completion::Normal; // result holds the return value
+        else
+            result = Value(); // fell off the end: return None
+        locals = savedLocals;
+        frames.pop_back();
+        arena.pop(frame);
 		return;
     }
     
-	throw std::runtime_error("Function '" + funcName + "' not defined");
+	throw std::runtime_error("Function '" + std::string(node.funcName) + "' not defined");
 
 }
 
@@ -249,21 +308,32 @@ void Interpreter::visit(FunctionDefNode& node) {
 
 	// check if function already defined
 	if (definedFunctions.find(node.funcName) != definedFunctions.end()) {
-		throw std::runtime_error("Function '" + node.funcName + "' already defined");
+		throw std::runtime_error("Function '" + std::string(node.funcName) + "' already defined");
 	}
 
-    definedFunctions[node.funcName] = std::make_unique<FunctionDefNode>(
-        node.funcName,
-        node.parameters,
-        std::move(node.body)
-    );
-    
+    definedFunctions[node.funcName] = &node;
+    // The REPL drops each line's program once it ran, but not the functions it defined
+    if (definitionArenas.empty() || definitionArenas.back() != program.arena)
+        definitionArenas.push_back(program.arena);
+}
+
+// First call of a function parsed lazily: parse and resolve its body. The
+// result replaces the stub, so this happens once per function.
+const FunctionDefNode* Interpreter::parseLazy(const FunctionDefNode& stub) {
+    Lexer lexer(stub.source);
+    Program parsed = Parser(lexer, true).parseFunction();
+    if (optimizeLazyBodies)
+        Optimizer().optimize(parsed);
+    Resolver(globalScope, *parsed.arena).resolve(*parsed.root);
+    globals.resize(globalScope.names.size(), Value::undefined());
+    definitionArenas.push_back(parsed.arena);
+    return static_cast<const FunctionDefNode*>(parsed.root);
 }
 
 void Interpreter::visit(ReturnNode& node) {
-    if (node.value != nullptr) {
+    if (node.value != nullptr)
         node.value->accept(*this);
-        throw result;
-    }
-	throw Value(); // return None
+    else
+        result = Value(); // return None
+    completion = Completion::Return;
 }
@@ -1,10 +1,105 @@
 #include "lexer.h"
-#include <cctype>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
 
 #include <iostream>
 
+namespace {
+
+struct Keyword {
+	std::string_view text;
+	TokenType type;
+};
+
+// The keywords of Grammar/Tokens. Adding one here is all the lexer needs,
+// the hash below is recomputed by the compiler.
+constexpr Keyword kKeywords[] = {
+	{ "True", TokenType::BOOLEAN },
+	{ "False", TokenType::BOOLEAN },
+	{ "if", TokenType::IF },
+	{ "else", TokenType::ELSE },
+	{ "elif", TokenType::ELIF },
+	{ "while", TokenType::WHILE },
+	{ "def", TokenType::DEF },
+	{ "return", TokenType::RETURN },
+	{ "for", TokenType::FOR },
+	{ "in", TokenType::IN },
+	{ "break", TokenType::BREAK },
+	{ "continue", TokenType::CONTINUE },
+	{ "and", TokenType::AND },
+	{ "or", TokenType::OR },
+	{ "not", TokenType::NOT },
+};
+
+constexpr uint32_t kSlotBits = 5;
+constexpr uint8_t kNoKeyword = 0xFF;
+static_assert(std::size(kKeywords) < (1u << kSlotBits) / 2, "keyword table too full, raise kSlotBits");
+
+// Multiplicative hash of first char, last char and length. The multiplier
+// is searched at compile time so that every keyword gets its own slot.
+constexpr uint32_t keywordHash(std::string_view s, uint32_t seed) {
+	uint32_t key = static_cast<unsigned char>(s.front()) |
+		static_cast<uint32_t>(static_cast<unsigned char>(s.back())) << 8 |
+		static_cast<uint32_t>(s.size()) << 16;
+	return (key * seed) >> (32 - kSlotBits);
+}
+
+constexpr bool isPerfectSeed(uint32_t seed) {
+	bool used[1u << kSlotBits] = {};
+	for (const Keyword& keyword : kKeywords) {
+		uint32_t slot = keywordHash(keyword.text, seed);
+		if (used[slot])
+			return false;
+		used[slot] = true;
+	}
+	return true;
+}
+
+constexpr uint32_t findSeed() {
+	for (uint32_t seed = 0x9E3779B1u, tries = 0; tries < 100000; seed += 2, tries++)
+		if (isPerfectSeed(seed))
+			return seed;
+	return 0;
+}
+
+constexpr uint32_t kSeed = findSeed();
+static_assert(kSeed != 0, "no perfect keyword hash found, raise kSlotBits");
+
+constexpr auto kSlots = [] {
+	std::array<uint8_t, 1u << kSlotBits> slots{};
+	for (auto& slot : slots)
+		slot = kNoKeyword;
+	for (size_t i = 0; i < std::size(kKeywords); i++)
+		slots[keywordHash(kKeywords[i].text, kSeed)] = static_cast<uint8_t>(i);
+	return slots;
+}();
+
+constexpr auto kKeywordLengths = [] {
+	std::pair<size_t, size_t> range{ SIZE_MAX, 0 };
+	for (const Keyword& keyword : kKeywords) {
+		range.first = keyword.text.size() < range.first ? keyword.text.size() : range.first;
+		range.second = keyword.text.size() > range.second ? keyword.text.size() : range.second;
+	}
+	return range;
+}();
+
+// One hash and at most one comparison
+TokenType keywordOrName(std::string_view id) {
+	if (id.size() < kKeywordLengths.first || id.size() > kKeywordLengths.second)
+		return TokenType::NAME;
+	uint8_t keyword = kSlots[keywordHash(id, kSeed)];
+	if (keyword != kNoKeyword && kKeywords[keyword].text == id)
+		return kKeywords[keyword].type;
+	return TokenType::NAME;
+}
+
+}
+
 // TODO: add current line and col for better errors
-Lexer::Lexer(const std::string& text) : text(text), pos(0), lastWasNewline(false), pendingDedents(0) {
+Lexer::Lexer(std::string_view text, const CharScanner& scanner) : text(text), scanner(scanner), pos(0), lastWasNewline(false), pendingDedents(0) {
 	currentChar = text.empty() ? '\0' : text[pos];
 }
 
@@ -13,42 +108,37 @@ void Lexer::advance() {
 	currentChar = (pos < text.size()) ? text[pos] : '\0';
 }
 
+void Lexer::skipTo(const char* p) {
+	pos = p - text.data();
+	currentChar = (pos < text.size()) ? text[pos] : '\0';
+}
+
 void Lexer::skipWhitespace() {
-	while (currentChar != '\0' && currentChar == ' ')
-		advance();
+	if (currentChar == ' ')
+		skipTo(scanner.spacesEnd(cursor(), end()));
+	else
+		advance(); // tab, carriage return, ...
 }
 
-std::string Lexer::number() {
+// Tokens are spans of the source, scanned in place
+std::string_view Lexer::number() {
 	// TODO: handle 123abc cases and maybe hex, binary, etc.
-	std::string result;
-	while (currentChar != '\0' && isdigit(currentChar)) {
-		result += currentChar;
-		advance();
-		if (currentChar == '.') {
-			result += currentChar;
-			advance();
-			break;
-		}
-	}
-	while (currentChar != '\0' && isdigit(currentChar)) {
-		result += currentChar;
+	size_t start = pos;
+	skipTo(scanner.digitsEnd(cursor(), end()));
+	if (currentChar == '.') {
 		advance();
+		skipTo(scanner.digitsEnd(cursor(), end()));
 	}
-	if (result.back() == '.') // 123. => 123.0
-		result += '0';
-	return result;
+	return text.substr(start, pos - start); // "123." reads as 123.0
 }
 
-std::string Lexer::identifier() {
-	std::string result;
-	while (currentChar != '\0' && (isalnum(currentChar) || currentChar == '_')) {
-		result += currentChar;
-		advance();
-	}
-	return result;
+std::string_view Lexer::identifier() {
+	size_t start = pos;
+	skipTo(scanner.identifierEnd(cursor(), end()));
+	return text.substr(start, pos - start);
 }
 
-Token Lexer::getNextToken() {
+Token Lexer::scan() {
 
 	while (currentChar != '\0') {
 
@@ -61,14 +151,13 @@ Token Lexer::getNextToken() {
 		if (lastWasNewline) { 
 			lastWasNewline = false;
 			// Count spaces at start of new line
-			int spaceCount = 0;
-			while (currentChar == ' ') {
-				spaceCount++;
-				advance();
-			}
-			// ignore multiple consecutive newlines
-			if (currentChar == '\n') {
-				advance(); 
+			const char* lineStart = cursor();
+			skipTo(scanner.spacesEnd(lineStart, end()));
+			int spaceCount = static_cast<int>(cursor() - lineStart);
+			// ignore multiple consecutive newlines (and trailing spaces at the end)
+			if (currentChar == '\n' || currentChar == '\0') {
+				if (currentChar == '\n')
+					advance();
 				lastWasNewline = true;
 				continue;
 			}
@@ -95,7 +184,7 @@ Token Lexer::getNextToken() {
 
 		if (currentChar == '\n') { advance(); lastWasNewline = true; return { TokenType::NEWLINE, "" }; }
 
-		if (isspace(currentChar)) {
+		if (currentChar == ' ' || currentChar == '\t' || currentChar == '\r' || currentChar == '\v' || currentChar == '\f') {
 			skipWhitespace();
 			continue;
 		}
@@ -103,12 +192,10 @@ Token Lexer::getNextToken() {
 		// TODO: add single quote strings and escape sequences 
 		if (currentChar == '\"') {
 			advance(); // skip opening quote
-			std::string strVal;
-			while (currentChar != '\0' && currentChar != '\"') {
-				strVal += currentChar;
-				advance();
-			}
+			size_t start = pos;
+			skipTo(scanner.stringEnd(cursor(), end()));
 			if (currentChar == '\"') {
+				std::string_view strVal = text.substr(start, pos - start);
 				advance(); // skip closing quote
 				return { TokenType::STRING, strVal };
 			} else {
@@ -117,32 +204,43 @@ Token Lexer::getNextToken() {
 		}
 
 		// Identifiers and keywords
-		if (std::isalpha(currentChar) || currentChar == '_') {
-			std::string id = identifier();
-			// Check for keywords
-			if (id == "True") return { TokenType::BOOLEAN, id };
-			if (id == "False") return { TokenType::BOOLEAN, id };
-			if (id == "if") return { TokenType::IF, id };
-			if (id == "else") return { TokenType::ELSE, id };
-			if (id == "elif") return { TokenType::ELIF, id };
-			if (id == "while") return { TokenType::WHILE, id };
-			if (id == "not") return { TokenType::NOT, id };
-			if (id == "and") return { TokenType::AND, id };
-			if (id == "or") return { TokenType::OR, id };
-			if (id == "def") return { TokenType::DEF, id };
-			if (id == "return") return { TokenType::RETURN, id };
-			// Return Name
-			return { TokenType::NAME, id };
+		if (isIdentifierStart(currentChar)) {
+			std::string_view id = identifier();
+			return { keywordOrName(id), id };
 		}
 
-		if (isdigit(currentChar)) return { TokenType::NUMBER, number() };
+		if (isDigitChar(currentChar)) {
+			// Parse the literal once here so nothing downstream has to
+			Token token{ TokenType::NUMBER, number() };
+			const char* first = token.value.data();
+			const char* last = first + token.value.size();
+			if (token.value.find('.') != std::string_view::npos) {
+				std::from_chars(first, last, token.number);
+			}
+			else if (std::from_chars(first, last, token.integer).ec == std::errc()) {
+				token.numberKind = NumberKind::Int;
+			}
+			else {
+				token.numberKind = NumberKind::BigInt; // out of range, kept as digits
+			}
+			return token;
+		}
 
 		if (currentChar == '+') { advance(); return { TokenType::PLUS, "+" }; }
 		if (currentChar == '-') { advance(); return { TokenType::MINUS, "-" }; }
 		if (currentChar == '*') { advance(); return { TokenType::MUL, "*" }; }
-		if (currentChar == '/') { advance(); return { TokenType::DIV, "/" }; }
+		if (currentChar == '/') {
+			advance();
+			if (currentChar == '/') { advance(); return { TokenType::DOUBLESLASH, "//" }; }
+			return { TokenType::DIV, "/" };
+		}
 		if (currentChar == '(') { advance(); return { TokenType::LPAR, "(" }; }
 		if (currentChar == ')') { advance(); return { TokenType::RPAR, ")" }; }
+		if (currentChar == '[') { advance(); return { TokenType::LSQB, "[" }; }
+		if (currentChar == ']') { advance(); return { TokenType::RSQB, "]" }; }
+		if (currentChar == '.') { advance(); return { TokenType::DOT, "." }; }
+		if (currentChar == '{') { advance(); return { TokenType::LBRACE, "{" }; }
+		if (currentChar == '}') { advance(); return { TokenType::RBRACE, "}" }; }
 		if (currentChar == ':') { advance(); return { TokenType::COLON, ":" }; }
 		if (currentChar == ',') { advance(); return { TokenType::COMMA, "," }; }
 		if (currentChar == '%') { advance(); return { TokenType::PERCENT, "%" }; }
@@ -169,8 +267,12 @@ Token Lexer::getNextToken() {
 			throw "Error: Unexpected character '!'";
 		}
 		// Add more token types as needed
-		std::cerr << "Error: Unexpected character '" << currentChar + "'" << std::endl;
-		throw 1;
+		throw "Error: Unexpected character '" + std::string(1, currentChar) + "'";
+	}
+	// A last line without '\n' still ends its statement
+	if (!lastWasNewline && !text.empty()) {
+		lastWasNewline = true;
+		return { TokenType::NEWLINE, "" };
 	}
 	// Handle any remaining dedents at EOF
 	if (indentStack.size() > 1) {
@@ -180,19 +282,53 @@ Token Lexer::getNextToken() {
 	return { TokenType::EOF_TOKEN, "" };
 }
 
-Token Lexer::peekNextToken() {
-	// Save state
-	size_t savedPos = pos;
-	char savedChar = currentChar;
-	std::vector<int> savedIndentStack = indentStack;
-	int savedPendingDedents = pendingDedents;
-	bool savedLastWasNewline = lastWasNewline;
-	Token nextToken = getNextToken();
-	// Restore state
-	pos = savedPos;
-	currentChar = savedChar;
-	indentStack = savedIndentStack;
-	pendingDedents = savedPendingDedents;
-	lastWasNewline = savedLastWasNewline;
-	return nextToken;
-}
\ No newline at end of file
+bool Lexer::skipBlock(size_t& blockEnd) {
+	if (!lastWasNewline || pendingDedents > 0 || lookaheadCount > 0)
+		return false;
+	const ptrdiff_t indent = indentStack.back() * 4;
+	const char* p = cursor();
+	const char* last = nullptr; // end of the last line in the block
+	bool inString = false;
+	while (p < end()) {
+		const char* lineStart = p;
+		const char* content = scanner.spacesEnd(lineStart, end());
+		const char* lineEnd = static_cast<const char*>(std::memchr(content, '\n', end() - content));
+		if (!lineEnd)
+			lineEnd = end();
+		p = lineEnd < end() ? lineEnd + 1 : lineEnd;
+		if (!inString) {
+			if (content == lineEnd)
+				continue; // blank lines belong to whatever follows
+			if (content - lineStart <= indent)
+				break;
+		}
+		if (std::count(content, lineEnd, '\"') % 2)
+			inString = !inString;
+		last = p;
+	}
+	if (!last)
+		return false;
+	blockEnd = last - text.data();
+	skipTo(last);
+	lastWasNewline = true;
+	return true;
+}
+
+Token Lexer::getNextToken() {
+	if (lookaheadCount == 0)
+		return scan();
+	Token token = lookahead[lookaheadHead];
+	lookaheadHead = (lookaheadHead + 1) % kMaxLookahead;
+	lookaheadCount--;
+	return token;
+}
+
+const Token& Lexer::peekNextToken(size_t k) {
+	if (k == 0 || k > kMaxLookahead)
+		throw "Error: lookahead of " + std::to_string(k) + " tokens is not supported";
+	while (lookaheadCount < k) {
+		lookahead[(lookaheadHead + lookaheadCount) % kMaxLookahead] = scan();
+		lookaheadCount++;
+	}
+	return lookahead[(lookaheadHead + k - 1) % kMaxLookahead];
+}
@@ -0,0 +1,188 @@
+#include "list.h"
+#include "listKernels.h"
+#include "operators.h"
+#include <algorithm>
+#include <stdexcept>
+
+
+size_t ListObject::size() const {
+	switch (mode) {
+		case Storage::Ints: return intItems.size();
+		case Storage::Doubles: return doubleItems.size();
+		default: return boxedItems.size();
+	}
+}
+
+void ListObject::reserve(size_t count) {
+	switch (mode) {
+		case Storage::Ints: intItems.reserve(count); break;
+		case Storage::Doubles: doubleItems.reserve(count); break;
+		default: boxedItems.reserve(count); break;
+	}
+}
+
+Value ListObject::get(size_t index) const {
+	switch (mode) {
+		case Storage::Ints: return Value::integer(intItems[index]);
+		case Storage::Doubles: return Value(doubleItems[index]);
+		default: return boxedItems[index];
+	}
+}
+
+// Make the storage able to hold `value`: an empty list takes the storage the
+// value needs, a list with elements is boxed when the value does not fit
+void ListObject::admit(const Value& value) {
+	if (mode == Storage::Boxed)
+		return;
+	int64_t integer;
+	Storage needed = value.isDouble() ? Storage::Doubles :
+		(value.isInteger() && value.toInt64(integer)) ? Storage::Ints : Storage::Boxed;
+	if (needed == mode)
+		return;
+	if (size() == 0)
+		mode = needed;
+	else
+		box();
+}
+
+void ListObject::box() {
+	std::vector<Value> items;
+	items.reserve(size());
+	for (size_t i = 0; i < size(); i++)
+		items.push_back(get(i));
+	std::vector<int64_t>().swap(intItems);
+	std::vector<double>().swap(doubleItems);
+	boxedItems = std::move(items);
+	mode = Storage::Boxed;
+}
+
+void ListObject::set(size_t index, const Value& value) {
+	admit(value);
+	switch (mode) {
+		case Storage::Ints: value.toInt64(intItems[index]); break;
+		case Storage::Doubles: doubleItems[index] = value.asDouble(); break;
+		default: boxedItems[index] = value; break;
+	}
+}
+
+void ListObject::append(const Value& value) {
+	admit(value);
+	switch (mode) {
+		case Storage::Ints: {
+			int64_t integer;
+			value.toInt64(integer);
+			intItems.push_back(integer);
+			break;
+		}
+		case Storage::Doubles: doubleItems.push_back(value.asDouble()); break;
+		default: boxedItems.push_back(value); break;
+	}
+}
+
+// Arrays of the same storage are copied as they are
+void ListObject::extend(const ListObject& other) {
+	size_t count = other.size(); // before growing, `other` may be this list
+	if (count == 0)
+		return;
+	if (size() == 0 && mode != Storage::Boxed)
+		mode = other.mode;
+	if (mode == other.mode && mode != Storage::Boxed) {
+		if (mode == Storage::Ints) {
+			size_t used = intItems.size();
+			intItems.resize(used + count);
+			std::copy_n(other.intItems.data(), count, intItems.data() + used);
+		}
+		else {
+			size_t used = doubleItems.size();
+			doubleItems.resize(used + count);
+			std::copy_n(other.doubleItems.data(), count, doubleItems.data() + used);
+		}
+		return;
+	}
+	reserve(size() + count);
+	for (size_t i = 0; i < count; i++)
+		append(other.get(i));
+}
+
+size_t ListObject::checkedIndex(int64_t index) const {
+	int64_t count = static_cast<int64_t>(size());
+	if (index < 0)
+		index += count;
+	if (index < 0 || index >= count)
+		throw std::runtime_error("list index out of range");
+	return static_cast<size_t>(index);
+}
+
+std::string ListObject::repr() const {
+	// A list inside itself prints as [...]
+	thread_local std::vector<const ListObject*> printing;
+	if (std::find(printing.begin(), printing.end(), this) != printing.end())
+		return "[...]";
+	printing.push_back(this);
+	std::string out = "[";
+	try {
+		for (size_t i = 0; i < size(); i++) {
+			if (i)
+				out += ", ";
+			out += get(i).repr();
+		}
+	}
+	catch (...) {
+		printing.pop_back();
+		throw;
+	}
+	printing.pop_back();
+	return out + "]";
+}
+
+
+Value makeList(const Value* items, size_t count) {
+	ListObject* list = new ListObject();
+	Value result(list);
+	list->reserve(count);
+	for (size_t i = 0; i < count; i++)
+		list->append(items[i]);
+	return result;
+}
+
+Value concatLists(const ListObject& a, const ListObject& b) {
+	ListObject* list = new ListObject();
+	Value result(list);
+	list->reserve(a.size() + b.size());
+	list->extend(a);
+	list->extend(b);
+	return result;
+}
+
+Value repeatList(const ListObject& list, const Value& count) {
+	int64_t times = repeatCount(count);
+	ListObject* repeated = new ListObject();
+	Value result(repeated);
+	if (times <= 0 || list.size() == 0)
+		return result;
+	if (static_cast<uint64_t>(times) > (SIZE_MAX / sizeof(Value)) / list.size())
+		throw std::runtime_error("Repeated list is too large");
+	repeated->reserve(list.size() * static_cast<size_t>(times));
+	for (int64_t i = 0; i < times; i++)
+		repeated->extend(list);
+	return result;
+}
+
+
+bool listsEqual(const ListObject& a, const ListObject& b) {
+	if (&a == &b)
+		return true;
+	size_t count = a.size();
+	if (b.size() != count)
+		return false;
+	if (a.storage() == b.storage()) {
+		if (a.storage() == ListObject::Storage::Ints)
+			return std::equal(a.ints(), a.ints() + count, b.ints());
+		if (a.storage() == ListObject::Storage::Doubles)
+			return defaultListKernels().equalDoubles(a.doubles(), b.doubles(), count);
+	}
+	for (size_t i = 0; i < count; i++)
+		if (!valuesEqual(a.get(i), b.get(i)))
+			return false;
+	return true;
+}
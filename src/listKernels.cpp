@@ -0,0 +1,267 @@
+#include "listKernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CPPYTHON_LIST_X86 1
+#include <immintrin.h>
+#endif
+
+// AVX2 code is compiled per function so the rest of the build keeps its target
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+
+// True when a + b does not fit 64 bits
+static bool addOverflows(int64_t a, int64_t b, int64_t* out) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_add_overflow(a, b, out);
+#else
+	*out = static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+	return ((a ^ *out) & (b ^ *out)) < 0;
+#endif
+}
+
+// Adds the lane sums, then the elements the vector loop left over
+static bool finishSum(const int64_t* lanes, size_t laneCount, const int64_t* tail, size_t tailCount, int64_t* out) {
+	int64_t sum = 0;
+	for (size_t i = 0; i < laneCount; i++)
+		if (addOverflows(sum, lanes[i], &sum))
+			return false;
+	for (size_t i = 0; i < tailCount; i++)
+		if (addOverflows(sum, tail[i], &sum))
+			return false;
+	*out = sum;
+	return true;
+}
+
+// Of the elements equal to `m`, the first; only zeros can differ (in sign)
+static double firstEqual(const double* p, size_t n, double m) {
+	if (m != 0)
+		return m;
+	for (size_t i = 0; i < n; i++)
+		if (p[i] == 0)
+			return p[i];
+	return m;
+}
+
+static bool hasNaN(const double* p, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		if (p[i] != p[i])
+			return true;
+	return false;
+}
+
+
+static bool scalarSumInts(const int64_t* p, size_t n, int64_t* out) {
+	return finishSum(nullptr, 0, p, n, out);
+}
+
+// Every implementation adds floats one by one, left to right: adding in
+// lanes rounds differently, and sum() must give the same result whatever the
+// CPU, the list's storage, or a loop doing the same additions
+static double scalarSumDoubles(double start, const double* p, size_t n) {
+	double sum = start;
+	for (size_t i = 0; i < n; i++)
+		sum += p[i];
+	return sum;
+}
+
+template <bool Max>
+static int64_t scalarExtremeInts(const int64_t* p, size_t n) {
+	int64_t best = p[0];
+	for (size_t i = 1; i < n; i++)
+		if (Max ? p[i] > best : p[i] < best)
+			best = p[i];
+	return best;
+}
+
+template <bool Max>
+static bool scalarExtremeDoubles(const double* p, size_t n, double* out) {
+	if (hasNaN(p, n))
+		return false;
+	double best = p[0];
+	for (size_t i = 1; i < n; i++)
+		if (Max ? p[i] > best : p[i] < best)
+			best = p[i];
+	*out = best;
+	return true;
+}
+
+static bool scalarEqualDoubles(const double* a, const double* b, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		if (!(a[i] == b[i]))
+			return false;
+	return true;
+}
+
+static const ListKernels scalarKernels = {
+	ScanIsa::Scalar,
+	scalarSumInts,
+	scalarSumDoubles,
+	scalarExtremeInts<true>,
+	scalarExtremeInts<false>,
+	scalarExtremeDoubles<true>,
+	scalarExtremeDoubles<false>,
+	scalarEqualDoubles,
+};
+
+
+#ifdef CPPYTHON_LIST_X86
+
+// A lane overflowed where both operands differ in sign from the result
+static bool sse2SumInts(const int64_t* p, size_t n, int64_t* out) {
+	__m128i sum = _mm_setzero_si128(), overflow = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+		__m128i next = _mm_add_epi64(sum, x);
+		overflow = _mm_or_si128(overflow, _mm_and_si128(_mm_xor_si128(sum, next), _mm_xor_si128(x, next)));
+		sum = next;
+	}
+	if (_mm_movemask_pd(_mm_castsi128_pd(overflow)))
+		return false;
+	int64_t lanes[2];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sum);
+	return finishSum(lanes, 2, p + i, n - i, out);
+}
+
+// SSE2 has no 64 bit integer comparison, the Scalar loop does maxInts/minInts
+template <bool Max>
+static bool sse2ExtremeDoubles(const double* p, size_t n, double* out) {
+	__m128d best = _mm_set1_pd(p[0]), nan = _mm_setzero_pd();
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		__m128d x = _mm_loadu_pd(p + i);
+		nan = _mm_or_pd(nan, _mm_cmpunord_pd(x, x));
+		best = Max ? _mm_max_pd(best, x) : _mm_min_pd(best, x);
+	}
+	if (_mm_movemask_pd(nan) || hasNaN(p + i, n - i))
+		return false;
+	double lanes[2];
+	_mm_storeu_pd(lanes, best);
+	double m = Max ? (lanes[1] > lanes[0] ? lanes[1] : lanes[0]) : (lanes[1] < lanes[0] ? lanes[1] : lanes[0]);
+	for (; i < n; i++)
+		if (Max ? p[i] > m : p[i] < m)
+			m = p[i];
+	*out = firstEqual(p, n, m);
+	return true;
+}
+
+static bool sse2EqualDoubles(const double* a, const double* b, size_t n) {
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2)
+		if (_mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i))) != 0x3)
+			return false;
+	return scalarEqualDoubles(a + i, b + i, n - i);
+}
+
+static const ListKernels sse2Kernels = {
+	ScanIsa::SSE2,
+	sse2SumInts,
+	scalarSumDoubles,
+	scalarExtremeInts<true>,
+	scalarExtremeInts<false>,
+	sse2ExtremeDoubles<true>,
+	sse2ExtremeDoubles<false>,
+	sse2EqualDoubles,
+};
+
+
+TARGET_AVX2 static bool avx2SumInts(const int64_t* p, size_t n, int64_t* out) {
+	__m256i sum = _mm256_setzero_si256(), overflow = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+		__m256i next = _mm256_add_epi64(sum, x);
+		overflow = _mm256_or_si256(overflow, _mm256_and_si256(_mm256_xor_si256(sum, next), _mm256_xor_si256(x, next)));
+		sum = next;
+	}
+	if (_mm256_movemask_pd(_mm256_castsi256_pd(overflow)))
+		return false;
+	int64_t lanes[4];
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sum);
+	return finishSum(lanes, 4, p + i, n - i, out);
+}
+
+template <bool Max>
+TARGET_AVX2 static int64_t avx2ExtremeInts(const int64_t* p, size_t n) {
+	__m256i best = _mm256_set1_epi64x(p[0]);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+		__m256i better = Max ? _mm256_cmpgt_epi64(x, best) : _mm256_cmpgt_epi64(best, x);
+		best = _mm256_blendv_epi8(best, x, better);
+	}
+	int64_t lanes[4];
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), best);
+	int64_t m = scalarExtremeInts<Max>(lanes, 4);
+	for (; i < n; i++)
+		if (Max ? p[i] > m : p[i] < m)
+			m = p[i];
+	return m;
+}
+
+template <bool Max>
+TARGET_AVX2 static bool avx2ExtremeDoubles(const double* p, size_t n, double* out) {
+	__m256d best = _mm256_set1_pd(p[0]), nan = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d x = _mm256_loadu_pd(p + i);
+		nan = _mm256_or_pd(nan, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+		best = Max ? _mm256_max_pd(best, x) : _mm256_min_pd(best, x);
+	}
+	if (_mm256_movemask_pd(nan) || hasNaN(p + i, n - i))
+		return false;
+	double lanes[4];
+	_mm256_storeu_pd(lanes, best);
+	double m = lanes[0];
+	for (int lane = 1; lane < 4; lane++)
+		if (Max ? lanes[lane] > m : lanes[lane] < m)
+			m = lanes[lane];
+	for (; i < n; i++)
+		if (Max ? p[i] > m : p[i] < m)
+			m = p[i];
+	*out = firstEqual(p, n, m);
+	return true;
+}
+
+TARGET_AVX2 static bool avx2EqualDoubles(const double* a, const double* b, size_t n) {
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		if (_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), _CMP_EQ_OQ)) != 0xF)
+			return false;
+	return scalarEqualDoubles(a + i, b + i, n - i);
+}
+
+static const ListKernels avx2Kernels = {
+	ScanIsa::AVX2,
+	avx2SumInts,
+	scalarSumDoubles,
+	avx2ExtremeInts<true>,
+	avx2ExtremeInts<false>,
+	avx2ExtremeDoubles<true>,
+	avx2ExtremeDoubles<false>,
+	avx2EqualDoubles,
+};
+
+#endif // CPPYTHON_LIST_X86
+
+
+const ListKernels& listKernelsFor(ScanIsa isa) {
+	if (!scanIsaSupported(isa))
+		return scalarKernels;
+	switch (isa) {
+#ifdef CPPYTHON_LIST_X86
+		case ScanIsa::SSE2: return sse2Kernels;
+		case ScanIsa::AVX2: return avx2Kernels;
+#endif
+		default: return scalarKernels;
+	}
+}
+
+const ListKernels& defaultListKernels() {
+	static const ListKernels& best = scanIsaSupported(ScanIsa::AVX2) ? listKernelsFor(ScanIsa::AVX2) : listKernelsFor(ScanIsa::SSE2);
+	return best;
+}
@@ -1,82 +1,426 @@
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <fstream>
 
 #include "lexer.h"
 #include "parser.h"
+#include "parallelParser.h"
+#include "incrementalParser.h"
 #include "interpreter.h"
+#include "flatInterpreter.h"
 #include "dotGenerator.h"
+#include "vm.h"
+#include "optimizer.h"
+#include "sourceBuffer.h"
+#include "statementReader.h"
+#include "codeCache.h"
+#include "compiler.h"
 
-std::string readPythonFile(const std::string path);
-void printTokens(const std::string script);
-void printDOT(const std::string script);
-void replMode();
+// Command line switches
+struct Options {
+	bool useTreeWalker = false;	// --tree: run the tree-walking Interpreter instead of the VM
+	bool useFlatTree = false;	// --flat: parse into a FlatAst and walk that (never optimized)
+	bool optimize = true;		// --no-opt: skip the AST optimizer
+	bool printDot = false;		// --dot: print the tree before/after optimizing and exit
+	bool printOptStats = false;	// --opt-stats: report what the optimizer did
+	bool stream = false;		// --stream: run each top-level statement as soon as it is read
+	bool useCache = true;		// --no-cache: always compile from source
+	bool lazyFunctions = true;	// --eager: parse function bodies up front, not on their first call
+	unsigned parseThreads = 0;	// --jobs N: threads parsing those bodies when they are (default: one per core)
+	std::string cacheDir;		// --cache-dir DIR: where compiled scripts go (default: __cppycache__ next to the script)
+	std::string path;			// "-" reads the script from stdin
+};
+
+void printTokens(std::string_view script);
+void printDOT(std::string_view script);
+void printCallStack(const std::vector<std::string>& callStack);
+void optimizeTree(Program& tree, const Options& options);
+void printOptimizerStats(const OptimizerStats& stats);
+int runFlat(std::string_view script, const Options& options);
+int runStreaming(std::istream& in, const Options& options);
+int runCached(std::string_view script, const Options& options);
+void replMode(const Options& options);
 
 int main(int argc, char* argv[]) {
 
-	if (argc == 1) {
-		replMode();
+	Options options;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--tree")
+			options.useTreeWalker = true;
+		else if (arg == "--flat")
+			options.useFlatTree = true;
+		else if (arg == "--no-opt")
+			options.optimize = false;
+		else if (arg == "--dot")
+			options.printDot = true;
+		else if (arg == "--opt-stats")
+			options.printOptStats = true;
+		else if (arg == "--stream")
+			options.stream = true;
+		else if (arg == "--no-cache")
+			options.useCache = false;
+		else if (arg == "--eager")
+			options.lazyFunctions = false;
+		else if (arg == "--jobs" && i + 1 < argc)
+			options.parseThreads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+		else if (arg == "--cache-dir" && i + 1 < argc)
+			options.cacheDir = argv[++i];
+		else if (options.path.empty() && (arg[0] != '-' || arg == "-"))
+			options.path = arg;
+		else {
+			std::cerr << "Usage: cppython [--tree | --flat] [--no-opt] [--dot | --stream] [--opt-stats] [--eager] [--jobs N] [--no-cache | --cache-dir DIR] <script.py | ->" << std::endl;
+			return 1;
+		}
+	}
+	if (options.stream && options.printDot) {
+		std::cerr << "--dot needs the whole program, it cannot be combined with --stream" << std::endl;
+		return 1;
+	}
+	// Both report on the whole tree, bodies included
+	if (options.printDot || options.printOptStats)
+		options.lazyFunctions = false;
+
+	if (options.path.empty()) {
+		replMode(options);
 		return 0;
-	} 
-	if (argc != 2) {
-		std::cerr << "Usage: cppython <script.py>" << std::endl;
+	}
+
+	if (options.stream) {
+		if (options.path == "-")
+			return runStreaming(std::cin, options);
+		std::ifstream file(options.path, std::ios::binary);
+		if (!file.is_open()) {
+			std::cerr << "Error: Cannot open '" << options.path << "'" << std::endl;
+			return 1;
+		}
+		return runStreaming(file, options);
+	}
+
+	// Mapped, not copied: the lexer and tokens read straight from the file
+	SourceBuffer source(std::string{});
+	try {
+		source = options.path == "-" ? SourceBuffer::fromStdin() : SourceBuffer::fromFile(options.path);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
 		return 1;
 	}
+	std::string_view script = source.text();
 
-    auto script = readPythonFile(argv[1]);
+	if (options.useFlatTree)
+		return runFlat(script, options);
+	// The cache holds VM bytecode; the other modes need the tree
+	if (options.useCache && !options.useTreeWalker && !options.printDot && !options.printOptStats && options.path != "-")
+		return runCached(script, options);
 	
+	Program tree;
+	if (options.lazyFunctions) {
+		Lexer lexer(script);
+		tree = Parser(lexer, true).parse();
+	}
+	else {
+		tree = parseParallel(script, options.parseThreads);
+	}
+
+	if (options.printDot) {
+		std::cout << "// before optimization\n" << DotGenerator().generate(*tree.root);
+		if (options.optimize) {
+			optimizeTree(tree, options);
+			std::cout << "// after optimization\n" << DotGenerator().generate(*tree.root);
+		}
+		return 0;
+	}
+	optimizeTree(tree, options);
+
+	if (options.useTreeWalker) {
+		Interpreter interpreter(std::move(tree));
+		interpreter.optimizeLazyBodies = options.optimize;
+		try {
+			Value result = interpreter.interpret();
+		}
+		catch (const std::exception& e) {
+			std::cerr << "[-]	Error: " << e.what() << std::endl << std::endl;
+			printCallStack(interpreter.backtrace());
+		}
+		catch (const std::string& e) { // a lazily parsed body failed to parse
+			std::cerr << "[-]	" << e << std::endl;
+			printCallStack(interpreter.backtrace());
+		}
+		catch (const char* e) {
+			std::cerr << "[-]	" << e << std::endl;
+			printCallStack(interpreter.backtrace());
+		}
+	}
+	else {
+		VM vm;
+		vm.module.optimizeLazyBodies = options.optimize;
+		try {
+			Value result = vm.run(tree);
+		}
+		catch (const std::exception& e) {
+			std::cerr << "[-]	Error: " << e.what() << std::endl << std::endl;
+			printCallStack(vm.backtrace());
+		}
+		catch (const std::string& e) { // a lazily parsed body failed to parse
+			std::cerr << "[-]	" << e << std::endl;
+			printCallStack(vm.backtrace());
+		}
+		catch (const char* e) {
+			std::cerr << "[-]	" << e << std::endl;
+			printCallStack(vm.backtrace());
+		}
+	}
+
+	replMode(options);
+
+    return 1;
+}
+
+
+int runFlat(std::string_view script, const Options& options) {
 	Lexer lexer(script);
-	Parser parser(lexer);
-	ASTNodePtr tree = parser.parse();
-	Interpreter interpreter(std::move(tree));
+	FlatParser parser(lexer);
+	FlatAst ast = parser.parse();
 
+	if (options.printDot) {
+		std::cout << DotGenerator().generate(ast);
+		return 0;
+	}
+
+	FlatInterpreter interpreter;
 	try {
-		Value result = interpreter.interpret();
+		interpreter.interpret(std::move(ast));
 	}
 	catch (const std::exception& e) {
 		std::cerr << "[-]	Error: " << e.what() << std::endl << std::endl;
-		// print call stack
-		if (interpreter.callStack.size() != 0) {
-			std::cerr << "Call stack (most recent call last):" << std::endl;
-			for (auto it = interpreter.callStack.rbegin(); it != interpreter.callStack.rend(); ++it) {
-				std::cerr << "  in function '" << *it << "'" << std::endl;
+		printCallStack(interpreter.backtrace());
+	}
+
+	replMode(options);
+
+	return 1;
+}
+
+
+// Number of functions of `module` still waiting for their first call
+static size_t lazyStubs(const Module& module) {
+	size_t stubs = 0;
+	for (const auto& proto : module.functions)
+		stubs += proto && proto->code.empty();
+	return stubs;
+}
+
+// Runs the script on the VM from its cached bytecode, compiling it only when
+// the source or the switches changed. Function bodies are compiled on their
+// first call here too (unless --eager), and the cache is written after the
+// run: the bodies the run compiled are stored as bytecode, the others as
+// stubs. A later run that compiles more of them writes the cache again.
+int runCached(std::string_view script, const Options& options) {
+	uint64_t key = codeCacheKey(script, options.optimize, options.lazyFunctions);
+	std::string cachePath = codeCachePath(options.path, options.cacheDir);
+
+	VM vm;
+	vm.module.optimizeLazyBodies = options.optimize;
+	const FunctionProto* code = loadCodeCache(cachePath, key, vm.module);
+	bool compiled = !code;
+	if (!code) {
+		Program tree;
+		if (options.lazyFunctions) {
+			Lexer lexer(script);
+			tree = Parser(lexer, true).parse();
+		}
+		else {
+			tree = parseParallel(script, options.parseThreads);
+		}
+		optimizeTree(tree, options);
+		code = Compiler(vm.module).compile(tree);
+	}
+	size_t stubs = lazyStubs(vm.module);
+
+	try {
+		vm.execute(*code);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "[-]	Error: " << e.what() << std::endl << std::endl;
+		printCallStack(vm.backtrace());
+	}
+	catch (const std::string& e) { // a lazily parsed body failed to parse
+		std::cerr << "[-]	" << e << std::endl;
+		printCallStack(vm.backtrace());
+	}
+	catch (const char* e) {
+		std::cerr << "[-]	" << e << std::endl;
+		printCallStack(vm.backtrace());
+	}
+
+	if (compiled || lazyStubs(vm.module) < stubs)
+		saveCodeCache(cachePath, key, vm.module, *code); // best effort, e.g. read-only directories
+
+	replMode(options);
+
+	return 1;
+}
+
+
+// Reads the script in chunks and runs each top-level statement as soon as
+// it is complete, so memory is bounded by the largest statement (plus the
+// functions defined so far) and output starts before the input is read.
+int runStreaming(std::istream& in, const Options& options) {
+	StatementReader reader(in);
+	Interpreter interpreter(Program{});
+	FlatInterpreter flatInterpreter;
+	VM vm;
+	interpreter.optimizeLazyBodies = options.optimize;
+	vm.module.optimizeLazyBodies = options.optimize;
+	std::string_view statement;
+
+	try {
+		while (reader.next(statement)) {
+			Lexer lexer(statement);
+			if (options.useFlatTree) {
+				flatInterpreter.interpret(FlatParser(lexer).parse());
+				continue;
+			}
+			Program tree = Parser(lexer, options.lazyFunctions).parse();
+			optimizeTree(tree, options);
+			if (options.useTreeWalker) {
+				interpreter.program = std::move(tree);
+				interpreter.interpret();
+			}
+			else {
+				vm.run(tree);
 			}
 		}
 	}
+	catch (const std::exception& e) {
+		std::cerr << "[-]	Error: " << e.what() << std::endl << std::endl;
+		if (options.useFlatTree)
+			printCallStack(flatInterpreter.backtrace());
+		else
+			printCallStack(options.useTreeWalker ? interpreter.backtrace() : vm.backtrace());
+	}
+	catch (const std::string& e) { // parse errors
+		std::cerr << "[-]	" << e << std::endl;
+	}
+	catch (const char* e) { // lexer errors
+		std::cerr << "[-]	" << e << std::endl;
+	}
 
-	replMode();
+	replMode(options);
 
-    return 1;
+	return 1;
+}
+
+
+void optimizeTree(Program& tree, const Options& options) {
+	if (!options.optimize)
+		return;
+	Optimizer optimizer;
+	optimizer.optimize(tree);
+	if (options.printOptStats)
+		printOptimizerStats(optimizer.stats());
+}
+
+void printOptimizerStats(const OptimizerStats& stats) {
+	std::cerr << "[optimizer] nodes: " << stats.nodesBefore << " -> " << stats.nodesAfter
+		<< " (" << stats.nodesRemoved() << " removed), folded: " << stats.constantsFolded
+		<< ", dead branches: " << stats.branchesRemoved << ", unwrapped blocks: " << stats.blocksUnwrapped
+		<< ", identities: " << stats.identitiesSimplified << std::endl;
+}
+
+
+void printCallStack(const std::vector<std::string>& callStack) {
+	if (callStack.size() != 0) {
+		std::cerr << "Call stack (most recent call last):" << std::endl;
+		for (auto it = callStack.rbegin(); it != callStack.rend(); ++it) {
+			std::cerr << "  in function '" << *it << "'" << std::endl;
+		}
+	}
 }
 
 
-// REPL - Read Eval Print Loop
-void replMode() {
+// REPL - Read Eval Print Loop. A line ending in ':' opens a block that
+// continues until an empty line. Everything entered is kept in an
+// IncrementalParser, so each input is parsed without re-parsing the session.
+void replMode(const Options& options) {
 
-	Interpreter interpreter(nullptr);
+	Interpreter interpreter(Program{});
+	FlatInterpreter flatInterpreter;
+	VM vm; // keeps globals and functions between lines, like the interpreter instance
+	IncrementalParser session;
+	interpreter.optimizeLazyBodies = options.optimize;
+	vm.module.optimizeLazyBodies = options.optimize;
 	std::cout << "\n\nCPPython Interpreter By Carmul (2025)\n(type 'exit' to quit)\n";
 
 	while (true) {
 		std::cout << ">>> ";
 		std::string line;
-		std::getline(std::cin, line);
+		if (!std::getline(std::cin, line)) break; // end of input
 		if (line == "exit" || line == "quit") break;
 		if (line.empty()) continue;
 
+		std::string input = line + "\n";
+		size_t last = line.find_last_not_of(' ');
+		bool compound = last != std::string::npos && line[last] == ':';
+		if (compound) {
+			while (true) {
+				std::cout << "... ";
+				if (!std::getline(std::cin, line) || line.empty()) break;
+				input += line + "\n";
+			}
+		}
+
 		try {
-			Lexer lexer(line);
-			Parser parser(lexer);
-			ASTNodePtr tree = parser.parse();
-			interpreter.tree = std::move(tree); // saves the variables in the interpreter instance
+			if (options.useFlatTree) {
+				Lexer lexer(input);
+				FlatParser parser(lexer);
+				FlatAst ast = parser.parse();
+				// If the input is a single expression, print the result
+				bool single = !compound && ast.b[ast.root] == 1 && ast.kind(*ast.list(ast.a[ast.root])) != FlatKind::Assignment;
+				Value result = flatInterpreter.interpret(std::move(ast));
+				if (single)
+					std::cout << (result.isString() ? "\"" + result.toString() + "\"" : result.toString()) << std::endl;
+				continue;
+			}
 
-			Value result = interpreter.interpret(); // interpret the AST
+			// Only the statements of this input are parsed and run
+			size_t start = session.size();
+			session.edit(start, 0, input);
+			size_t first = session.statementCount();
+			while (first > 0 && session.statementBegin(first - 1) >= start)
+				first--;
+			std::string error = first == session.statementCount() ? "Error: unexpected indent or continuation" : session.error(first);
+			if (!error.empty()) {
+				session.edit(start, input.size(), ""); // forget the input
+				std::cerr << "[-]	" << error << std::endl;
+				continue;
+			}
+			// Optimized in the session, the statements' trees outlive this program
+			if (options.optimize) {
+				OptimizerStats stats = session.optimize(first);
+				if (options.printOptStats)
+					printOptimizerStats(stats);
+			}
+			Program tree = session.program(first);
+
+			Value result;
+			if (options.useTreeWalker) {
+				interpreter.program = tree; // saves the variables in the interpreter instance
+				result = interpreter.interpret(); // interpret the AST
+			}
+			else {
+				result = vm.run(tree);
+			}
 
 			// If the input is a single expression, print the result
-			if (auto prog = dynamic_cast<BlockNode*>(interpreter.tree.get())) {
-				if (prog->statements.size() == 1) {
-					auto& stmt = prog->statements[0];
+			if (auto prog = dynamic_cast<BlockNode*>(tree.root)) {
+				if (!compound && prog->statements.size() == 1) {
+					auto stmt = prog->statements[0];
 					// If stmt is not AssignmentNode, treat it as expression
-					if (!dynamic_cast<AssignmentNode*>(stmt.get())) {
+					if (!dynamic_cast<AssignmentNode*>(stmt)) {
 						if (result.isString())
 							std::cout << "\"" + result.toString() + "\"" << std::endl;
 						else 
@@ -89,32 +433,19 @@ void replMode() {
 		catch (const std::exception& e) {
 			std::cerr << "[-]	Error: " << e.what() << std::endl;
 		}
+		catch (const std::string& e) { // parse errors
+			std::cerr << "[-]	" << e << std::endl;
+		}
+		catch (const char* e) { // lexer errors
+			std::cerr << "[-]	" << e << std::endl;
+		}
 	}
 
 	
 }
 
 
-std::string readPythonFile(const std::string path) {
-
-    std::ifstream f(path);
-
-    if (!f.is_open()) {
-        std::cerr << "Error opening the file!";
-        return "\0";
-    }
-
-    std::string line;
-    std::string s = "";
-
-    while (std::getline(f, line))
-        s += line + "\n";
-
-    return s;
-}
-
-
-void printTokens(const std::string script) {
+void printTokens(std::string_view script) {
 	Lexer lexer = Lexer(script);
 	// print tokens
 	while (true) {
@@ -126,11 +457,11 @@ void printTokens(const std::string script) {
 }
 
 
-void printDOT(const std::string script) {
+void printDOT(std::string_view script) {
 	Lexer lexer = Lexer(script);
 	Parser parser(lexer); // create parser
-	ASTNodePtr tree = parser.parse(); // parse input to AST
+	Program tree = parser.parse(); // parse input to AST
 	// generate and print DOT format
-	std::string dot = DotGenerator().generate(std::move(tree));
+	std::string dot = DotGenerator().generate(*tree.root);
 	std::cout << dot << std::endl;
 }
@@ -0,0 +1,489 @@
+#include "operators.h"
+#include "dict.h"
+#include "list.h"
+#include <cmath>
+#include <string>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+int64_t repeatCount(const Value& count) {
+	int64_t times;
+	if (count.toInt64(times))
+		return times < 0 ? 0 : times;
+	if (count.isBigInt())
+		return count.asBigInt().isNegative() ? 0 : INT64_MAX;
+	throw std::runtime_error("can't multiply sequence by non-int of type '" + count.typeName() + "'");
+}
+
+static std::string repeatString(const std::string& s, const Value& count) {
+	int64_t times = repeatCount(count);
+	std::string repeated;
+	if (times == 0 || s.empty())
+		return repeated;
+	if (static_cast<uint64_t>(times) > repeated.max_size() / s.size())
+		throw std::runtime_error("Repeated string is too large");
+	repeated.reserve(s.size() * static_cast<size_t>(times));
+	for (int64_t i = 0; i < times; ++i)
+		repeated += s;
+	return repeated;
+}
+
+static std::runtime_error compareError(const char* op, const Value& l, const Value& r) {
+	return std::runtime_error(std::string("Type error in '") + op + "': cannot compare " + l.typeName() + " and " + r.typeName());
+}
+
+// Checked 64 bit arithmetic; true when the result does not fit
+#if defined(__GNUC__) || defined(__clang__)
+static bool addOverflows(int64_t a, int64_t b, int64_t* out) { return __builtin_add_overflow(a, b, out); }
+static bool subOverflows(int64_t a, int64_t b, int64_t* out) { return __builtin_sub_overflow(a, b, out); }
+static bool mulOverflows(int64_t a, int64_t b, int64_t* out) { return __builtin_mul_overflow(a, b, out); }
+#else
+static bool addOverflows(int64_t a, int64_t b, int64_t* out) {
+	*out = static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+	return ((a ^ *out) & (b ^ *out)) < 0; // both operands differ in sign from the result
+}
+static bool subOverflows(int64_t a, int64_t b, int64_t* out) {
+	*out = static_cast<int64_t>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b));
+	return ((a ^ b) & (a ^ *out)) < 0;
+}
+static bool mulOverflows(int64_t a, int64_t b, int64_t* out) {
+	int64_t high;
+	*out = _mul128(a, b, &high);
+	return high != (*out >> 63);
+}
+#endif
+
+static std::runtime_error divisionByZero() {
+	return std::runtime_error("Division by zero");
+}
+
+// Bools take part in arithmetic as the integers 0 and 1
+static bool isIntegral(const Value& v) {
+	return v.isInteger() || v.isBool();
+}
+
+enum class IntegerOp { Add, Sub, Mul, FloorDiv, Mod };
+
+// Exact integer arithmetic: in 64 bits while the result fits, in BigInt past that
+static Value integerArithmetic(IntegerOp op, const Value& l, const Value& r) {
+	int64_t a, b, out;
+	if (l.toInt64(a) && r.toInt64(b)) {
+		switch (op) {
+			case IntegerOp::Add:
+				if (!addOverflows(a, b, &out)) return Value::integer(out);
+				break;
+			case IntegerOp::Sub:
+				if (!subOverflows(a, b, &out)) return Value::integer(out);
+				break;
+			case IntegerOp::Mul:
+				if (!mulOverflows(a, b, &out)) return Value::integer(out);
+				break;
+			case IntegerOp::FloorDiv:
+				if (b == 0) throw divisionByZero();
+				if (a != INT64_MIN || b != -1) return Value::integer(floorDivInt(a, b));
+				break;
+			case IntegerOp::Mod:
+				if (b == 0) throw divisionByZero();
+				return Value::integer(b == -1 ? 0 : floorModInt(a, b));
+		}
+	}
+
+	BigInt x = l.toBigInt(), y = r.toBigInt();
+	switch (op) {
+		case IntegerOp::Add: return Value::integer(x + y);
+		case IntegerOp::Sub: return Value::integer(x - y);
+		case IntegerOp::Mul: return Value::integer(x * y);
+		default: break;
+	}
+	if (y.isZero())
+		throw divisionByZero();
+	BigInt result;
+	if (op == IntegerOp::FloorDiv)
+		BigInt::floorDivMod(x, y, &result, nullptr);
+	else
+		BigInt::floorDivMod(x, y, nullptr, &result);
+	return Value::integer(std::move(result));
+}
+
+Value multiplyIntegers(int64_t a, int64_t b) {
+	int64_t product;
+	if (!mulOverflows(a, b, &product))
+		return Value::integer(product);
+	return Value::integer(BigInt(a) * BigInt(b));
+}
+
+// Python's float % and //: the remainder takes the sign of the divisor
+double floorModDouble(double a, double b) {
+	if (b == 0) throw divisionByZero();
+	double mod = std::fmod(a, b);
+	if (mod != 0 && (b < 0) != (mod < 0))
+		mod += b;
+	return mod;
+}
+
+double floorDivDouble(double a, double b) {
+	if (b == 0) throw divisionByZero();
+	double mod = std::fmod(a, b);
+	double div = (a - mod) / b;
+	if (mod != 0 && (b < 0) != (mod < 0))
+		div -= 1;
+	if (div == 0)
+		return std::copysign(0.0, a / b);
+	double floored = std::floor(div);
+	return div - floored > 0.5 ? floored + 1 : floored; // (a - mod) / b is inexact
+}
+
+static int64_t rangeBound(const Value& v) {
+	int64_t bound;
+	if (v.toInt64(bound))
+		return bound;
+	if (v.isBigInt())
+		throw std::runtime_error("range() argument does not fit 64 bits");
+	throw std::runtime_error("'" + v.typeName() + "' object cannot be interpreted as an integer");
+}
+
+IntRange makeRange(const Value& start, const Value& stop, const Value& step) {
+	IntRange range{ rangeBound(start), rangeBound(stop), rangeBound(step) };
+	if (range.step == 0)
+		throw std::runtime_error("range() arg 3 must not be zero");
+	return range;
+}
+
+
+static int64_t indexOf(const Value& container, const Value& index) {
+	int64_t i;
+	if (index.isDouble() || !index.toInt64(i)) {
+		if (index.isBigInt())
+			throw std::runtime_error("cannot fit 'int' into an index-sized integer");
+		throw std::runtime_error(container.typeName() + " indices must be integers, not " + index.typeName());
+	}
+	return i;
+}
+
+Value indexValue(const Value& container, const Value& index) {
+	if (container.isDict()) {
+		const Value* value = container.asDict().find(index);
+		if (!value)
+			throw std::runtime_error("KeyError: " + index.repr());
+		return *value;
+	}
+	if (container.isList()) {
+		const ListObject& list = container.asList();
+		return list.get(list.checkedIndex(indexOf(container, index)));
+	}
+	if (container.isString()) {
+		const std::string& s = container.asString();
+		int64_t i = indexOf(container, index);
+		if (i < 0)
+			i += static_cast<int64_t>(s.size());
+		if (i < 0 || i >= static_cast<int64_t>(s.size()))
+			throw std::runtime_error("string index out of range");
+		return Value(std::string(1, s[static_cast<size_t>(i)]));
+	}
+	throw std::runtime_error("'" + container.typeName() + "' object is not subscriptable");
+}
+
+void storeIndex(const Value& container, const Value& index, const Value& value) {
+	if (container.isDict()) {
+		container.asDict().set(index, value);
+		return;
+	}
+	if (!container.isList())
+		throw std::runtime_error("'" + container.typeName() + "' object does not support item assignment");
+	ListObject& list = container.asList();
+	list.set(list.checkedIndex(indexOf(container, index)), value);
+}
+
+bool iterationItem(const Value& iterable, size_t position, Value& item) {
+	if (iterable.isList()) {
+		const ListObject& list = iterable.asList();
+		if (position >= list.size())
+			return false;
+		item = list.get(position);
+		return true;
+	}
+	if (iterable.isDict()) {
+		const DictObject& dict = iterable.asDict();
+		if (position >= dict.size())
+			return false;
+		item = dict.keyAt(position);
+		return true;
+	}
+	if (iterable.isString()) {
+		const std::string& s = iterable.asString();
+		if (position >= s.size())
+			return false;
+		item = Value(std::string(1, s[position]));
+		return true;
+	}
+	throw std::runtime_error("'" + iterable.typeName() + "' object is not iterable");
+}
+
+
+// Orders two numbers exactly, also an integer against a double that cannot
+// hold it: -1, 0 or 1, or kUnordered when one of them is NaN
+static constexpr int kUnordered = 2;
+
+static int compareIntegerDouble(const Value& i, double d) {
+	if (d != d)
+		return kUnordered;
+	int64_t a;
+	if (i.toInt64(a)) {
+		if (d >= 9223372036854775808.0) return -1; // 2^63
+		if (d < -9223372036854775808.0) return 1;
+		double t = std::trunc(d);
+		int64_t whole = static_cast<int64_t>(t);
+		if (a != whole) return a < whole ? -1 : 1;
+		return t < d ? -1 : (t > d ? 1 : 0);
+	}
+	if (std::isinf(d))
+		return d > 0 ? -1 : 1;
+	double t = std::trunc(d);
+	int c = BigInt::compare(i.toBigInt(), BigInt::fromDouble(t));
+	if (c) return c;
+	return t < d ? -1 : (t > d ? 1 : 0);
+}
+
+static int compareNumbers(const Value& l, const Value& r) {
+	if (isIntegral(l) && isIntegral(r)) {
+		int64_t a, b;
+		if (l.toInt64(a) && r.toInt64(b))
+			return a < b ? -1 : (a > b ? 1 : 0);
+		return BigInt::compare(l.toBigInt(), r.toBigInt());
+	}
+	if (isIntegral(l) && r.isDouble())
+		return compareIntegerDouble(l, r.asDouble());
+	if (l.isDouble() && isIntegral(r)) {
+		int c = compareIntegerDouble(r, l.asDouble());
+		return c == kUnordered ? c : -c;
+	}
+	double a = l.asNumber(), b = r.asNumber(); // throws for anything else
+	if (a < b) return -1;
+	if (a > b) return 1;
+	return a == b ? 0 : kUnordered;
+}
+
+
+// Strings, lists and dicts are only compared for equality, with their own type
+static bool isContainer(const Value& v) {
+	return v.isString() || v.isList() || v.isDict();
+}
+
+Value addValues(const Value& l, const Value& r) {
+	if (l.isString() && r.isString()) // string concatenation
+		return Value(l.asString() + r.asString());
+	if (l.isList() && r.isList())
+		return concatLists(l.asList(), r.asList());
+	if (isIntegral(l) && isIntegral(r))
+		return integerArithmetic(IntegerOp::Add, l, r);
+	return Value(l.asNumber() + r.asNumber());
+}
+
+Value subValues(const Value& l, const Value& r) {
+	if (isIntegral(l) && isIntegral(r))
+		return integerArithmetic(IntegerOp::Sub, l, r);
+	return Value(l.asNumber() - r.asNumber());
+}
+
+Value mulValues(const Value& l, const Value& r) {
+	if (l.isList())
+		return repeatList(l.asList(), r);
+	if (r.isList())
+		return repeatList(r.asList(), l);
+	if (l.isString()) // string repetition
+		return Value(repeatString(l.asString(), r));
+	if (r.isString())
+		return Value(repeatString(r.asString(), l));
+	if (isIntegral(l) && isIntegral(r))
+		return integerArithmetic(IntegerOp::Mul, l, r);
+	return Value(l.asNumber() * r.asNumber());
+}
+
+// True division, always a double
+Value divValues(const Value& l, const Value& r) {
+	return Value(l.asNumber() / r.asNumber());
+}
+
+Value floorDivValues(const Value& l, const Value& r) {
+	if (isIntegral(l) && isIntegral(r))
+		return integerArithmetic(IntegerOp::FloorDiv, l, r);
+	return Value(floorDivDouble(l.asNumber(), r.asNumber()));
+}
+
+Value modValues(const Value& l, const Value& r) {
+	if (isIntegral(l) && isIntegral(r))
+		return integerArithmetic(IntegerOp::Mod, l, r);
+	return Value(floorModDouble(l.asNumber(), r.asNumber()));
+}
+
+Value equalValues(const Value& l, const Value& r) {
+	if (l.isList() && r.isList())
+		return Value(listsEqual(l.asList(), r.asList()));
+	if (l.isDict() && r.isDict())
+		return Value(dictsEqual(l.asDict(), r.asDict()));
+	if (!(isContainer(l) || isContainer(r)))
+		return Value(compareNumbers(l, r) == 0);
+	if (l.isString() && r.isString())
+		return Value(l.asString() == r.asString());
+	throw compareError("==", l, r);
+}
+
+Value notEqualValues(const Value& l, const Value& r) {
+	if (l.isList() && r.isList())
+		return Value(!listsEqual(l.asList(), r.asList()));
+	if (l.isDict() && r.isDict())
+		return Value(!dictsEqual(l.asDict(), r.asDict()));
+	if (!(isContainer(l) || isContainer(r)))
+		return Value(compareNumbers(l, r) != 0);
+	if (l.isString() && r.isString())
+		return Value(l.asString() != r.asString());
+	throw compareError("!=", l, r);
+}
+
+bool valuesEqual(const Value& a, const Value& b) {
+	if (!(isContainer(a) || isContainer(b)))
+		return equalValues(a, b).asBool();
+	if (a.isList() && b.isList())
+		return listsEqual(a.asList(), b.asList());
+	if (a.isDict() && b.isDict())
+		return dictsEqual(a.asDict(), b.asDict());
+	return a.isString() && b.isString() && a.asString() == b.asString();
+}
+
+// A key of a dict, an element of a list, a substring of a string
+Value inValues(const Value& l, const Value& r) {
+	if (r.isDict())
+		return Value(r.asDict().find(l) != nullptr);
+	if (r.isList()) {
+		const ListObject& list = r.asList();
+		for (size_t i = 0; i < list.size(); i++)
+			if (valuesEqual(list.get(i), l))
+				return Value(true);
+		return Value(false);
+	}
+	if (r.isString()) {
+		if (!l.isString())
+			throw std::runtime_error("'in <string>' requires string as left operand, not " + l.typeName());
+		return Value(r.asString().find(l.asString()) != std::string::npos);
+	}
+	throw std::runtime_error("argument of type '" + r.typeName() + "' is not iterable");
+}
+
+Value notInValues(const Value& l, const Value& r) {
+	return Value(!inValues(l, r).asBool());
+}
+
+Value lessValues(const Value& l, const Value& r) {
+	if (!(isContainer(l) || isContainer(r)))
+		return Value(compareNumbers(l, r) == -1);
+	throw compareError("<", l, r);
+}
+
+Value lessEqualValues(const Value& l, const Value& r) {
+	if (!(isContainer(l) || isContainer(r))) {
+		int c = compareNumbers(l, r);
+		return Value(c == -1 || c == 0);
+	}
+	throw compareError("<=", l, r);
+}
+
+Value greaterValues(const Value& l, const Value& r) {
+	if (!(isContainer(l) || isContainer(r)))
+		return Value(compareNumbers(l, r) == 1);
+	throw compareError(">", l, r);
+}
+
+Value greaterEqualValues(const Value& l, const Value& r) {
+	if (!(isContainer(l) || isContainer(r))) {
+		int c = compareNumbers(l, r);
+		return Value(c == 1 || c == 0);
+	}
+	throw compareError(">=", l, r);
+}
+
+Value negateValue(const Value& v) {
+	if (v.isSmallInt())
+		return Value::integer(-v.asSmallInt());
+	if (isIntegral(v))
+		return integerArithmetic(IntegerOp::Sub, Value::integer(0), v);
+	return Value(-v.asNumber());
+}
+
+// The operand that decides, as Python's and/or. The engines short-circuit
+// before getting here; these serve the optimizer's folding of two literals.
+static Value andValues(const Value& l, const Value& r) {
+	return l.isTruthy() ? r : l;
+}
+
+static Value orValues(const Value& l, const Value& r) {
+	return l.isTruthy() ? l : r;
+}
+
+using BinaryHandler = Value (*)(const Value&, const Value&);
+
+// Generic handlers, indexed by BinaryOp
+static const BinaryHandler binaryHandlers[] = {
+	addValues,
+	subValues,
+	mulValues,
+	divValues,
+	floorDivValues,
+	modValues,
+	equalValues,
+	notEqualValues,
+	lessValues,
+	lessEqualValues,
+	greaterValues,
+	greaterEqualValues,
+	andValues,
+	orValues,
+	inValues,
+	notInValues,
+};
+
+Value applyBinary(BinaryOp op, const Value& l, const Value& r) {
+	if (Value::bothSmallInts(l, r)) {
+		int64_t a = l.asSmallInt(), b = r.asSmallInt();
+		switch (op) {
+			case BinaryOp::Add: return Value::integer(a + b);
+			case BinaryOp::Sub: return Value::integer(a - b);
+			case BinaryOp::Mul: return multiplyIntegers(a, b);
+			case BinaryOp::Div: return Value(static_cast<double>(a) / static_cast<double>(b));
+			case BinaryOp::FloorDiv: if (b != 0) return Value::integer(floorDivInt(a, b)); break;
+			case BinaryOp::Mod: if (b != 0) return Value::integer(floorModInt(a, b)); break;
+			case BinaryOp::Equal: return Value(a == b);
+			case BinaryOp::NotEqual: return Value(a != b);
+			case BinaryOp::Less: return Value(a < b);
+			case BinaryOp::LessEqual: return Value(a <= b);
+			case BinaryOp::Greater: return Value(a > b);
+			case BinaryOp::GreaterEqual: return Value(a >= b);
+			default: break;
+		}
+	}
+	else if (l.isInlineNumber() && r.isInlineNumber()) { // a double and a double or int
+		double a = l.inlineNumberAsDouble(), b = r.inlineNumberAsDouble();
+		switch (op) {
+			case BinaryOp::Add: return Value(a + b);
+			case BinaryOp::Sub: return Value(a - b);
+			case BinaryOp::Mul: return Value(a * b);
+			case BinaryOp::Div: return Value(a / b);
+			case BinaryOp::Equal: return Value(a == b);
+			case BinaryOp::NotEqual: return Value(a != b);
+			case BinaryOp::Less: return Value(a < b);
+			case BinaryOp::LessEqual: return Value(a <= b);
+			case BinaryOp::Greater: return Value(a > b);
+			case BinaryOp::GreaterEqual: return Value(a >= b);
+			default: break;
+		}
+	}
+	return binaryHandlers[static_cast<int>(op)](l, r);
+}
+
+Value applyUnary(UnaryOp op, const Value& v) {
+	switch (op) {
+		case UnaryOp::Minus: return negateValue(v);
+		case UnaryOp::Not: return Value(!v.isTruthy());
+		default: return v; // unary plus, do nothing
+	}
+}
@@ -0,0 +1,410 @@
+#include "optimizer.h"
+#include "operators.h"
+#include "resolver.h"
+#include <stdexcept>
+#include <unordered_set>
+
+
+// Folding "ab" * 100000 would only bloat the tree
+static constexpr size_t kMaxFoldedStringLength = 4096;
+
+static bool literalValue(ASTNode& node, Value& out) {
+	if (auto number = dynamic_cast<NumberNode*>(&node)) {
+		out = number->literal();
+		return true;
+	}
+	if (auto boolean = dynamic_cast<BooleanNode*>(&node)) {
+		out = Value(boolean->value);
+		return true;
+	}
+	if (auto str = dynamic_cast<StringNode*>(&node)) {
+		out = Value(str->value);
+		return true;
+	}
+	return false;
+}
+
+
+// Only integer literals: x * 1.0 turns an integer x into a double
+static bool isIntegerLiteral(ASTNode& node, int64_t value) {
+	auto number = dynamic_cast<NumberNode*>(&node);
+	return number && number->kind == NumberKind::Int && number->integer == value;
+}
+
+// True if evaluating node can only produce a number (or fail)
+static bool isNumeric(ASTNode& node) {
+	if (dynamic_cast<NumberNode*>(&node))
+		return true;
+	if (auto unary = dynamic_cast<UnaryOpNode*>(&node))
+		return unary->op == UnaryOp::Minus || (unary->op == UnaryOp::Plus && isNumeric(*unary->factor));
+	if (auto binary = dynamic_cast<BinaryOpNode*>(&node)) {
+		switch (binary->op) {
+			case BinaryOp::Sub:
+			case BinaryOp::Div:
+			case BinaryOp::FloorDiv:
+			case BinaryOp::Mod:
+				return true;
+			case BinaryOp::Add:
+			case BinaryOp::Mul: // strings concatenate and repeat
+				return isNumeric(*binary->left) && isNumeric(*binary->right);
+			default:
+				return false;
+		}
+	}
+	return false;
+}
+
+
+void Optimizer::optimize(Program& program) {
+	counters = OptimizerStats();
+	arena = program.arena.get();
+	counters.nodesBefore = countNodes(*program.root);
+	program.root->accept(*this); // the root block is kept even when it could be unwrapped
+	replacement = nullptr;
+	counters.nodesAfter = countNodes(*program.root);
+}
+
+void Optimizer::rewrite(ASTNodePtr& node) {
+	node->accept(*this);
+	if (replacement) {
+		node = replacement;
+		replacement = nullptr;
+	}
+}
+
+// Replaced nodes are simply abandoned, the arena reclaims them with the rest
+ASTNodePtr Optimizer::literalNode(const Value& value) {
+	int64_t integer;
+	if (value.toInt64(integer) && !value.isBool())
+		return arena->make<NumberNode>(integer);
+	if (value.isBigInt())
+		return arena->make<NumberNode>(arena->copyText(value.toString()));
+	if (value.isDouble())
+		return arena->make<NumberNode>(value.asDouble());
+	if (value.isBool())
+		return arena->make<BooleanNode>(value.asBool());
+	return arena->make<StringNode>(arena->intern(value.asString()));
+}
+
+// Bodies of if/while/def: a block of one statement becomes the statement
+void Optimizer::rewriteBody(ASTNodePtr& body) {
+	rewrite(body);
+	auto block = dynamic_cast<BlockNode*>(body);
+	if (block && block->statements.size() == 1) {
+		body = block->statements[0];
+		counters.blocksUnwrapped++;
+	}
+}
+
+
+void Optimizer::visit(NumberNode&) {}
+
+// A string repetition is sized from its operands before it is built: only
+// a small non-negative int count whose result fits kMaxFoldedStringLength
+// folds, anything else is left for the code to do (or reject) when it runs
+static bool repeatsPastFoldLimit(BinaryOp op, const Value& l, const Value& r) {
+	if (op != BinaryOp::Mul || (!l.isString() && !r.isString()))
+		return false;
+	const Value& text = l.isString() ? l : r;
+	const Value& count = l.isString() ? r : l;
+	int64_t times;
+	if (!count.toInt64(times) || times < 0 || static_cast<uint64_t>(times) > kMaxFoldedStringLength)
+		return true;
+	return text.asString().size() * static_cast<size_t>(times) > kMaxFoldedStringLength;
+}
+
+void Optimizer::visit(BinaryOpNode& node) {
+	rewrite(node.left);
+	rewrite(node.right);
+
+	Value l, r;
+	if ((node.op == BinaryOp::And || node.op == BinaryOp::Or) && literalValue(*node.left, l)) {
+		// A literal left operand decides which side is the result
+		replacement = shortCircuits(node.op, l) ? node.left : node.right;
+		counters.branchesRemoved++;
+		return;
+	}
+	if (literalValue(*node.left, l) && literalValue(*node.right, r) && !repeatsPastFoldLimit(node.op, l, r)) {
+		try {
+			Value folded = applyBinary(node.op, l, r);
+			if (!folded.isString() || folded.asString().size() <= kMaxFoldedStringLength) {
+				replacement = literalNode(folded);
+				counters.constantsFolded++;
+				return;
+			}
+		}
+		catch (const std::exception&) {
+			// leave the error to be reported when the code runs
+		}
+	}
+
+	// Identities, only where the other operand is certainly a number
+	bool rightIsIdentity =
+		(node.op == BinaryOp::Mul && isIntegerLiteral(*node.right, 1)) ||
+		((node.op == BinaryOp::Add || node.op == BinaryOp::Sub) && isIntegerLiteral(*node.right, 0));
+	if (rightIsIdentity && isNumeric(*node.left)) {
+		replacement = node.left;
+		counters.identitiesSimplified++;
+		return;
+	}
+	bool leftIsIdentity =
+		(node.op == BinaryOp::Mul && isIntegerLiteral(*node.left, 1)) ||
+		(node.op == BinaryOp::Add && isIntegerLiteral(*node.left, 0));
+	if (leftIsIdentity && isNumeric(*node.right)) {
+		replacement = node.right;
+		counters.identitiesSimplified++;
+	}
+}
+
+void Optimizer::visit(ComparisonChainNode& node) {
+	bool literals = true;
+	Value value;
+	for (auto& operand : node.operands) {
+		rewrite(operand);
+		literals = literals && literalValue(*operand, value);
+	}
+	if (!literals)
+		return;
+	try {
+		Value left, right, folded;
+		literalValue(*node.operands[0], left);
+		for (size_t i = 0; i < node.ops.size(); i++) {
+			literalValue(*node.operands[i + 1], right);
+			folded = applyBinary(node.ops[i], left, right);
+			if (!folded.isTruthy())
+				break;
+			left = right;
+		}
+		replacement = literalNode(folded);
+		counters.constantsFolded++;
+	}
+	catch (const std::exception&) {
+		// leave the error to be reported when the code runs
+	}
+}
+
+void Optimizer::visit(UnaryOpNode& node) {
+	rewrite(node.factor);
+
+	Value v;
+	if (literalValue(*node.factor, v)) {
+		try {
+			replacement = literalNode(applyUnary(node.op, v));
+			counters.constantsFolded++;
+		}
+		catch (const std::exception&) {
+			// leave the error to be reported when the code runs
+		}
+	}
+}
+
+void Optimizer::visit(VarNode&) {}
+
+void Optimizer::visit(AssignmentNode& node) {
+	rewrite(node.value);
+}
+
+void Optimizer::visit(BooleanNode&) {}
+
+void Optimizer::visit(StringNode&) {}
+
+// A list or dict display is a new object every time it runs, it is never folded
+void Optimizer::visit(ListNode& node) {
+	for (auto& element : node.elements)
+		rewrite(element);
+}
+
+void Optimizer::visit(DictNode& node) {
+	for (auto& item : node.items)
+		rewrite(item);
+}
+
+void Optimizer::visit(IndexNode& node) {
+	rewrite(node.container);
+	rewrite(node.index);
+}
+
+// The target stays an IndexNode, only its operands are rewritten
+void Optimizer::visit(IndexAssignmentNode& node) {
+	rewrite(node.value);
+	rewrite(node.target);
+}
+
+void Optimizer::visit(BlockNode& node) {
+	bool nested = false;
+	for (auto& stmt : node.statements) {
+		rewrite(stmt);
+		nested = nested || dynamic_cast<BlockNode*>(stmt);
+	}
+	if (!nested)
+		return;
+
+	// Splice blocks left behind by removed branches into this one
+	std::vector<ASTNodePtr> statements;
+	for (auto stmt : node.statements) {
+		if (auto inner = dynamic_cast<BlockNode*>(stmt))
+			statements.insert(statements.end(), inner->statements.begin(), inner->statements.end());
+		else
+			statements.push_back(stmt);
+	}
+	node.statements = arena->copy(statements);
+}
+
+void Optimizer::visit(IfNode& node) {
+	rewrite(node.condition);
+	rewriteBody(node.body);
+	if (node.elseBody)
+		rewriteBody(node.elseBody);
+
+	Value cond;
+	if (!literalValue(*node.condition, cond))
+		return;
+	counters.branchesRemoved++;
+	if (cond.isTruthy())
+		replacement = node.body;
+	else if (node.elseBody)
+		replacement = node.elseBody;
+	else
+		replacement = arena->make<BlockNode>(NodeList());
+}
+
+void Optimizer::visit(WhileNode& node) {
+	rewrite(node.condition);
+	rewriteBody(node.body);
+
+	Value cond;
+	if (literalValue(*node.condition, cond) && !cond.isTruthy()) {
+		replacement = arena->make<BlockNode>(NodeList());
+		counters.branchesRemoved++;
+	}
+}
+
+void Optimizer::visit(ForRangeNode& node) {
+	if (node.start)
+		rewrite(node.start);
+	rewrite(node.stop);
+	if (node.step)
+		rewrite(node.step);
+	rewriteBody(node.body);
+}
+
+void Optimizer::visit(ForEachNode& node) {
+	rewrite(node.iterable);
+	rewriteBody(node.body);
+}
+
+void Optimizer::visit(BreakNode&) {}
+
+void Optimizer::visit(ContinueNode&) {}
+
+void Optimizer::visit(FunctionCallNode& node) {
+	for (auto& arg : node.arguments)
+		rewrite(arg);
+}
+
+// Scoping is decided on the optimized body, so names whose assignments sit
+// only in removed branches are handed to the Resolver in prunedLocals
+void Optimizer::visit(FunctionDefNode& node) {
+	if (!node.body)
+		return;
+	std::vector<std::string_view> before, after;
+	collectAssignedNames(*node.body, before);
+	rewriteBody(node.body);
+	collectAssignedNames(*node.body, after);
+
+	std::unordered_set<std::string_view> kept(after.begin(), after.end());
+	kept.insert(node.prunedLocals.begin(), node.prunedLocals.end());
+	std::vector<std::string_view> pruned(node.prunedLocals.begin(), node.prunedLocals.end());
+	for (auto name : before)
+		if (kept.insert(name).second)
+			pruned.push_back(name);
+	if (pruned.size() != node.prunedLocals.size())
+		node.prunedLocals = arena->copy(pruned);
+}
+
+void Optimizer::visit(ReturnNode& node) {
+	if (node.value)
+		rewrite(node.value);
+}
+
+
+// Counts every node reachable from the root
+class NodeCounter : public Visitor {
+public:
+	size_t count = 0;
+
+	void visit(NumberNode&) override { count++; }
+	void visit(BinaryOpNode& node) override { count++; node.left->accept(*this); node.right->accept(*this); }
+	void visit(ComparisonChainNode& node) override {
+		count++;
+		for (auto& operand : node.operands)
+			operand->accept(*this);
+	}
+	void visit(UnaryOpNode& node) override { count++; node.factor->accept(*this); }
+	void visit(VarNode&) override { count++; }
+	void visit(AssignmentNode& node) override { count++; node.varNode->accept(*this); node.value->accept(*this); }
+	void visit(BooleanNode&) override { count++; }
+	void visit(StringNode&) override { count++; }
+	void visit(ListNode& node) override {
+		count++;
+		for (auto& element : node.elements)
+			element->accept(*this);
+	}
+	void visit(DictNode& node) override {
+		count++;
+		for (auto& item : node.items)
+			item->accept(*this);
+	}
+	void visit(IndexNode& node) override { count++; node.container->accept(*this); node.index->accept(*this); }
+	void visit(IndexAssignmentNode& node) override { count++; node.target->accept(*this); node.value->accept(*this); }
+	void visit(BlockNode& node) override {
+		count++;
+		for (auto& stmt : node.statements)
+			stmt->accept(*this);
+	}
+	void visit(IfNode& node) override {
+		count++;
+		node.condition->accept(*this);
+		node.body->accept(*this);
+		if (node.elseBody)
+			node.elseBody->accept(*this);
+	}
+	void visit(WhileNode& node) override { count++; node.condition->accept(*this); node.body->accept(*this); }
+	void visit(ForRangeNode& node) override {
+		count++;
+		node.varNode->accept(*this);
+		for (ASTNodePtr bound : { node.start, node.stop, node.step })
+			if (bound)
+				bound->accept(*this);
+		node.body->accept(*this);
+	}
+	void visit(ForEachNode& node) override {
+		count++;
+		node.varNode->accept(*this);
+		node.iterable->accept(*this);
+		node.body->accept(*this);
+	}
+	void visit(BreakNode&) override { count++; }
+	void visit(ContinueNode&) override { count++; }
+	void visit(FunctionCallNode& node) override {
+		count++;
+		for (auto& arg : node.arguments)
+			arg->accept(*this);
+	}
+	void visit(FunctionDefNode& node) override {
+		count++;
+		if (node.body)
+			node.body->accept(*this);
+	}
+	void visit(ReturnNode& node) override {
+		count++;
+		if (node.value)
+			node.value->accept(*this);
+	}
+};
+
+size_t countNodes(ASTNode& root) {
+	NodeCounter counter;
+	root.accept(counter);
+	return counter.count;
+}
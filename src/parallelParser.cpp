@@ -0,0 +1,109 @@
+#include "parallelParser.h"
+#include "parser.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+// Slots holding a lazily parsed definition, in source order. Function
+// bodies are not entered: their nested definitions were parsed with them.
+static void collectStubs(ASTNodePtr& node, std::vector<ASTNodePtr*>& stubs) {
+	if (auto def = dynamic_cast<FunctionDefNode*>(node)) {
+		if (!def->body)
+			stubs.push_back(&node);
+	}
+	else if (auto block = dynamic_cast<BlockNode*>(node)) {
+		for (auto& stmt : block->statements)
+			collectStubs(stmt, stubs);
+	}
+	else if (auto ifNode = dynamic_cast<IfNode*>(node)) {
+		collectStubs(ifNode->body, stubs);
+		if (ifNode->elseBody)
+			collectStubs(ifNode->elseBody, stubs);
+	}
+	else if (auto whileNode = dynamic_cast<WhileNode*>(node)) {
+		collectStubs(whileNode->body, stubs);
+	}
+	else if (auto forNode = dynamic_cast<ForRangeNode*>(node)) {
+		collectStubs(forNode->body, stubs);
+	}
+	else if (auto forEach = dynamic_cast<ForEachNode*>(node)) {
+		collectStubs(forEach->body, stubs);
+	}
+}
+
+static Program parseSerially(std::string_view source) {
+	Lexer lexer(source);
+	return Parser(lexer).parse();
+}
+
+Program parseParallel(std::string_view source, unsigned threads) {
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	if (threads == 1 || source.size() < kMinParallelParseBytes)
+		return parseSerially(source);
+
+	Program program;
+	try {
+		Lexer lexer(source);
+		program = Parser(lexer, true).parse();
+	}
+	catch (...) {
+		return parseSerially(source);
+	}
+
+	std::vector<ASTNodePtr*> stubs;
+	collectStubs(program.root, stubs);
+	if (stubs.empty())
+		return program;
+
+	// Consecutive definitions of about equal total size form a batch, parsed
+	// into one arena; a few batches per thread even out their run times
+	size_t batchCount = std::min<size_t>(stubs.size(), threads * 4);
+	size_t totalBytes = 0;
+	for (ASTNodePtr* stub : stubs)
+		totalBytes += static_cast<FunctionDefNode*>(*stub)->source.size();
+	std::vector<size_t> batchStart = { 0 };
+	for (size_t i = 0, bytes = 0; i < stubs.size(); i++) {
+		bytes += static_cast<FunctionDefNode*>(*stubs[i])->source.size();
+		if (bytes * batchCount >= totalBytes * batchStart.size() && i + 1 < stubs.size())
+			batchStart.push_back(i + 1);
+	}
+	batchStart.push_back(stubs.size());
+	size_t batches = batchStart.size() - 1;
+
+	std::vector<ASTNodePtr> bodies(stubs.size());
+	std::vector<std::shared_ptr<Arena>> arenas(batches);
+	std::atomic<size_t> next{ 0 };
+	std::atomic<bool> failed{ false };
+	auto work = [&] {
+		for (size_t b; !failed.load(std::memory_order_relaxed) && (b = next.fetch_add(1, std::memory_order_relaxed)) < batches;) {
+			arenas[b] = std::make_shared<Arena>();
+			try {
+				for (size_t i = batchStart[b]; i < batchStart[b + 1]; i++) {
+					Lexer lexer(static_cast<FunctionDefNode*>(*stubs[i])->source);
+					bodies[i] = Parser(lexer, false, TreeBuilder(arenas[b])).parseFunction().root;
+				}
+			}
+			catch (...) {
+				failed = true;
+			}
+		}
+	};
+	std::vector<std::thread> pool;
+	for (size_t i = 1; i < std::min<size_t>(threads, batches); i++)
+		pool.emplace_back(work);
+	work();
+	for (std::thread& thread : pool)
+		thread.join();
+	if (failed)
+		return parseSerially(source);
+
+	// Splice the bodies in; the stubs' source text stays with the first pass
+	for (size_t i = 0; i < stubs.size(); i++)
+		*stubs[i] = bodies[i];
+	for (auto& arena : arenas)
+		program.arena->adopt(std::move(arena));
+	return program;
+}
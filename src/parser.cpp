@@ -3,7 +3,10 @@
 #include <memory.h>
 #include <iostream>
 
-Parser::Parser(Lexer& lexer) : lexer(lexer) {
+template <typename Builder>
+BasicParser<Builder>::BasicParser(Lexer& lexer, bool lazyFunctions, Builder builder)
+	: lexer(lexer), lazyFunctions(lazyFunctions), build(std::move(builder)) {
+	build.reserveFor(lexer.sourceSize());
 	currentToken = lexer.getNextToken();
     // Skip initial newlines
     while (currentToken.type == TokenType::NEWLINE) {
@@ -11,7 +14,8 @@ Parser::Parser(Lexer& lexer) : lexer(lexer) {
     }
 }
 
-void Parser::eat(TokenType type) {
+template <typename Builder>
+void BasicParser<Builder>::eat(TokenType type) {
 	if (currentToken.type == type) {
 		currentToken = lexer.getNextToken();
 	}
@@ -21,28 +25,46 @@ void Parser::eat(TokenType type) {
 }
 
 // return the root of the AST (program node)
-ASTNodePtr Parser::parse() {
-	return program();
+template <typename Builder>
+typename Builder::Result BasicParser<Builder>::parse() {
+	return build.finish(program());
+}
+
+template <typename Builder>
+typename Builder::Result BasicParser<Builder>::parseFunction() {
+	Node def = function_def(false);
+	eat(TokenType::EOF_TOKEN);
+	return build.finish(def);
+}
+
+// Block of the statements pushed since `start`
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::blockFrom(size_t start) {
+	Node block = build.block(pending.data() + start, pending.size() - start);
+	pending.resize(start);
+	return block;
 }
 
 // program : statements EOF_TOKEN
-ASTNodePtr Parser::program() {
-	std::vector<ASTNodePtr> stmts = statements();
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::program() {
+	Node stmts = statements();
 	eat(TokenType::EOF_TOKEN);
-	return std::make_unique<BlockNode>(std::move(stmts));
+	return stmts;
 }
 
 // statements : ( compound_statement | simple_statement NEWLINE )*
-std::vector<ASTNodePtr> Parser::statements() {
-	std::vector<ASTNodePtr> stmts;
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::statements() {
+	size_t start = pending.size();
 
 	while (currentToken.type != TokenType::EOF_TOKEN && currentToken.type != TokenType::DEDENT) {
 		
-		if (currentToken.type == TokenType::IF || currentToken.type == TokenType::WHILE || currentToken.type == TokenType::DEF) { // add more compound statements here
-			stmts.push_back(compound_stmt());
+		if (currentToken.type == TokenType::IF || currentToken.type == TokenType::WHILE || currentToken.type == TokenType::FOR || currentToken.type == TokenType::DEF) { // add more compound statements here
+			pending.push_back(compound_stmt());
 		}
 		else {
-			stmts.push_back(simple_stmt());
+			pending.push_back(simple_stmt());
 			if (currentToken.type == TokenType::EOF_TOKEN) {
 				break;
 			}
@@ -50,11 +72,14 @@ std::vector<ASTNodePtr> Parser::statements() {
 		}
 	}
 
-	return stmts;
+	return blockFrom(start);
 }
 
-// simple_stmt : assignment_stmt | return_stmt | expr
-ASTNodePtr Parser::simple_stmt() {
+// simple_stmt : assignment_stmt | return_stmt | break_stmt | continue_stmt | index_assignment_stmt | expr
+// index_assignment_stmt : primary LSQB expr RSQB EQUAL expr, told apart from
+// an expression by the EQUAL after it
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::simple_stmt() {
 	if (currentToken.type == TokenType::NAME) {
 		if (lexer.peekNextToken().type == TokenType::EQUAL)
 			return assignment_stmt();
@@ -62,109 +87,188 @@ ASTNodePtr Parser::simple_stmt() {
 	else if (currentToken.type == TokenType::RETURN) {
 		return return_stmt();
 	}
-	return expr();
+	else if (currentToken.type == TokenType::BREAK || currentToken.type == TokenType::CONTINUE) {
+		return loop_control();
+	}
+	Node node = expr();
+	if (currentToken.type != TokenType::EQUAL)
+		return node;
+	if (!build.isIndex(node)) {
+		throw std::string("Error: cannot assign to expression");
+	}
+	eat(TokenType::EQUAL);
+	return build.indexAssignment(node, expr());
 }
 
-// compound_statement : if_statement | while_statement | function_def
-ASTNodePtr Parser::compound_stmt() {
+// compound_statement : if_statement | while_statement | for_statement | function_def
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::compound_stmt() {
 	if (currentToken.type == TokenType::WHILE)
 		return while_stmt();
+	else if (currentToken.type == TokenType::FOR)
+		return for_stmt();
 	else if (currentToken.type == TokenType::IF)
 		return if_stmt();
 	else if (currentToken.type == TokenType::DEF)
 		return function_def();
 }
 
-ASTNodePtr Parser::while_stmt() {
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::while_stmt() {
 	eat(TokenType::WHILE);
 	auto condition = expr();
 	eat(TokenType::COLON);
 	eat(TokenType::NEWLINE);
-	std::vector<ASTNodePtr> body = block();
-	return std::make_unique<WhileNode>(std::move(condition), std::make_unique<BlockNode>(std::move(body)));
+	auto body = loop_body();
+	return build.whileNode(condition, body);
+}
+
+// for_statement : FOR NAME IN (NAME LPAR expr (COMMA expr (COMMA expr)?)? RPAR | expr) COLON NEWLINE block
+// A call of range() is a counted loop: range(stop), range(start, stop) or
+// range(start, stop, step). Any other expression is iterated over.
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::for_stmt() {
+	eat(TokenType::FOR);
+	if (currentToken.type != TokenType::NAME) {
+		throw "Error: Expected loop variable after 'for', got " + tokenTypeToString(currentToken.type);
+	}
+	std::string_view varName = build.intern(currentToken.value);
+	eat(TokenType::NAME);
+	Node var = build.var(varName);
+	eat(TokenType::IN);
+	if (currentToken.type != TokenType::NAME || currentToken.value != "range" || lexer.peekNextToken().type != TokenType::LPAR) {
+		Node iterable = expr();
+		eat(TokenType::COLON);
+		eat(TokenType::NEWLINE);
+		return build.forEach(var, iterable, loop_body());
+	}
+	eat(TokenType::NAME);
+	eat(TokenType::LPAR);
+	Node args[3] = { expr(), Builder::none, Builder::none };
+	size_t argc = 1;
+	while (currentToken.type == TokenType::COMMA && argc < 3) {
+		eat(TokenType::COMMA);
+		args[argc++] = expr();
+	}
+	eat(TokenType::RPAR);
+	eat(TokenType::COLON);
+	eat(TokenType::NEWLINE);
+	auto body = loop_body();
+	if (argc == 1)
+		return build.forRange(var, Builder::none, args[0], Builder::none, body);
+	return build.forRange(var, args[0], args[1], args[2], body);
+}
+
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::loop_body() {
+	loopDepth++;
+	auto body = block();
+	loopDepth--;
+	return body;
+}
+
+// break_stmt : BREAK
+// continue_stmt : CONTINUE
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::loop_control() {
+	bool isBreak = currentToken.type == TokenType::BREAK;
+	if (loopDepth == 0) {
+		throw std::string(isBreak ? "Error: 'break' outside loop" : "Error: 'continue' not properly in loop");
+	}
+	eat(currentToken.type);
+	return isBreak ? build.breakNode() : build.continueNode();
 }
 
 // if_statement : IF expr COLON NEWLINE block
-ASTNodePtr Parser::if_stmt() {
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::if_stmt() {
 	eat(TokenType::IF);
 	auto condition = expr();
 	eat(TokenType::COLON);
 	eat(TokenType::NEWLINE);
-	std::vector<ASTNodePtr> body = block();
-	auto ifnode = std::make_unique<IfNode>(std::move(condition), std::make_unique<BlockNode>(std::move(body)), nullptr);
+	auto body = block();
 	// Handle optional elif and else
-	if (currentToken.type == TokenType::ELIF) {
-		auto elifNode = elif_stmt();
-		ifnode->elseBody = std::move(elifNode);
-	}
-	else if (currentToken.type == TokenType::ELSE) {
-		auto elseNode = else_stmt();
-		ifnode->elseBody = std::move(elseNode);
-	}
-	return ifnode;
+	Node elseBody = Builder::none;
+	if (currentToken.type == TokenType::ELIF)
+		elseBody = elif_stmt();
+	else if (currentToken.type == TokenType::ELSE)
+		elseBody = else_stmt();
+	return build.ifNode(condition, body, elseBody);
 }
 
 // elif_statement : ELIF expr COLON NEWLINE block
-ASTNodePtr Parser::elif_stmt() {
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::elif_stmt() {
 	eat(TokenType::ELIF);
 	auto condition = expr();
 	eat(TokenType::COLON);
 	eat(TokenType::NEWLINE);
-	std::vector<ASTNodePtr> body = block();
-	auto elifNode = std::make_unique<IfNode>(std::move(condition), std::make_unique<BlockNode>(std::move(body)), nullptr);
+	auto body = block();
 	// Handle optional elif and else
-	if (currentToken.type == TokenType::ELIF) {
-		auto nextElifNode = elif_stmt();
-		elifNode->elseBody = std::move(nextElifNode);
-	}
-	else if (currentToken.type == TokenType::ELSE) {
-		auto elseNode = else_stmt();
-		elifNode->elseBody = std::move(elseNode);
-	}
-	return elifNode;
+	Node elseBody = Builder::none;
+	if (currentToken.type == TokenType::ELIF)
+		elseBody = elif_stmt();
+	else if (currentToken.type == TokenType::ELSE)
+		elseBody = else_stmt();
+	return build.ifNode(condition, body, elseBody);
 }
 
 // else_statement : ELSE COLON NEWLINE block
-ASTNodePtr Parser::else_stmt() {
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::else_stmt() {
 	eat(TokenType::ELSE);
 	eat(TokenType::COLON);
 	eat(TokenType::NEWLINE);
-	std::vector<ASTNodePtr> body = block();
-	return std::make_unique<BlockNode>(std::move(body));
+	return block();
 }
 
 // function_def : DEF NAME LPAR (NAME (COMMA NAME)*)? RPAR COLON NEWLINE block
-ASTNodePtr Parser::function_def() {
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::function_def(bool allowLazy) {
+	const char* defStart = currentToken.value.data();
 	eat(TokenType::DEF);
 	if (currentToken.type != TokenType::NAME) {
 		throw "Error: Expected function name after 'def', got " + tokenTypeToString(currentToken.type);
 	}
-	std::string funcName = currentToken.value;
+	std::string_view funcName = build.intern(currentToken.value);
 	eat(TokenType::NAME);
 	eat(TokenType::LPAR);
-	std::vector<std::string> parameters;
+	std::vector<std::string_view> parameters;
 	if (currentToken.type == TokenType::NAME) {
-		parameters.push_back(currentToken.value);
+		parameters.push_back(build.intern(currentToken.value));
 		eat(TokenType::NAME);
 		while (currentToken.type == TokenType::COMMA) {
 			eat(TokenType::COMMA);
 			if (currentToken.type != TokenType::NAME) {
 				throw "Error: Expected parameter name after ',', got " + tokenTypeToString(currentToken.type);
 			}
-			parameters.push_back(currentToken.value);
+			parameters.push_back(build.intern(currentToken.value));
 			eat(TokenType::NAME);
 		}
 	}
 	eat(TokenType::RPAR);
 	eat(TokenType::COLON);
+	if constexpr (Builder::kLazyBodies) {
+		size_t bodyEnd;
+		if (allowLazy && lazyFunctions && currentToken.type == TokenType::NEWLINE && lexer.skipBlock(bodyEnd)) {
+			currentToken = lexer.getNextToken();
+			size_t defOffset = defStart - lexer.source().data();
+			std::string_view source = lexer.source().substr(defOffset, bodyEnd - defOffset);
+			return build.lazyFunctionDef(funcName, parameters.data(), parameters.size(), source);
+		}
+	}
 	eat(TokenType::NEWLINE);
-	std::vector<ASTNodePtr> body = block();
+	uint32_t enclosingLoops = loopDepth; // break and continue do not reach out of a function
+	loopDepth = 0;
+	auto body = block();
+	loopDepth = enclosingLoops;
 
-	return std::make_unique<FunctionDefNode>(funcName, parameters, std::make_unique<BlockNode>(std::move(body)));
+	return build.functionDef(funcName, parameters.data(), parameters.size(), body);
 }
 
 // block : INDENT statements DEDENT
-std::vector<ASTNodePtr> Parser::block() {
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::block() {
 	eat(TokenType::INDENT);
 	auto stmts = statements();
 	eat(TokenType::DEDENT);
@@ -172,48 +276,54 @@ std::vector<ASTNodePtr> Parser::block() {
 }
 
 // assignment_stmt : NAME EQUAL expr
-ASTNodePtr Parser::assignment_stmt() {
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::assignment_stmt() {
 	if (currentToken.type == TokenType::NAME) {
-		std::string varName = currentToken.value;
+		std::string_view varName = build.intern(currentToken.value);
 		eat(TokenType::NAME);
 		eat(TokenType::EQUAL);
-		// ASTNodePtr valueNode
-		// For now, we do not implement variable storage, return value of expr
-		return std::make_unique<AssignmentNode>(std::make_unique<VarNode>(varName), expr());
+		Node var = build.var(varName);
+		return build.assignment(var, expr());
 	}
-	throw "Error: Invalid assignment statement, expected IDENTIFIER, got " + static_cast<int>(currentToken.type);
+	throw "Error: Invalid assignment statement, expected IDENTIFIER, got " + tokenTypeToString(currentToken.type);
 }
 
 
-ASTNodePtr Parser::function_call(std::string func_name) {
-	// Not implemented yet
-	std::vector<ASTNodePtr> args;
+// A method call receiver.name(args) is the call name(receiver, args)
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::function_call(std::string_view func_name, Node receiver) {
+	size_t start = pending.size();
+	if (receiver != Builder::none)
+		pending.push_back(receiver);
 	eat(TokenType::LPAR);
 	if (currentToken.type != TokenType::RPAR) {
-		// Parse arguments (not implemented yet)
-		args.push_back(expr());
+		pending.push_back(expr());
 		while (currentToken.type == TokenType::COMMA) {
 			eat(TokenType::COMMA);
-			args.push_back(expr());
+			pending.push_back(expr());
 		}
 	}
 	eat(TokenType::RPAR);
 
-	return std::make_unique<FunctionCallNode>(func_name, std::move(args));
+	Node call = build.call(func_name, pending.data() + start, pending.size() - start);
+	pending.resize(start);
+	return call;
 }
 
-ASTNodePtr Parser::return_stmt() {
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::return_stmt() {
 	eat(TokenType::RETURN);
 	if (currentToken.type == TokenType::NEWLINE) {
 		// return without value
-		return std::make_unique<ReturnNode>(nullptr);
+		return build.returnNode(Builder::none);
 	}
-	return std::make_unique<ReturnNode>(expr());
+	return build.returnNode(expr());
 }
 
 
 // expr : disjunction | disjunction (IF disjunction ELSE expr)?
-ASTNodePtr Parser::expr() {
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::expr() {
 	auto defaultExpr = disjunction();
 	if (currentToken.type == TokenType::IF) {
 		eat(TokenType::IF);
@@ -221,150 +331,202 @@ ASTNodePtr Parser::expr() {
 		eat(TokenType::ELSE);
 		auto elseExpr = expr();
 
-		std::vector<ASTNodePtr> b;
-		b.push_back(std::move(defaultExpr));
-
-		std::vector<ASTNodePtr> eb;
-		eb.push_back(std::move(elseExpr));
-
-		return std::make_unique<IfNode>(
-			std::move(conditionExpr),
-			std::make_unique<BlockNode>(std::move(b)),
-			std::make_unique<BlockNode>(std::move(eb))
+		return build.ifNode(
+			conditionExpr,
+			build.block(&defaultExpr, 1),
+			build.block(&elseExpr, 1)
 		);
 	}
 	return defaultExpr;
 }
 
 
+// Operator a binary operator token stands for
+static BinaryOp binaryOpFor(TokenType type) {
+	switch (type) {
+		case TokenType::PLUS: return BinaryOp::Add;
+		case TokenType::MINUS: return BinaryOp::Sub;
+		case TokenType::MUL: return BinaryOp::Mul;
+		case TokenType::DIV: return BinaryOp::Div;
+		case TokenType::DOUBLESLASH: return BinaryOp::FloorDiv;
+		case TokenType::PERCENT: return BinaryOp::Mod;
+		case TokenType::EQEQUAL: return BinaryOp::Equal;
+		case TokenType::NOTEQUAL: return BinaryOp::NotEqual;
+		case TokenType::LESS: return BinaryOp::Less;
+		case TokenType::LESSEQUAL: return BinaryOp::LessEqual;
+		case TokenType::GREATER: return BinaryOp::Greater;
+		case TokenType::GREATEREQUAL: return BinaryOp::GreaterEqual;
+		case TokenType::AND: return BinaryOp::And;
+		case TokenType::OR: return BinaryOp::Or;
+		case TokenType::IN: return BinaryOp::In;
+		default: throw "Error: " + tokenTypeToString(type) + " is not a binary operator";
+	}
+}
+
 // disjunction: conjunction ( OR conjunction )*
-ASTNodePtr Parser::disjunction() {
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::disjunction() {
 	auto node = conjunction();
 	if(currentToken.type == TokenType::OR) {
-		std::string op = currentToken.value;
 		eat(TokenType::OR);
-		node = std::make_unique<BinaryOpNode>(std::move(node), op, disjunction());
+		node = build.binary(node, BinaryOp::Or, disjunction());
 	}
 	return node;
 }
 
 // conjunction: inversion ( AND inversion )*
-ASTNodePtr Parser::conjunction() {
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::conjunction() {
 	auto node = inversion();
 	if(currentToken.type == TokenType::AND) {
-		std::string op = currentToken.value;
 		eat(TokenType::AND);
-		node = std::make_unique<BinaryOpNode>(std::move(node), op, conjunction());
+		node = build.binary(node, BinaryOp::And, conjunction());
 	}
 	return node;
 }
 
 // inversion: not* comparison
-ASTNodePtr Parser::inversion() {
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::inversion() {
 	if (currentToken.type == TokenType::NOT) {
-		std::string op = currentToken.value;
 		eat(TokenType::NOT);
-		return std::make_unique<UnaryOpNode>(op, inversion());
+		return build.unary(UnaryOp::Not, inversion());
 	}
 	return comparison();
 }
 
-// comparison: arith_expr((EQEQUAL | NOTEQUAL | LESSEQUAL | GREATEREQUAL | LESS | GREATER) arith_expr)*
-ASTNodePtr Parser::comparison() {
-	auto node = arith_expr();
-	while (currentToken.type == TokenType::LESS || currentToken.type == TokenType::LESSEQUAL ||
-		currentToken.type == TokenType::GREATER || currentToken.type == TokenType::GREATEREQUAL ||
-		currentToken.type == TokenType::EQEQUAL || currentToken.type == TokenType::NOTEQUAL) {
+// comparison: arith_expr((EQEQUAL | NOTEQUAL | LESSEQUAL | GREATEREQUAL | LESS | GREATER | IN | NOT IN) arith_expr)*
+// a < b < c means a < b and b < c with b evaluated once, so a chain of two
+// or more comparisons becomes one node
+static bool isComparison(TokenType type) {
+	return type == TokenType::LESS || type == TokenType::LESSEQUAL ||
+		type == TokenType::GREATER || type == TokenType::GREATEREQUAL ||
+		type == TokenType::EQEQUAL || type == TokenType::NOTEQUAL ||
+		type == TokenType::IN || type == TokenType::NOT; // NOT IN, after an operand
+}
 
-		std::string op = currentToken.value;
-		if (currentToken.type == TokenType::LESS) {
-			eat(TokenType::LESS);
-		}
-		else if (currentToken.type == TokenType::LESSEQUAL) {
-			eat(TokenType::LESSEQUAL);
-		}
-		else if (currentToken.type == TokenType::GREATER) {
-			eat(TokenType::GREATER);
-		}
-		else if (currentToken.type == TokenType::GREATEREQUAL) {
-			eat(TokenType::GREATEREQUAL);
-		}
-		else if (currentToken.type == TokenType::EQEQUAL) {
-			eat(TokenType::EQEQUAL);
-		}
-		else if (currentToken.type == TokenType::NOTEQUAL) {
-			eat(TokenType::NOTEQUAL);
-		}
-		node = std::make_unique<BinaryOpNode>(std::move(node), op, arith_expr());
+// Eats the operator isComparison() saw, `not in` being two tokens
+template <typename Builder>
+BinaryOp BasicParser<Builder>::comparisonOperator() {
+	if (currentToken.type == TokenType::NOT) {
+		eat(TokenType::NOT);
+		eat(TokenType::IN);
+		return BinaryOp::NotIn;
 	}
-	return node;
+	BinaryOp op = binaryOpFor(currentToken.type);
+	eat(currentToken.type);
+	return op;
+}
+
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::comparison() {
+	auto node = arith_expr();
+	if (!isComparison(currentToken.type))
+		return node;
+	BinaryOp op = comparisonOperator();
+	auto right = arith_expr();
+	if (!isComparison(currentToken.type))
+		return build.binary(node, op, right);
+
+	size_t start = pending.size();
+	std::vector<BinaryOp> ops = { op };
+	pending.push_back(node);
+	pending.push_back(right);
+	while (isComparison(currentToken.type)) {
+		ops.push_back(comparisonOperator());
+		Node operand = arith_expr();
+		pending.push_back(operand);
+	}
+	Node chain = build.comparisonChain(pending.data() + start, ops.data(), ops.size());
+	pending.resize(start);
+	return chain;
 }
 
 // arith_expr : term ( (PLUS | MINUS) term)*
-ASTNodePtr Parser::arith_expr() {
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::arith_expr() {
 
 	auto node = term();
 	while (currentToken.type == TokenType::PLUS || currentToken.type == TokenType::MINUS) {
-		std::string op = currentToken.value;
-		if (currentToken.type == TokenType::PLUS) {
-			eat(TokenType::PLUS);
-		}
-		else if (currentToken.type == TokenType::MINUS) {
-			eat(TokenType::MINUS);
-		}
-		node = std::make_unique<BinaryOpNode>(std::move(node), op, term());
+		BinaryOp op = binaryOpFor(currentToken.type);
+		eat(currentToken.type);
+		node = build.binary(node, op, term());
 	}
 	return node;
 
 }
 
-// term : factor ( (MUL | DIV | PERCENT) factor)*
-ASTNodePtr Parser::term() {
-	ASTNodePtr node = factor();
-	while (currentToken.type == TokenType::MUL || currentToken.type == TokenType::DIV || currentToken.type == TokenType::PERCENT) {
-		std::string op = currentToken.value;
-		if (currentToken.type == TokenType::MUL) {
-			eat(TokenType::MUL);
-		}
-		else if (currentToken.type == TokenType::DIV) {
-			eat(TokenType::DIV);
-		}
-		else if (currentToken.type == TokenType::PERCENT) {
-			eat(TokenType::PERCENT);
-		}
-		node = std::make_unique<BinaryOpNode>(std::move(node), op, factor());
+// term : factor ( (MUL | DIV | DOUBLESLASH | PERCENT) factor)*
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::term() {
+	Node node = factor();
+	while (currentToken.type == TokenType::MUL || currentToken.type == TokenType::DIV ||
+		currentToken.type == TokenType::DOUBLESLASH || currentToken.type == TokenType::PERCENT) {
+		BinaryOp op = binaryOpFor(currentToken.type);
+		eat(currentToken.type);
+		node = build.binary(node, op, factor());
 	}
 	return node;
 
 }
 
-// factor : (PLUS | NIMUS)? factor | NUMBER | LPAR expr RPAR | NAME | BOOLEAN | STRING | function_call
-ASTNodePtr Parser::factor() {
+// factor : (PLUS | MINUS) factor | primary
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::factor() {
 	if (currentToken.type == TokenType::PLUS) {
-		std::string op = currentToken.value;
 		eat(TokenType::PLUS);
-		return std::make_unique<UnaryOpNode>(op, factor());
+		return build.unary(UnaryOp::Plus, factor());
 	}
 	if (currentToken.type == TokenType::MINUS) {
-		std::string op = currentToken.value;
 		eat(TokenType::MINUS);
-		return std::make_unique<UnaryOpNode>(op, factor());
+		return build.unary(UnaryOp::Minus, factor());
+	}
+	return primary();
+}
+
+// primary : atom ( LSQB expr RSQB | DOT NAME LPAR (expr (COMMA expr)*)? RPAR )*
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::primary() {
+	Node node = atom();
+	while (true) {
+		if (currentToken.type == TokenType::LSQB) {
+			eat(TokenType::LSQB);
+			Node index = expr();
+			eat(TokenType::RSQB);
+			node = build.index(node, index);
+		}
+		else if (currentToken.type == TokenType::DOT) {
+			eat(TokenType::DOT);
+			if (currentToken.type != TokenType::NAME) {
+				throw "Error: Expected method name after '.', got " + tokenTypeToString(currentToken.type);
+			}
+			std::string_view name = build.intern(currentToken.value);
+			eat(TokenType::NAME);
+			node = function_call(name, node);
+		}
+		else {
+			return node;
+		}
 	}
+}
+
+// atom : NUMBER | LPAR expr RPAR | NAME | BOOLEAN | STRING | function_call | list_display | dict_display
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::atom() {
 	if (currentToken.type == TokenType::NUMBER) {
-		auto node = std::make_unique<NumberNode>(currentToken.value);
+		auto node = build.number(currentToken);
 		eat(TokenType::NUMBER);
 		return node;
 	}
 	if (currentToken.type == TokenType::NAME) {
-		std::string name = currentToken.value;
+		std::string_view name = build.intern(currentToken.value);
 		eat(TokenType::NAME);
 		// Check for function call
 		if (currentToken.type == TokenType::LPAR) {
 			
 			return function_call(name);
 		}
-		auto node = std::make_unique<VarNode>(name);
-		return node;
+		return build.var(name);
 	}
 	if (currentToken.type == TokenType::LPAR) {
 		eat(TokenType::LPAR);
@@ -372,16 +534,64 @@ ASTNodePtr Parser::factor() {
 		eat(TokenType::RPAR);
 		return node;
 	}
+	if (currentToken.type == TokenType::LSQB) {
+		return list_display();
+	}
+	if (currentToken.type == TokenType::LBRACE) {
+		return dict_display();
+	}
 	if (currentToken.type == TokenType::BOOLEAN) {
-		auto node = std::make_unique<BooleanNode>(currentToken.value);
+		auto node = build.boolean(currentToken.value == "True");
 		eat(TokenType::BOOLEAN);
 		return node;
 	}
 	if (currentToken.type == TokenType::STRING) {
-		auto node = std::make_unique<StringNode>(currentToken.value);
+		auto node = build.string(build.intern(currentToken.value));
 		eat(TokenType::STRING);
 		return node;
 	}
 
-	throw "Error: Invalide factor, got " + static_cast<int>(currentToken.type);
+	throw "Error: Invalid factor, got " + tokenTypeToString(currentToken.type);
 }
+
+// list_display : LSQB (expr (COMMA expr)* COMMA?)? RSQB
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::list_display() {
+	size_t start = pending.size();
+	eat(TokenType::LSQB);
+	while (currentToken.type != TokenType::RSQB) {
+		pending.push_back(expr());
+		if (currentToken.type != TokenType::COMMA)
+			break;
+		eat(TokenType::COMMA);
+	}
+	eat(TokenType::RSQB);
+
+	Node list = build.list(pending.data() + start, pending.size() - start);
+	pending.resize(start);
+	return list;
+}
+
+// dict_display : LBRACE (expr COLON expr (COMMA expr COLON expr)* COMMA?)? RBRACE
+template <typename Builder>
+typename BasicParser<Builder>::Node BasicParser<Builder>::dict_display() {
+	size_t start = pending.size();
+	eat(TokenType::LBRACE);
+	while (currentToken.type != TokenType::RBRACE) {
+		pending.push_back(expr());
+		eat(TokenType::COLON);
+		pending.push_back(expr());
+		if (currentToken.type != TokenType::COMMA)
+			break;
+		eat(TokenType::COMMA);
+	}
+	eat(TokenType::RBRACE);
+
+	Node dict = build.dict(pending.data() + start, (pending.size() - start) / 2);
+	pending.resize(start);
+	return dict;
+}
+
+
+template class BasicParser<TreeBuilder>;
+template class BasicParser<FlatBuilder>;
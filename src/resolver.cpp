@@ -0,0 +1,355 @@
+#include "resolver.h"
+
+
+uint32_t GlobalScope::slotFor(std::string_view name) {
+	std::string key(name);
+	auto it = slots.find(key);
+	if (it != slots.end())
+		return it->second;
+	uint32_t slot = static_cast<uint32_t>(names.size());
+	names.push_back(key);
+	slots.emplace(std::move(key), slot);
+	return slot;
+}
+
+
+void Resolver::resolve(ASTNode& program) {
+	function = nullptr;
+	locals.clear();
+	program.accept(*this);
+}
+
+void Resolver::declareLocal(std::string_view name) {
+	if (locals.find(name) != locals.end())
+		return;
+	locals[name] = static_cast<uint32_t>(localNames.size());
+	localNames.push_back(name);
+}
+
+void collectAssignedNames(ASTNode& node, std::vector<std::string_view>& names) {
+	if (auto assign = dynamic_cast<AssignmentNode*>(&node)) {
+		names.push_back(static_cast<VarNode&>(*assign->varNode).name);
+	}
+	else if (auto block = dynamic_cast<BlockNode*>(&node)) {
+		for (auto& stmt : block->statements)
+			collectAssignedNames(*stmt, names);
+	}
+	else if (auto ifNode = dynamic_cast<IfNode*>(&node)) {
+		collectAssignedNames(*ifNode->body, names);
+		if (ifNode->elseBody)
+			collectAssignedNames(*ifNode->elseBody, names);
+	}
+	else if (auto whileNode = dynamic_cast<WhileNode*>(&node)) {
+		collectAssignedNames(*whileNode->body, names);
+	}
+	else if (auto forNode = dynamic_cast<ForRangeNode*>(&node)) {
+		names.push_back(static_cast<VarNode&>(*forNode->varNode).name);
+		collectAssignedNames(*forNode->body, names);
+	}
+	else if (auto forEach = dynamic_cast<ForEachNode*>(&node)) {
+		names.push_back(static_cast<VarNode&>(*forEach->varNode).name);
+		collectAssignedNames(*forEach->body, names);
+	}
+}
+
+
+void Resolver::visit(NumberNode&) {}
+
+void Resolver::visit(BinaryOpNode& node) {
+	node.left->accept(*this);
+	node.right->accept(*this);
+}
+
+void Resolver::visit(ComparisonChainNode& node) {
+	for (auto& operand : node.operands)
+		operand->accept(*this);
+}
+
+void Resolver::visit(UnaryOpNode& node) {
+	node.factor->accept(*this);
+}
+
+void Resolver::visit(VarNode& node) {
+	if (function) {
+		auto it = locals.find(node.name);
+		if (it != locals.end()) {
+			node.scope = VarScope::Local;
+			node.slot = it->second;
+			return;
+		}
+	}
+	node.scope = VarScope::Global;
+	node.slot = globals.slotFor(node.name);
+}
+
+void Resolver::visit(AssignmentNode& node) {
+	node.value->accept(*this);
+	node.varNode->accept(*this);
+}
+
+void Resolver::visit(BooleanNode&) {}
+
+void Resolver::visit(StringNode&) {}
+
+void Resolver::visit(ListNode& node) {
+	for (auto& element : node.elements)
+		element->accept(*this);
+}
+
+void Resolver::visit(DictNode& node) {
+	for (auto& item : node.items)
+		item->accept(*this);
+}
+
+void Resolver::visit(IndexNode& node) {
+	node.container->accept(*this);
+	node.index->accept(*this);
+}
+
+// xs[i] = v assigns no name, xs is looked up like any other use
+void Resolver::visit(IndexAssignmentNode& node) {
+	node.value->accept(*this);
+	node.target->accept(*this);
+}
+
+void Resolver::visit(BlockNode& node) {
+	for (auto& stmt : node.statements)
+		stmt->accept(*this);
+}
+
+void Resolver::visit(IfNode& node) {
+	node.condition->accept(*this);
+	node.body->accept(*this);
+	if (node.elseBody)
+		node.elseBody->accept(*this);
+}
+
+void Resolver::visit(WhileNode& node) {
+	node.condition->accept(*this);
+	node.body->accept(*this);
+}
+
+void Resolver::visit(ForRangeNode& node) {
+	if (node.start)
+		node.start->accept(*this);
+	node.stop->accept(*this);
+	if (node.step)
+		node.step->accept(*this);
+	node.varNode->accept(*this);
+	node.body->accept(*this);
+}
+
+void Resolver::visit(ForEachNode& node) {
+	node.iterable->accept(*this);
+	node.varNode->accept(*this);
+	node.body->accept(*this);
+}
+
+void Resolver::visit(BreakNode&) {}
+
+void Resolver::visit(ContinueNode&) {}
+
+void Resolver::visit(FunctionCallNode& node) {
+	for (auto& arg : node.arguments)
+		arg->accept(*this);
+}
+
+void Resolver::visit(FunctionDefNode& node) {
+	if (!node.body)
+		return; // resolved once parsed, on the first call
+	FunctionDefNode* enclosing = function;
+	auto enclosingLocals = std::move(locals);
+	auto enclosingNames = std::move(localNames);
+
+	function = &node;
+	locals.clear();
+	localNames.clear();
+	for (auto param : node.parameters) { // arguments land in the first slots
+		locals[param] = static_cast<uint32_t>(localNames.size());
+		localNames.push_back(param);
+	}
+	// Every name assigned anywhere in the body is local, also where the
+	// Optimizer removed the assignment
+	std::vector<std::string_view> assigned;
+	collectAssignedNames(*node.body, assigned);
+	for (auto name : assigned)
+		declareLocal(name);
+	for (auto name : node.prunedLocals)
+		declareLocal(name);
+	node.localNames = arena.copy(localNames);
+	node.body->accept(*this);
+
+	function = enclosing;
+	locals = std::move(enclosingLocals);
+	localNames = std::move(enclosingNames);
+}
+
+void Resolver::visit(ReturnNode& node) {
+	if (node.value)
+		node.value->accept(*this);
+}
+
+
+namespace {
+
+struct FlatResolver {
+	FlatAst& ast;
+	GlobalScope& globals;
+	bool inFunction = false;
+	std::unordered_map<uint32_t, uint32_t> locals; // name index -> slot
+	std::vector<uint32_t> localNames;			 // name indices, parameters first
+
+	FlatResolver(FlatAst& ast, GlobalScope& globals) : ast(ast), globals(globals) {}
+
+	void declareLocal(uint32_t name) {
+		if (locals.find(name) != locals.end())
+			return;
+		locals[name] = static_cast<uint32_t>(localNames.size());
+		localNames.push_back(name);
+	}
+
+	void declareAssigned(FlatIndex node) {
+		switch (ast.kind(node)) {
+			case FlatKind::Assignment:
+				declareLocal(ast.a[ast.a[node]]);
+				break;
+			case FlatKind::Block:
+				for (uint32_t i = 0; i < ast.b[node]; i++)
+					declareAssigned(ast.lists[ast.a[node] + i]);
+				break;
+			case FlatKind::If:
+				declareAssigned(ast.lists[ast.b[node]]);
+				if (ast.lists[ast.b[node] + 1] != kNoNode)
+					declareAssigned(ast.lists[ast.b[node] + 1]);
+				break;
+			case FlatKind::While:
+				declareAssigned(ast.b[node]);
+				break;
+			case FlatKind::ForRange:
+				declareLocal(ast.a[ast.a[node]]);
+				declareAssigned(ast.lists[ast.b[node] + 3]);
+				break;
+			case FlatKind::ForEach:
+				declareLocal(ast.a[ast.a[node]]);
+				declareAssigned(ast.lists[ast.b[node] + 1]);
+				break;
+			default: // nested function definitions get their own scope
+				break;
+		}
+	}
+
+	void resolve(FlatIndex node) {
+		switch (ast.kind(node)) {
+			case FlatKind::BinaryOp:
+				resolve(ast.a[node]);
+				resolve(ast.b[node]);
+				break;
+			case FlatKind::ComparisonChain:
+				for (uint32_t i = 0; i <= ast.b[node]; i++)
+					resolve(ast.lists[ast.a[node] + 2 * i]);
+				break;
+			case FlatKind::UnaryOp:
+				resolve(ast.a[node]);
+				break;
+			case FlatKind::Var: {
+				auto it = inFunction ? locals.find(ast.a[node]) : locals.end();
+				if (it != locals.end()) {
+					ast.ops[node] = static_cast<uint8_t>(VarScope::Local);
+					ast.b[node] = it->second;
+				}
+				else {
+					ast.ops[node] = static_cast<uint8_t>(VarScope::Global);
+					ast.b[node] = globals.slotFor(ast.name(node));
+				}
+				break;
+			}
+			case FlatKind::Assignment:
+				resolve(ast.b[node]);
+				resolve(ast.a[node]);
+				break;
+			case FlatKind::Block:
+			case FlatKind::List:
+				for (uint32_t i = 0; i < ast.b[node]; i++)
+					resolve(ast.lists[ast.a[node] + i]);
+				break;
+			case FlatKind::Dict:
+				for (uint32_t i = 0; i < 2 * ast.b[node]; i++)
+					resolve(ast.lists[ast.a[node] + i]);
+				break;
+			case FlatKind::Index:
+				resolve(ast.a[node]);
+				resolve(ast.b[node]);
+				break;
+			case FlatKind::IndexAssignment:
+				resolve(ast.b[node]);
+				resolve(ast.a[node]);
+				break;
+			case FlatKind::If:
+				resolve(ast.a[node]);
+				resolve(ast.lists[ast.b[node]]);
+				if (ast.lists[ast.b[node] + 1] != kNoNode)
+					resolve(ast.lists[ast.b[node] + 1]);
+				break;
+			case FlatKind::While:
+				resolve(ast.a[node]);
+				resolve(ast.b[node]);
+				break;
+			case FlatKind::ForRange:
+				for (uint32_t i = 0; i < 4; i++) // start, stop, step, body
+					if (ast.lists[ast.b[node] + i] != kNoNode)
+						resolve(ast.lists[ast.b[node] + i]);
+				resolve(ast.a[node]);
+				break;
+			case FlatKind::ForEach:
+				resolve(ast.lists[ast.b[node]]);
+				resolve(ast.a[node]);
+				resolve(ast.lists[ast.b[node] + 1]);
+				break;
+			case FlatKind::FunctionCall:
+				for (uint32_t i = 1; i <= ast.lists[ast.b[node]]; i++)
+					resolve(ast.lists[ast.b[node] + i]);
+				break;
+			case FlatKind::FunctionDef:
+				resolveFunction(node);
+				break;
+			case FlatKind::Return:
+				if (ast.a[node] != kNoNode)
+					resolve(ast.a[node]);
+				break;
+			default: // literals
+				break;
+		}
+	}
+
+	void resolveFunction(FlatIndex node) {
+		bool enclosing = inFunction;
+		auto enclosingLocals = std::move(locals);
+		auto enclosingNames = std::move(localNames);
+
+		inFunction = true;
+		locals.clear();
+		localNames.clear();
+		FlatFunction& function = ast.functions[ast.b[node]];
+		for (uint32_t i = 0; i < function.paramCount; i++) { // arguments land in the first slots
+			uint32_t param = ast.lists[function.params + i];
+			locals[param] = static_cast<uint32_t>(localNames.size());
+			localNames.push_back(param);
+		}
+		declareAssigned(function.body);
+		function.locals = static_cast<uint32_t>(ast.localNames.size());
+		function.localCount = static_cast<uint32_t>(localNames.size());
+		ast.localNames.insert(ast.localNames.end(), localNames.begin(), localNames.end());
+		resolve(function.body);
+
+		inFunction = enclosing;
+		locals = std::move(enclosingLocals);
+		localNames = std::move(enclosingNames);
+	}
+};
+
+}
+
+void resolveFlat(FlatAst& ast, GlobalScope& globals) {
+	if (ast.root != kNoNode)
+		FlatResolver{ ast, globals }.resolve(ast.root);
+}
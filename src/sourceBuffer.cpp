@@ -0,0 +1,152 @@
+#include "sourceBuffer.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+SourceBuffer::SourceBuffer(SourceBuffer&& other) noexcept
+	: mapped(std::exchange(other.mapped, {})), owned(std::move(other.owned)) {
+#ifdef _WIN32
+	mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#endif
+}
+
+SourceBuffer& SourceBuffer::operator=(SourceBuffer&& other) noexcept {
+	if (this != &other) {
+		unmap();
+		mapped = std::exchange(other.mapped, {});
+		owned = std::move(other.owned);
+#ifdef _WIN32
+		mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#endif
+	}
+	return *this;
+}
+
+SourceBuffer::~SourceBuffer() {
+	unmap();
+}
+
+#ifdef _WIN32
+
+void SourceBuffer::unmap() {
+	if (mapped.data())
+		UnmapViewOfFile(mapped.data());
+	if (mappingHandle)
+		CloseHandle(mappingHandle);
+	mapped = {};
+	mappingHandle = nullptr;
+}
+
+SourceBuffer SourceBuffer::fromFile(const std::string& path) {
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Cannot open '" + path + "'");
+	SourceBuffer buffer;
+	LARGE_INTEGER size;
+	if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (view) {
+			buffer.mapped = std::string_view(static_cast<const char*>(view), static_cast<size_t>(size.QuadPart));
+			buffer.mappingHandle = mapping;
+			CloseHandle(file);
+			return buffer;
+		}
+		if (mapping)
+			CloseHandle(mapping);
+	}
+	// Not mappable: read it all
+	char chunk[1 << 16];
+	DWORD got;
+	while (ReadFile(file, chunk, sizeof(chunk), &got, nullptr) && got > 0)
+		buffer.owned.append(chunk, got);
+	CloseHandle(file);
+	return buffer;
+}
+
+#else
+
+void SourceBuffer::unmap() {
+	if (mapped.data())
+		munmap(const_cast<char*>(mapped.data()), mapped.size());
+	mapped = {};
+}
+
+// Read until end of file, growing geometrically. `sizeHint` is the file
+// size when known, so a regular file is read with a single allocation.
+static std::string readAll(int fd, size_t sizeHint, const std::string& path) {
+	std::string text;
+	text.resize(sizeHint > 0 ? sizeHint + 1 : 1 << 16);
+	size_t used = 0;
+	while (true) {
+		if (used == text.size())
+			text.resize(text.size() * 2);
+		ssize_t got = read(fd, &text[used], text.size() - used);
+		if (got == 0)
+			break;
+		if (got < 0) {
+			if (errno == EINTR)
+				continue;
+			throw std::runtime_error("Cannot read '" + path + "': " + std::strerror(errno));
+		}
+		used += static_cast<size_t>(got);
+	}
+	text.resize(used);
+	return text;
+}
+
+SourceBuffer SourceBuffer::fromFile(const std::string& path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error("Cannot open '" + path + "': " + std::strerror(errno));
+	SourceBuffer buffer;
+	struct stat info;
+	bool regular = fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+	if (regular && info.st_size > 0) {
+		void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view != MAP_FAILED) {
+			madvise(view, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL); // the lexer reads it front to back
+			buffer.mapped = std::string_view(static_cast<const char*>(view), static_cast<size_t>(info.st_size));
+			close(fd);
+			return buffer;
+		}
+	}
+	try {
+		buffer.owned = readAll(fd, regular ? static_cast<size_t>(info.st_size) : 0, path);
+	}
+	catch (...) {
+		close(fd);
+		throw;
+	}
+	close(fd);
+	return buffer;
+}
+
+#endif
+
+SourceBuffer SourceBuffer::fromStdin() {
+#ifdef _WIN32
+	std::string text;
+	char chunk[1 << 16];
+	size_t got;
+	while ((got = std::fread(chunk, 1, sizeof(chunk), stdin)) > 0)
+		text.append(chunk, got);
+	return SourceBuffer(std::move(text));
+#else
+	return SourceBuffer(readAll(STDIN_FILENO, 0, "<stdin>"));
+#endif
+}
@@ -0,0 +1,78 @@
+#include "statementReader.h"
+#include "charScan.h"
+#include <algorithm>
+
+
+static bool isBlank(std::string_view line) {
+	return line.find_first_not_of(" \t\r\n\v\f") == std::string_view::npos;
+}
+
+static bool startsWithKeyword(std::string_view line, std::string_view keyword) {
+	return line.substr(0, keyword.size()) == keyword &&
+		(line.size() == keyword.size() || !isIdentifierChar(line[keyword.size()]));
+}
+
+static bool startsStatement(std::string_view line) {
+	if (line[0] == ' ' || isBlank(line))
+		return false;
+	return !startsWithKeyword(line, "elif") && !startsWithKeyword(line, "else");
+}
+
+bool StatementSplitter::endsStatement(std::string_view line) const {
+	return !insideString && haveStatement && startsStatement(line);
+}
+
+void StatementSplitter::add(std::string_view line) {
+	if (insideString || !isBlank(line))
+		haveStatement = true;
+	if (std::count(line.begin(), line.end(), '"') % 2)
+		insideString = !insideString;
+}
+
+
+StatementReader::StatementReader(std::istream& in, size_t chunkSize) : in(in), chunkSize(chunkSize) {}
+
+// Drop what was handed out already, then append a chunk
+void StatementReader::fill() {
+	buffer.erase(0, consumed);
+	scanPos -= consumed;
+	consumed = 0;
+
+	size_t used = buffer.size();
+	buffer.resize(used + chunkSize);
+	in.read(&buffer[used], static_cast<std::streamsize>(chunkSize));
+	size_t got = static_cast<size_t>(in.gcount());
+	buffer.resize(used + got);
+	if (got == 0)
+		eof = true;
+}
+
+bool StatementReader::next(std::string_view& statement) {
+	while (true) {
+		size_t newline = buffer.find('\n', scanPos);
+		if (newline == std::string::npos && !eof) {
+			fill();
+			continue;
+		}
+
+		size_t end = scanPos;
+		if (scanPos < buffer.size()) {
+			size_t lineEnd = newline == std::string::npos ? buffer.size() : newline + 1;
+			std::string_view line(buffer.data() + scanPos, lineEnd - scanPos);
+			if (!splitter.endsStatement(line)) {
+				splitter.add(line);
+				scanPos = lineEnd;
+				continue;
+			}
+			// `line` begins the next statement
+		}
+		else if (!splitter.hasStatement()) {
+			return false; // end of input, at most blank lines left
+		}
+
+		statement = std::string_view(buffer.data() + consumed, end - consumed);
+		consumed = end;
+		splitter.finishStatement();
+		return true;
+	}
+}
@@ -1,60 +1,139 @@
 #include "value.h"
+#include "dict.h"
+#include "list.h"
+#include "swissMap.h"
 #include <cmath>
+#include <cstdio>
+#include <functional>
 
 // Constructors
-Value::Value() : data(0.0) {}
-Value::Value(double d) : data(d) {}
-Value::Value(bool b) : data(b) {}
-Value::Value(const std::string& s) : data(s) {}
-Value::Value(const char* s) : data(std::string(s)) {}
+Value::Value(const std::string& s) : Value(new StringObject(s)) {}
+Value::Value(std::string&& s) : Value(new StringObject(std::move(s))) {}
+Value::Value(const char* s) : Value(new StringObject(s)) {}
+Value::Value(std::string_view s) : Value(new StringObject(std::string(s))) {}
+Value::Value(ListObject* list) : Value(static_cast<Object*>(list)) {}
+Value::Value(DictObject* dict) : Value(static_cast<Object*>(dict)) {}
 
-// Type checking
-bool Value::isNumber() const { return std::holds_alternative<double>(data); }
-bool Value::isBool() const { return std::holds_alternative<bool>(data); }
-bool Value::isString() const { return std::holds_alternative<std::string>(data); }
+uint64_t StringObject::hashString(std::string_view s) {
+    return std::hash<std::string_view>()(s);
+}
 
-// Type accessors with error checking
-double Value::asNumber() const {
-    if (auto* val = std::get_if<double>(&data)) return *val;
-    if (auto* val = std::get_if<bool>(&data)) return *val ? 1.0 : 0.0;
-    throw std::runtime_error("Value is not a number");
+namespace {
+struct InternHash {
+    uint64_t operator()(std::string_view s) const { return StringObject::hashString(s); }
+};
+struct InternEqual {
+    bool operator()(std::string_view a, std::string_view b) const { return a == b; }
+};
+}
+
+// Keys are views of the interned strings themselves, which the table keeps alive
+Value Value::internedString(std::string_view s) {
+    static SwissMap<std::string_view, Value, InternHash, InternEqual> table;
+    if (const Value* found = table.find(s))
+        return *found;
+    Value string(s);
+    auto& object = static_cast<StringObject&>(*string.asObject());
+    object.interned = true;
+    object.hash();
+    table.insert(object.value, string);
+    return string;
+}
+
+Value Value::boxedInteger(int64_t i) {
+    return Value(new BigIntObject(BigInt(i)));
+}
+
+Value Value::integer(BigInt i) {
+    int64_t small;
+    if (i.fitsInt64(small))
+        return integer(small);
+    return Value(new BigIntObject(std::move(i)));
 }
 
-bool Value::asBool() const {
-    if (auto* val = std::get_if<bool>(&data)) return *val;
-    throw std::runtime_error("Value is not a boolean");
+Value Value::integerFromDecimal(std::string_view digits) {
+    return integer(BigInt::fromDecimal(digits));
 }
 
-std::string Value::asString() const {
-    if (auto* val = std::get_if<std::string>(&data)) return *val;
+// Type accessors with error checking
+const std::string& Value::asString() const {
+    if (isString()) return static_cast<StringObject*>(asObject())->value;
     throw std::runtime_error("Value is not a string");
 }
 
+ListObject& Value::asList() const {
+    if (isList()) return *static_cast<ListObject*>(asObject());
+    throw std::runtime_error("Value is not a list");
+}
+
+DictObject& Value::asDict() const {
+    if (isDict()) return *static_cast<DictObject*>(asObject());
+    throw std::runtime_error("Value is not a dict");
+}
+
+const BigInt& Value::asBigInt() const {
+    if (isBigInt()) return static_cast<BigIntObject*>(asObject())->value;
+    throw std::runtime_error("Value is not a big integer");
+}
+
+double Value::asNumberSlow() const {
+    if (isBigInt()) return asBigInt().toDouble();
+    throw std::runtime_error("Value is not a number");
+}
+
+BigInt Value::toBigInt() const {
+    if (isBigInt()) return asBigInt();
+    int64_t i;
+    if (toInt64(i)) return BigInt(i);
+    throw std::runtime_error("Value is not an integer");
+}
+
 // Convert to string for printing
 std::string Value::toString() const {
-    if (isNumber()) {
-        if (asNumber() == std::trunc(asNumber())) // integer
-            return std::to_string(static_cast<int>(asNumber()));
-		else
-            return std::to_string(asNumber());
+    if (isSmallInt()) return std::to_string(asSmallInt());
+    if (isBigInt()) return asBigInt().toString();
+    if (isDouble()) {
+        double d = asDouble();
+        if (!(std::fabs(d) < 1e16)) { // huge, infinite or NaN
+            char buffer[32];
+            std::snprintf(buffer, sizeof buffer, "%.17g", d);
+            return buffer;
+        }
+        if (d == std::trunc(d)) // integral
+            return std::to_string(static_cast<int64_t>(d));
+        return std::to_string(d);
     }
     else if (isBool()) return asBool() ? "True" : "False";
     else if (isString()) return asString();
+    else if (isList()) return asList().repr();
+    else if (isDict()) return asDict().repr();
     return "undefined";
 }
 
+// Strings in single quotes, unless they hold one and no double quote
+std::string Value::repr() const {
+    if (!isString())
+        return toString();
+    const std::string& s = asString();
+    char quote = s.find('\'') != std::string::npos && s.find('"') == std::string::npos ? '"' : '\'';
+    return quote + s + quote;
+}
+
 // Type name for error messages
 std::string Value::typeName() const {
-    if (isNumber()) return "number";
+    if (isInteger()) return "int";
+    if (isDouble()) return "float";
     if (isBool()) return "bool";
     if (isString()) return "string";
+    if (isList()) return "list";
+    if (isDict()) return "dict";
     return "unknown";
 }
 
-// Truthiness (for conditions)
-bool Value::isTruthy() const {
-    if (isBool()) return asBool();
-    if (isNumber()) return asNumber() != 0.0;
+// Truthiness of heap values
+bool Value::isTruthySlow() const {
     if (isString()) return !asString().empty();
-    return false;
+    if (isList()) return asList().size() != 0;
+    if (isDict()) return asDict().size() != 0;
+    return isBigInt(); // never zero, zero is inline
 }
@@ -0,0 +1,331 @@
+#include "vm.h"
+#include "compiler.h"
+#include "dict.h"
+#include "list.h"
+#include "operators.h"
+#include <iostream>
+#include <stdexcept>
+
+
+VM::VM() : stack(kStackSize) {
+	frames.reserve(kMaxCallDepth + 1);
+	registerBuiltins();
+}
+
+void VM::registerBuiltins() {
+	module.addBuiltin("print", printFunc);
+	module.addBuiltin("println", printlnFunc);
+	module.addBuiltin("max", maxFunc);
+	module.addBuiltin("min", minFunc);
+	module.addBuiltin("len", lenFunc);
+	module.addBuiltin("append", appendFunc);
+	module.addBuiltin("sum", sumFunc);
+}
+
+Value VM::run(Program& program) {
+	Compiler compiler(module);
+	size_t index = module.functions.size(); // the top-level code comes first
+	FunctionProto* script = compiler.compile(program);
+	// Only this run needs the top-level code, the functions it defines stay
+	try {
+		Value result = execute(*script);
+		module.functions[index].reset();
+		return result;
+	}
+	catch (...) {
+		module.functions[index].reset();
+		throw;
+	}
+}
+
+std::vector<std::string> VM::backtrace() const {
+	std::vector<std::string> names;
+	for (size_t i = 1; i < frames.size(); i++) // frame 0 is the script itself
+		names.push_back(frames[i].proto->name);
+	if (activeBuiltin)
+		names.push_back(*activeBuiltin);
+	return names;
+}
+
+void VM::undefinedVariable(const std::string& name) const {
+	std::cerr << "Error: Variable '" << name << "' not defined." << std::endl;
+	throw std::runtime_error("Variable '" + name + "' not defined");
+}
+
+// First call of a function parsed lazily. Its body may use names and
+// functions the module has not seen yet.
+void VM::compileLazy(FunctionProto& proto) {
+	Compiler(module).compileLazy(proto);
+	if (globals.size() < module.globals.names.size())
+		globals.resize(module.globals.names.size(), Value::undefined());
+	if (functions.size() < module.functionNames.size())
+		functions.resize(module.functionNames.size(), nullptr);
+}
+
+// Binary operator with inline fast paths for two ints and for doubles (or a
+// double and an int)
+#define BINARY_OP(intExpr, doubleExpr, slowFunc) { \
+		Value& l = sp[-2]; \
+		const Value& r = sp[-1]; \
+		if (Value::bothSmallInts(l, r)) { \
+			int64_t a = l.asSmallInt(), b = r.asSmallInt(); \
+			l = intExpr; \
+		} \
+		else if (l.isInlineNumber() && r.isInlineNumber()) { \
+			double a = l.inlineNumberAsDouble(), b = r.inlineNumberAsDouble(); \
+			l = doubleExpr; \
+		} \
+		else \
+			l = slowFunc(l, r); \
+		--sp; \
+		break; \
+	}
+
+Value VM::execute(const FunctionProto& script) {
+	// The REPL may have added names since the last run
+	if (globals.size() < module.globals.names.size())
+		globals.resize(module.globals.names.size(), Value::undefined());
+	if (functions.size() < module.functionNames.size())
+		functions.resize(module.functionNames.size(), nullptr);
+
+	frames.clear();
+	activeBuiltin = nullptr;
+	Value* const stackEnd = stack.data() + stack.size();
+	if (script.frameSize() > stack.size())
+		throw std::runtime_error("Stack overflow");
+
+	const FunctionProto* proto = &script;
+	const Instruction* ip = script.code.data();
+	const Value* constants = script.constants.data();
+	Value* base = stack.data();
+	Value* sp = base;
+	frames.push_back({ proto, ip, base });
+
+	for (;;) {
+		Instruction ins = *ip++;
+		switch (opcodeOf(ins)) {
+		case OpCode::CONSTANT:
+			*sp++ = constants[operandOf(ins)];
+			break;
+		case OpCode::NONE:
+			*sp++ = Value();
+			break;
+		case OpCode::TRUE_:
+			*sp++ = Value(true);
+			break;
+		case OpCode::FALSE_:
+			*sp++ = Value(false);
+			break;
+		case OpCode::POP:
+			--sp;
+			break;
+
+		case OpCode::LOAD_LOCAL: {
+			const Value& v = base[operandOf(ins)];
+			if (v.isUndefined())
+				undefinedVariable(proto->localNames[operandOf(ins)]);
+			*sp++ = v;
+			break;
+		}
+		case OpCode::STORE_LOCAL:
+			base[operandOf(ins)] = std::move(*--sp);
+			break;
+		case OpCode::LOAD_GLOBAL: {
+			const Value& v = globals[operandOf(ins)];
+			if (v.isUndefined())
+				undefinedVariable(module.globals.names[operandOf(ins)]);
+			*sp++ = v;
+			break;
+		}
+		case OpCode::STORE_GLOBAL:
+			globals[operandOf(ins)] = std::move(*--sp);
+			break;
+
+		case OpCode::ADD: BINARY_OP(Value::integer(a + b), Value(a + b), addValues)
+		case OpCode::SUB: BINARY_OP(Value::integer(a - b), Value(a - b), subValues)
+		case OpCode::MUL: BINARY_OP(multiplyIntegers(a, b), Value(a * b), mulValues)
+		case OpCode::DIV: BINARY_OP(Value(static_cast<double>(a) / static_cast<double>(b)), Value(a / b), divValues)
+		case OpCode::FLOORDIV: BINARY_OP(b ? Value::integer(floorDivInt(a, b)) : floorDivValues(l, r), Value(floorDivDouble(a, b)), floorDivValues)
+		case OpCode::MOD: BINARY_OP(b ? Value::integer(floorModInt(a, b)) : modValues(l, r), Value(floorModDouble(a, b)), modValues)
+		case OpCode::EQ: BINARY_OP(Value(a == b), Value(a == b), equalValues)
+		case OpCode::NE: BINARY_OP(Value(a != b), Value(a != b), notEqualValues)
+		case OpCode::LT: BINARY_OP(Value(a < b), Value(a < b), lessValues)
+		case OpCode::LE: BINARY_OP(Value(a <= b), Value(a <= b), lessEqualValues)
+		case OpCode::GT: BINARY_OP(Value(a > b), Value(a > b), greaterValues)
+		case OpCode::GE: BINARY_OP(Value(a >= b), Value(a >= b), greaterEqualValues)
+		case OpCode::IN:
+			sp[-2] = inValues(sp[-2], sp[-1]);
+			--sp;
+			break;
+		case OpCode::NOT_IN:
+			sp[-2] = notInValues(sp[-2], sp[-1]);
+			--sp;
+			break;
+		case OpCode::COMPARE_CHAIN: {
+			Value result = applyBinary(static_cast<BinaryOp>(operandOf(ins)), sp[-2], sp[-1]);
+			sp[-2] = std::move(sp[-1]);
+			sp[-1] = std::move(result);
+			break;
+		}
+		case OpCode::NEG:
+			sp[-1] = negateValue(sp[-1]);
+			break;
+		case OpCode::NOT:
+			sp[-1] = Value(!sp[-1].isTruthy());
+			break;
+
+		case OpCode::BUILD_LIST: {
+			uint32_t count = operandOf(ins);
+			Value list = makeList(sp - count, count);
+			sp -= count;
+			*sp++ = std::move(list);
+			break;
+		}
+		case OpCode::INDEX:
+			sp[-2] = indexValue(sp[-2], sp[-1]);
+			--sp;
+			break;
+		case OpCode::STORE_INDEX:
+			storeIndex(sp[-2], sp[-1], sp[-3]);
+			sp -= 3;
+			break;
+		case OpCode::BUILD_DICT: {
+			uint32_t count = operandOf(ins);
+			Value dict = makeDict(sp - 2 * count, count);
+			sp -= 2 * count;
+			*sp++ = std::move(dict);
+			break;
+		}
+
+		case OpCode::JUMP:
+			ip = proto->code.data() + operandOf(ins);
+			break;
+		case OpCode::JUMP_IF_FALSE:
+			if (!(--sp)->isTruthy())
+				ip = proto->code.data() + operandOf(ins);
+			break;
+		case OpCode::JUMP_IF_FALSE_OR_POP:
+			if (!sp[-1].isTruthy())
+				ip = proto->code.data() + operandOf(ins);
+			else
+				--sp;
+			break;
+		case OpCode::JUMP_IF_TRUE_OR_POP:
+			if (sp[-1].isTruthy())
+				ip = proto->code.data() + operandOf(ins);
+			else
+				--sp;
+			break;
+		case OpCode::RANGE_SETUP: {
+			IntRange range = makeRange(sp[-3], sp[-2], sp[-1]);
+			sp[-3] = Value::integer(range.next);
+			sp[-2] = Value::integer(range.stop);
+			sp[-1] = Value::integer(range.step);
+			break;
+		}
+		case OpCode::FOR_RANGE: {
+			if (Value::bothSmallInts(sp[-3], sp[-2]) && sp[-1].isSmallInt()) {
+				int64_t i = sp[-3].asSmallInt(), stop = sp[-2].asSmallInt(), step = sp[-1].asSmallInt();
+				if (step > 0 ? i >= stop : i <= stop) {
+					ip = proto->code.data() + operandOf(ins);
+					break;
+				}
+				sp[-3] = Value::integer(i + step); // inline operands, no overflow
+				*sp++ = Value::integer(i);
+				break;
+			}
+			// Integers that fit 64 bits since RANGE_SETUP, boxed when huge
+			IntRange range;
+			sp[-3].toInt64(range.next);
+			sp[-2].toInt64(range.stop);
+			sp[-1].toInt64(range.step);
+			if (!range.hasNext()) {
+				ip = proto->code.data() + operandOf(ins);
+				break;
+			}
+			*sp++ = Value::integer(range.next);
+			range.advance();
+			sp[-4] = Value::integer(range.next);
+			break;
+		}
+		case OpCode::FOR_EACH: {
+			// The position is a small int, it never passes the iterable's length
+			size_t position = static_cast<size_t>(sp[-1].asSmallInt());
+			Value item;
+			if (!iterationItem(sp[-2], position, item)) {
+				ip = proto->code.data() + operandOf(ins);
+				break;
+			}
+			sp[-1] = Value::integer(static_cast<int64_t>(position + 1));
+			*sp++ = std::move(item);
+			break;
+		}
+
+		case OpCode::CALL: {
+			uint32_t slot = operandOf(ins) >> 8;
+			uint32_t argc = operandOf(ins) & 0xFF;
+			FunctionProto* callee = functions[slot];
+			if (!callee)
+				throw std::runtime_error("Function '" + module.functionNames[slot] + "' not defined");
+			if (callee->code.empty())
+				compileLazy(*callee);
+			if (argc != callee->arity)
+				throw std::runtime_error("Function '" + callee->name + "' expects " + std::to_string(callee->arity) + " arguments, got " + std::to_string(argc));
+			if (frames.size() > kMaxCallDepth) // frame 0 is the script
+				throw std::runtime_error("Maximum recursion depth exceeded");
+			Value* newBase = sp - argc;
+			if (newBase + callee->frameSize() > stackEnd)
+				throw std::runtime_error("Stack overflow");
+
+			// Arguments already sit in the first local slots
+			Value* localsEnd = newBase + callee->localNames.size();
+			for (; sp < localsEnd; ++sp)
+				*sp = Value::undefined();
+
+			frames.back().ip = ip;
+			frames.push_back({ callee, callee->code.data(), newBase });
+			proto = callee;
+			ip = callee->code.data();
+			constants = callee->constants.data();
+			base = newBase;
+			break;
+		}
+		case OpCode::CALL_BUILTIN: {
+			uint32_t index = operandOf(ins) >> 8;
+			uint32_t argc = operandOf(ins) & 0xFF;
+			argBuffer.assign(sp - argc, sp);
+			activeBuiltin = &module.builtinNames[index];
+			Value result = module.builtins[index](argBuffer);
+			activeBuiltin = nullptr;
+			sp -= argc;
+			*sp++ = std::move(result);
+			break;
+		}
+		case OpCode::RETURN: {
+			Value result = std::move(sp[-1]);
+			frames.pop_back();
+			if (frames.empty())
+				return result;
+			sp = base;
+			*sp++ = std::move(result);
+			const CallFrame& caller = frames.back();
+			proto = caller.proto;
+			ip = caller.ip;
+			constants = proto->constants.data();
+			base = caller.base;
+			break;
+		}
+		case OpCode::DEF_FUNCTION: {
+			FunctionProto* fn = module.functions[operandOf(ins)].get();
+			if (functions[fn->nameSlot])
+				throw std::runtime_error("Function '" + fn->name + "' already defined");
+			functions[fn->nameSlot] = fn;
+			break;
+		}
+		default:
+			throw std::runtime_error("Unknown opcode " + std::to_string(ins & 0xFF));
+		}
+	}
+}
+
+#undef BINARY_OP
@@ -0,0 +1,17 @@
+x = "global x"
+y = "global y"
+
+def keeps(flag):
+    if flag:
+        y = "local y"
+    return y
+
+def assignsInDeadIf():
+    if False:
+        x = 1
+    return x
+
+println(keeps(True))
+println(x)
+println(assignsInDeadIf())
+println("not reached")
@@ -0,0 +1,66 @@
+#include "dotGenerator.h"
+#include "incrementalParser.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "parser.h"
+#include <iostream>
+#include <string>
+
+// Programs handed out by an IncrementalParser share its statement trees.
+// Optimizing, dropping the program and asking for another one must leave
+// the trees intact (they used to point into the dropped program's arena),
+// and equal to the same source parsed and optimized in one piece.
+
+static std::string optimizedDot(const std::string& source) {
+	Lexer lexer(source);
+	Program tree = Parser(lexer).parse();
+	Optimizer().optimize(tree);
+	return DotGenerator().generate(*tree.root);
+}
+
+static bool check(bool ok, const std::string& what) {
+	if (!ok)
+		std::cerr << "FAILED: " << what << std::endl;
+	return ok;
+}
+
+int main() {
+	const std::string source =
+		"x = 1 + 2 * 3\n"
+		"if True:\n"
+		"    y = x * 1\n"
+		"def f(a):\n"
+		"    return a + 0 + (4 - 1)\n"
+		"z = f(x) + 0\n";
+	bool ok = true;
+
+	IncrementalParser session(source);
+	{
+		session.optimize();
+		Program first = session.program();
+		ok &= check(DotGenerator().generate(*first.root) == optimizedDot(source), "first program");
+	}
+	{
+		// The first program and its arena are gone
+		Program second = session.program();
+		ok &= check(DotGenerator().generate(*second.root) == optimizedDot(source), "program after the first was dropped");
+	}
+
+	// Statements optimize once: a second pass finds nothing to do
+	ok &= check(session.optimize().nodesBefore == 0, "optimize() again");
+
+	// An edit re-parses some statements; only those are optimized again
+	const std::string appended = "w = 10 - 2 - 3\n";
+	session.edit(session.size(), 0, appended);
+	session.optimize();
+	{
+		Program edited = session.program();
+		ok &= check(DotGenerator().generate(*edited.root) == optimizedDot(source + appended), "program after an edit");
+	}
+	{
+		Program tail = session.program(session.statementCount() - 1);
+		ok &= check(DotGenerator().generate(*tail.root) == optimizedDot(appended), "program of the last statement");
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#include "builtInFunctions.h"
+#include "list.h"
+#include "listKernels.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Every kernel implementation the CPU supports gives the same results as
+// Scalar, floats to the bit, on lists of every length around the SIMD
+// widths; and sum() of floats is the same whatever the list's storage.
+
+static bool check(bool ok, const std::string& what) {
+	if (!ok)
+		std::cerr << "FAILED: " << what << std::endl;
+	return ok;
+}
+
+static bool sameBits(double a, double b) {
+	return std::memcmp(&a, &b, sizeof a) == 0;
+}
+
+static uint64_t next(uint64_t& state) {
+	state = state * 6364136223846793005ull + 1442695040888963407ull;
+	return state >> 11;
+}
+
+// Magnitudes far apart, so the order of the additions shows in the result
+static std::vector<double> randomDoubles(size_t count, uint64_t seed) {
+	std::vector<double> out(count);
+	for (double& x : out) {
+		double unit = static_cast<double>(next(seed)) / 9007199254740992.0 - 0.5;
+		x = std::ldexp(unit, static_cast<int>(next(seed) % 80) - 40);
+	}
+	return out;
+}
+
+static std::vector<int64_t> randomInts(size_t count, uint64_t seed, int bits) {
+	std::vector<int64_t> out(count);
+	for (int64_t& x : out)
+		x = static_cast<int64_t>(next(seed) << 11) >> (64 - bits);
+	return out;
+}
+
+static bool compare(const ListKernels& scalar, const ListKernels& other, size_t n, uint64_t seed) {
+	std::string where = std::string(scanIsaName(other.isa)) + ", " + std::to_string(n) + " elements";
+	bool ok = true;
+
+	std::vector<double> doubles = randomDoubles(n, seed);
+	ok &= check(sameBits(scalar.sumDoubles(0.5, doubles.data(), n), other.sumDoubles(0.5, doubles.data(), n)),
+		"sumDoubles, " + where);
+	std::vector<double> negated(doubles);
+	if (n > 0)
+		negated[n / 2] = -negated[n / 2];
+	ok &= check(scalar.equalDoubles(doubles.data(), negated.data(), n) == other.equalDoubles(doubles.data(), negated.data(), n),
+		"equalDoubles, " + where);
+	if (n > 0) {
+		double a = 0, b = 0;
+		bool found = scalar.maxDoubles(doubles.data(), n, &a);
+		ok &= check(found == other.maxDoubles(doubles.data(), n, &b) && sameBits(a, b), "maxDoubles, " + where);
+		found = scalar.minDoubles(doubles.data(), n, &a);
+		ok &= check(found == other.minDoubles(doubles.data(), n, &b) && sameBits(a, b), "minDoubles, " + where);
+	}
+
+	for (int bits : { 20, 64 }) {
+		std::vector<int64_t> ints = randomInts(n, seed, bits);
+		// Which partial sums overflow depends on the lanes, but a sum that
+		// fits is exact
+		int64_t a = 0, b = 0;
+		bool fits = scalar.sumInts(ints.data(), n, &a) && other.sumInts(ints.data(), n, &b);
+		ok &= check(!fits || a == b, "sumInts, " + where);
+		if (n > 0) {
+			ok &= check(scalar.maxInts(ints.data(), n) == other.maxInts(ints.data(), n), "maxInts, " + where);
+			ok &= check(scalar.minInts(ints.data(), n) == other.minInts(ints.data(), n), "minInts, " + where);
+		}
+	}
+	return ok;
+}
+
+// sum() over unboxed floats and over the same floats boxed (an int 0 at the
+// end boxes the list and adds nothing)
+static bool sumMatchesBoxed(const std::vector<double>& doubles, const Value& start) {
+	std::vector<Value> items(doubles.begin(), doubles.end());
+	Value unboxed = makeList(items.data(), items.size());
+	items.push_back(Value::integer(0));
+	Value boxed = makeList(items.data(), items.size());
+	double a = sumFunc({ unboxed, start }).asNumber();
+	double b = sumFunc({ boxed, start }).asNumber();
+	return check(unboxed.asList().storage() == ListObject::Storage::Doubles &&
+		boxed.asList().storage() == ListObject::Storage::Boxed && sameBits(a, b),
+		"sum() of " + std::to_string(doubles.size()) + " floats from " + start.toString() + ", unboxed and boxed");
+}
+
+int main() {
+	bool ok = true;
+	const ListKernels& scalar = listKernelsFor(ScanIsa::Scalar);
+	for (ScanIsa isa : { ScanIsa::SSE2, ScanIsa::AVX2 }) {
+		if (!scanIsaSupported(isa))
+			continue;
+		for (size_t n = 0; n <= 40; n++)
+			ok &= compare(scalar, listKernelsFor(isa), n, n + 1);
+		ok &= compare(scalar, listKernelsFor(isa), 100003, 7);
+	}
+
+	// Left to right, as a loop adding them would: not 1.0
+	std::vector<double> tenths(10, 0.1);
+	double loop = 0.0;
+	for (double x : tenths)
+		loop += x;
+	ok &= check(sameBits(defaultListKernels().sumDoubles(0.0, tenths.data(), tenths.size()), loop), "sum of ten 0.1");
+
+	for (const Value& start : { Value::integer(0), Value::integer(5), Value(0.25) }) {
+		ok &= sumMatchesBoxed(tenths, start);
+		ok &= sumMatchesBoxed(randomDoubles(1000, 3), start);
+	}
+
+	return ok ? 0 : 1;
+}
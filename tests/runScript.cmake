@@ -0,0 +1,31 @@
+# Runs one script and compares what it prints with the expected output.
+#   cmake -DCPPYTHON=<binary> -DFLAGS=<engine switch or empty> -DSCRIPT=<.py>
+#         -DEXPECTED=<file> -DWORK_DIR=<scratch directory> -P runScript.cmake
+# The script gets an empty stdin, so the REPL that follows a script exits at
+# once; its banner and prompt are cut from the output. It runs twice from an
+# empty code cache: the VM compiles the first time and loads the second.
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+set(empty "${WORK_DIR}/empty.txt")
+file(WRITE "${empty}" "")
+file(READ "${EXPECTED}" expected)
+separate_arguments(flags UNIX_COMMAND "${FLAGS}")
+
+foreach(run compiled cached)
+    execute_process(
+        COMMAND "${CPPYTHON}" ${flags} --cache-dir "${WORK_DIR}/cache" "${SCRIPT}"
+        INPUT_FILE "${empty}"
+        OUTPUT_VARIABLE output
+        ERROR_VARIABLE errors
+    )
+    string(FIND "${output}" "\n\nCPPython Interpreter" banner)
+    if(banner GREATER -1)
+        string(SUBSTRING "${output}" 0 ${banner} output)
+    endif()
+    if(NOT output STREQUAL expected)
+        file(WRITE "${WORK_DIR}/actual.txt" "${output}")
+        message(FATAL_ERROR "Output of ${SCRIPT} (${FLAGS}, ${run}) differs from ${EXPECTED}, "
+            "see ${WORK_DIR}/actual.txt\n${errors}")
+    endif()
+endforeach()
@@ -0,0 +1,38 @@
+def t(name, value):
+    println("called", name)
+    return value
+
+println(False and t("and after False", True))
+println(True or t("or after True", False))
+println(True and t("and after True", 1))
+println(False or t("or after False", 2))
+println(0 and t("and after 0", 3))
+println("" or t("or after empty string", "x"))
+
+a = 0
+b = 1
+println(a and t("and after a falsy variable", 4))
+println(b or t("or after a truthy variable", 5))
+println(t("left", 0) and t("right", 6))
+println(t("left", 7) or t("right", 8))
+println(a and t("first", 1) or t("second", 9))
+println(not (a or b) and t("after not", 10))
+
+println(1 < t("middle", 5) < 10)
+println(5 < t("stops here", 1) < t("never", 10))
+println(t("p", 1) < t("q", 2) < t("r", 0) < t("s", 5))
+println(t("u", 1) < t("v", 2) <= t("w", 2) == t("x", 2))
+
+def local(x):
+    if x > 0 and t("in a function", True):
+        println("taken")
+    return 0 < t("once", x) < 3
+
+println(local(2))
+println(local(-1))
+
+n = 0
+while n < 3 and t("loop test", True):
+    n = n + 1
+println(n)
+println("end")